@@ -1,127 +1,629 @@
 #ifndef BPTREE_HPP
 #define BPTREE_HPP
 
+#include "change_stream.hpp"
+#include "interchange.hpp"
 #include "page.hpp"
 #include "page_manager.hpp"
+#include "policies.hpp"
+#include "shared_coord.hpp"
+#include <atomic>
 #include <cstring>
+#include <ctime>
+#include <map>
+#include <thread>
 #include <vector>
 
-class BPlusTree {
+// Outcome of the startup repair pass run on unclean files
+struct RecoveryStats {
+  bool performed = false;
+  uint32_t leaves = 0;       // Leaves kept in the rebuilt chain
+  uint32_t records = 0;      // Records reachable after recovery
+  uint32_t droppedLeaves = 0; // Empty or unreadable leaves unlinked
+  uint32_t freedPages = 0;   // Pages returned to the rebuilt free list
+};
+
+// The tree is parameterised on the policies in policies.hpp; BPlusTree is
+// the default combination. Every policy call is resolved at compile time.
+template <typename Search = DefaultSearch, typename Storage = MmapStorage,
+          typename Locking = NoLocking, typename Split = RuntimeSplit>
+class BasicBPlusTree {
+public:
+  using PageManagerType = BasicPageManager<Storage>;
+  using LockingPolicy = Locking;
+  using ReadGuard = typename Locking::ReadGuard;
+  using WriteGuard = typename Locking::WriteGuard;
+
 private:
-  PageManager pm;
+  PageManagerType pm;
   std::string indexFile;
+  SharedCoordinator coord;
+  ChangeStream changes;
+  RecoveryStats recovery;
+  Locking locking;
+
+  SplitPolicy splitPolicy = Split::policy;
+  uint32_t splitFillPercent = Split::fillPercent;
+  int32_t lastInsertKey = 0;
+  int32_t insertRun = 0; // > 0 ascending run length, < 0 descending
+
+  // Consecutive same-direction inserts before ADAPTIVE treats them as a run
+  static constexpr int32_t ADAPTIVE_RUN = 16;
+
+  bool lazyDelete = false;
+  uint32_t compactThreshold = LEAF_MAX_KEYS / 4;
+  uint32_t tailSlots = 0; // Unsorted append area per leaf, 0 = off
+  uint8_t leafFlags = 0;  // Format given to newly created leaves
+
+  // Secondary expiry index: keys written with an expiry, bucketed by it.
+  // Entries go stale when a key is rewritten or deleted; the sweeper checks
+  // the leaf before removing anything. Not persisted: the first sweep after
+  // open() rebuilds it with one pass over the leaves.
+  std::map<uint32_t, std::vector<int32_t>> expiryIndex;
+  bool expiryIndexBuilt = false;
+  std::atomic<uint32_t> pinnedClock{0}; // Fixed "now" for expiries, 0 = wall
+
+  // Builds internal levels bottom-up from a left-to-right stream of children
+  // (leaf ids with their lowest key). Only the right-most node of each level
+  // is open at a time, so memory stays O(height).
+  class LevelBuilder {
+    struct Level {
+      uint32_t node = INVALID_PAGE;       // Open node, once it has 2 children
+      uint32_t firstChild = INVALID_PAGE; // Sole child before that
+      uint32_t lastChild = INVALID_PAGE;  // Most recent child at this level
+      int32_t lastLow = INT32_MIN;        // Its low fence
+    };
+
+    PageManagerType &pm;
+    uint32_t maxKeys;
+    std::vector<Level> levels;
+    std::vector<uint32_t> nodes; // Every internal node allocated, for release
+
+  public:
+    LevelBuilder(PageManagerType &p, uint32_t keysPerNode = INTERNAL_MAX_KEYS)
+        : pm(p), maxKeys(std::max<uint32_t>(
+                     1, std::min(keysPerNode, INTERNAL_MAX_KEYS))) {}
+
+    bool add(uint32_t childId, int32_t lowKey, size_t level = 0) {
+      if (level == levels.size())
+        levels.emplace_back();
+      Level &lv = levels[level];
+
+      // Fences: the previous child at this level now ends just below lowKey;
+      // the newest one gets its fences from its successor or from finish()
+      const int32_t low = lv.lastChild == INVALID_PAGE ? INT32_MIN : lowKey;
+      if (lv.lastChild != INVALID_PAGE)
+        setFences(lv.lastChild, lv.lastLow, lowKey - 1);
+      lv.lastChild = childId;
+      lv.lastLow = low;
+
+      if (lv.firstChild == INVALID_PAGE) {
+        lv.firstChild = childId; // Might turn out to be the root
+        return true;
+      }
 
-public:
-  BPlusTree() = default;
-  ~BPlusTree() { close(); }
+      if (lv.node != INVALID_PAGE) {
+        InternalNode *node = pm.getInternalNode(lv.node);
+        if (node->numKeys < maxKeys) {
+          node->setKey(node->numKeys, lowKey);
+          node->setChild(node->numKeys + 1, childId);
+          node->numKeys++;
+          return true;
+        }
+      }
+
+      // Start a new right-most node at this level
+      bool first = (lv.node == INVALID_PAGE);
+      uint32_t nodeId = pm.allocatePage();
+      if (nodeId == INVALID_PAGE)
+        return false;
+      nodes.push_back(nodeId);
+
+      Level &cur = levels[level];
+      InternalNode *node = pm.getInternalNode(nodeId);
+      node->init();
+      if (first) {
+        node->setChild(0, cur.firstChild);
+        node->setKey(0, lowKey);
+        node->setChild(1, childId);
+        node->numKeys = 1;
+        cur.node = nodeId;
+        return add(nodeId, lowKey, level + 1);
+      }
+      node->setChild(0, childId);
+      cur.node = nodeId;
+      return add(nodeId, lowKey, level + 1);
+    }
+
+    // Close the right edge of every level and return the root, or
+    // INVALID_PAGE if nothing was added
+    uint32_t finish() {
+      for (const Level &lv : levels)
+        setFences(lv.lastChild, lv.lastLow, INT32_MAX);
+      return levels.empty() ? INVALID_PAGE : levels.back().firstChild;
+    }
+
+    // Abort: free the internal nodes built so far. The children that were
+    // added stay the caller's to free.
+    void release() {
+      for (uint32_t id : nodes)
+        pm.freePage(id);
+      nodes.clear();
+      levels.clear();
+    }
+
+  private:
+    // Unchanged fences are not rewritten, so rebuilding the levels above
+    // existing leaves (merge) leaves those pages clean
+    void setFences(uint32_t pageId, int32_t low, int32_t high) {
+      void *page = pm.getPage(pageId);
+      if (*static_cast<const PageType *>(page) == PageType::LEAF) {
+        LeafNode *leaf = static_cast<LeafNode *>(page);
+        if (!leaf->hasFences() || leaf->lowFence() != low ||
+            leaf->highFence() != high)
+          leaf->setFences(low, high);
+      } else {
+        static_cast<InternalNode *>(page)->setFences(low, high);
+      }
+    }
+  };
+
+  // Appends strictly ascending records to a fresh leaf chain, each leaf
+  // filled to the fill factor and handed to a LevelBuilder as it is
+  // started. Shared by the bulk loader and merge; the caller checks order.
+  class LeafChainBuilder {
+    PageManagerType &pm;
+    LevelBuilder builder;
+    uint32_t perLeaf;
+    uint8_t flags;
+    uint32_t leafId = INVALID_PAGE;
+    int32_t last = 0;
+    uint32_t count = 0;
+
+  public:
+    LeafChainBuilder(PageManagerType &p, uint8_t leafFlags,
+                     uint32_t fillPercent)
+        : pm(p), builder(p, percentOf(INTERNAL_MAX_KEYS, fillPercent)),
+          perLeaf(percentOf(LeafNode::capacityFor(leafFlags), fillPercent)),
+          flags(leafFlags) {}
+
+    bool append(int32_t key, const uint8_t *value, uint32_t expiresAt) {
+      LeafNode *leaf = leafId == INVALID_PAGE ? nullptr : pm.getLeafNode(leafId);
+      if (!leaf || leaf->numKeys >= perLeaf) {
+        uint32_t newId = pm.allocatePage();
+        if (newId == INVALID_PAGE)
+          return false;
+
+        leaf = pm.getLeafNode(newId);
+        leaf->init(flags);
+        leaf->prevLeaf = leafId;
+        if (leafId != INVALID_PAGE)
+          pm.getLeafNode(leafId)->nextLeaf = newId;
+        leafId = newId;
+
+        if (!builder.add(newId, count > 0 ? shortestSeparator(last, key)
+                                          : key)) // Also sets the fences
+          return false;
+        leaf = pm.getLeafNode(newId); // The builder may have grown
+      }
+
+      leaf->insertAt(leaf->numKeys, key, value, expiresAt);
+      last = key;
+      count++;
+      return true;
+    }
+
+    // Root of the levels built, or INVALID_PAGE if nothing was appended
+    uint32_t finish() { return builder.finish(); }
+
+    // Abort: free the leaves and internal nodes built so far
+    void release() {
+      builder.release();
+      while (leafId != INVALID_PAGE) {
+        const uint32_t prev = pm.getLeafNode(leafId)->prevLeaf;
+        pm.freePage(leafId);
+        leafId = prev;
+      }
+      count = 0;
+    }
+    uint32_t appended() const { return count; }
+    int32_t lastKey() const { return last; }
+  };
 
-  bool open(const std::string &filename) {
+  // Descent depth beyond which a reader assumes it followed a torn pointer
+  static constexpr uint32_t MAX_TREE_DEPTH = 32;
+
+  // Keys readBatch descends in lockstep
+  static constexpr size_t BATCH_GROUP = 16;
+
+  // applySorted merge-joins a batch of APPLY_JOIN_MIN records or more that
+  // is at least APPLY_JOIN_RATIO times the tree, instead of inserting it
+  // leaf by leaf. The join rewrites every record, so it only pays off when
+  // the tree is small next to the batch (a backlog into a new follower).
+  static constexpr size_t APPLY_JOIN_RATIO = 4;
+  static constexpr size_t APPLY_JOIN_MIN = 1024;
+  static constexpr uint32_t APPLY_JOIN_FILL = 90;
+
+public:
+  // A read-only tree shared between threads must not remap under a
+  // ReadGuard; its shared reads remap under the WriteGuard instead
+  BasicBPlusTree() { pm.setRemapOnDemand(!Locking::concurrent); }
+  ~BasicBPlusTree() { close(); }
+
+  bool open(const std::string &filename,
+            OpenMode mode = OpenMode::READ_WRITE) {
+    WriteGuard guard(locking);
     indexFile = filename;
-    return pm.open(filename);
+    return pm.open(filename, mode) && recoverIfNeeded();
   }
 
-  void close() {
-    pm.sync();
-    pm.close();
+  // Open an index striped across several files (e.g. one per device).
+  // The same file list, in the same order, must be used on every open.
+  bool open(const std::vector<std::string> &files,
+            OpenMode mode = OpenMode::READ_WRITE) {
+    WriteGuard guard(locking);
+    indexFile = files.empty() ? std::string() : files[0];
+    return pm.open(files, mode) && recoverIfNeeded();
   }
 
-  // API: writeData(key, data) - returns true on success
-  bool writeData(int32_t key, const uint8_t *data) {
+  // What the last open() had to repair, if anything
+  const RecoveryStats &lastRecovery() const { return recovery; }
+
+  // Readers: pick up a new version published by the writer process.
+  // Returns true if the root or file size may have changed.
+  bool refresh() {
+    WriteGuard guard(locking);
+    return pm.refresh();
+  }
+
+  bool isReadOnly() const { return pm.isReadOnly(); }
+
+  // Join the multi-process protocol through the <index>.lock sidecar.
+  // A read-write tree becomes the single writer (fails if one exists);
+  // a read-only tree joins as a reader, without writing to either file,
+  // and can use the *Shared reads.
+  bool enableSharedAccess() {
+    const std::string path = indexFile + ".lock";
+    return pm.isReadOnly() ? coord.openReader(path) : coord.openWriter(path);
+  }
+
+  SharedCoordinator &coordinator() { return coord; }
+
+  // CHANGE STREAM: from now on every successful put (writeData, writeBatch,
+  // bulk loads) and delete is appended to a ring that consumers follow with
+  // a ChangeCursor. shared=true places it in <index>.changes so other
+  // processes can attach(); otherwise it is private to this process.
+  bool enableChangeStream(bool shared = true,
+                          uint32_t records = CHANGE_DEFAULT_CAPACITY) {
+    WriteGuard guard(locking);
+    if (pm.isReadOnly())
+      return false;
+    if (!(shared ? changes.openShared(indexFile + ".changes", records)
+                 : changes.openPrivate(records)))
+      return false;
+    changes.setFlags(leafFlags & LEAF_FLAG_TTL ? CHANGE_FLAG_TTL : 0);
+    return true;
+  }
+
+  const ChangeStream &changeStream() const { return changes; }
+
+  // Change stream sequence a replica has applied up to (exclusive), kept in
+  // the metadata page so a follower resumes where it stopped. 0 = none.
+  uint64_t appliedChangeSeq() const {
+    const MetadataPage *meta = const_cast<PageManagerType &>(pm).getMetadata();
+    return meta ? meta->replicaSeq : 0;
+  }
+
+  void setAppliedChangeSeq(uint64_t seq) {
+    WriteGuard guard(locking);
     MetadataPage *meta = pm.getMetadata();
-    if (!meta || !meta->isValid())
+    if (meta && !pm.isReadOnly())
+      meta->replicaSeq = seq;
+  }
+
+  // Sharded servers: record in the metadata page that this file is shard
+  // `index` of `count` over [lo, hi], or, once recorded, check that it
+  // still is. False on a mismatch: the records would sit in the wrong shard.
+  bool bindShard(uint32_t index, uint32_t count, int32_t lo, int32_t hi) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || index >= count)
       return false;
+    if (meta->shardCount != 0)
+      return meta->shardIndex == index && meta->shardCount == count &&
+             meta->shardLo == lo && meta->shardHi == hi;
+    if (pm.isReadOnly())
+      return true; // Nothing recorded to check against
+    meta->shardIndex = index;
+    meta->shardCount = count;
+    meta->shardLo = lo;
+    meta->shardHi = hi;
+    meta->lsn++;
+    return true;
+  }
 
-    // Tree is empty - create root leaf
-    if (meta->rootPageId == INVALID_PAGE) {
-      uint32_t rootId = pm.allocatePage();
-      if (rootId == INVALID_PAGE)
-        return false;
+  // Cap the memory this process keeps resident for the mapping; see
+  // PageManager::setResidentBudget. 0 removes the cap.
+  void setResidentBudget(size_t bytes, bool release = true) {
+    WriteGuard guard(locking);
+    pm.setResidentBudget(bytes, release);
+  }
 
-      LeafNode *root = pm.getLeafNode(rootId);
-      root->init();
-      root->insertAt(0, key, data);
+  // Evict down to the budget now. The writer also does this as it allocates
+  // and syncs; a read-only process has to call it itself.
+  void trimToBudget() {
+    WriteGuard guard(locking);
+    pm.trimToBudget();
+  }
 
-      meta->rootPageId = rootId;
-      meta->numRecords = 1;
-      return true;
-    }
+  ResidentStats residentStats() const { return pm.residentStats(); }
 
-    // Find leaf for insertion
-    uint32_t leafId = findLeaf(key);
-    LeafNode *leaf = pm.getLeafNode(leafId);
+  void close() {
+    WriteGuard guard(locking);
+    expiryIndex.clear();
+    expiryIndexBuilt = false;
+    changes.close();
+    coord.close();
+    pm.sync();
+    pm.close();
+  }
 
-    // Check for duplicate key
-    uint32_t pos = leaf->findPosition(key);
-    if (pos < leaf->numKeys && leaf->keys()[pos] == key) {
-      // Update existing
-      std::memcpy(leaf->getValue(pos), data, DATA_SIZE);
-      return true;
-    }
+  // Flush to disk and publish a new version to read-only openers
+  void sync() {
+    WriteGuard guard(locking);
+    pm.sync();
+  }
 
-    // Leaf has space
-    if (!leaf->isFull()) {
-      leaf->insertAt(pos, key, data);
-      meta->numRecords++;
-      return true;
-    }
+  // API: writeData(key, data) - returns true on success. expiresAt is an
+  // absolute time in seconds since the Unix epoch (see clockNow), 0 for
+  // never; a non-zero one needs a TTL leaf (setTtlLeaves).
+  bool writeData(int32_t key, const uint8_t *data, uint32_t expiresAt = 0) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly())
+      return false;
 
-    // Need to split
-    return insertAndSplit(leafId, key, data);
+    SharedCoordinator::WriteScope scope(coord);
+    uint32_t hint = INVALID_PAGE;
+    if (!insertOne(key, data, hint, expiresAt))
+      return false;
+    if (expiresAt)
+      expiryIndex[expiresAt].push_back(key);
+    noteChange(ChangeOp::PUT, key, data, expiresAt);
+    return true;
+  }
+
+  // BATCHED WRITE: inserts or updates keys[i] -> values[i * DATA_SIZE] in
+  // order under one guard and one seqlock window. While the leaf written
+  // last still covers the next key (by its fences) the descent is skipped,
+  // so ascending or clustered batches touch the internal levels rarely.
+  // Stops at the first failure; returns the number of records written.
+  // expiries, if given, holds one expiry per record as for writeData.
+  size_t writeBatch(const int32_t *keys, const uint8_t *values, size_t count,
+                    const uint32_t *expiries = nullptr) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly())
+      return 0;
+
+    SharedCoordinator::WriteScope scope(coord);
+    uint32_t hint = INVALID_PAGE;
+    for (size_t i = 0; i < count; i++) {
+      const uint32_t expiresAt = expiries ? expiries[i] : 0;
+      if (!insertOne(keys[i], values + i * DATA_SIZE, hint, expiresAt))
+        return i;
+      if (expiresAt)
+        expiryIndex[expiresAt].push_back(keys[i]);
+      noteChange(ChangeOp::PUT, keys[i], values + i * DATA_SIZE, expiresAt);
+    }
+    return count;
   }
 
   // API: deleteData(key) - returns true on success
   bool deleteData(int32_t key) {
+    WriteGuard guard(locking);
     MetadataPage *meta = pm.getMetadata();
-    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE)
+    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE ||
+        pm.isReadOnly())
       return false;
 
-    uint32_t leafId = findLeaf(key);
-    LeafNode *leaf = pm.getLeafNode(leafId);
+    SharedCoordinator::WriteScope scope(coord);
+    uint32_t hint = INVALID_PAGE;
+    return removeOne(key, hint);
+  }
 
-    uint32_t pos = leaf->findPosition(key);
-    if (pos >= leaf->numKeys || leaf->keys()[pos] != key) {
-      return false; // Key not found
+  // SORTED APPLY: applies count records with strictly ascending keys, as a
+  // follower applies a batch of changes: keys[i] is put with the DATA_SIZE
+  // bytes at values[i] and expiries[i] (if given), or removed if values[i]
+  // is nullptr (absent already is fine). Records go in leaf by leaf, with
+  // one descent per leaf touched rather than per record; a batch several
+  // times the size of the tree (see APPLY_JOIN_RATIO) is instead
+  // merge-joined with the leaf chain in one sequential pass into fresh
+  // leaves at fillPercent, as merge() does. Returns false on failure, with
+  // the tree unchanged if the join was under way.
+  bool applySorted(const int32_t *keys, const uint8_t *const *values,
+                   const uint32_t *expiries, size_t count,
+                   uint32_t fillPercent = APPLY_JOIN_FILL) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly())
+      return false;
+    for (size_t i = 1; i < count; i++) {
+      if (keys[i] <= keys[i - 1])
+        return false;
     }
 
-    leaf->removeAt(pos);
-    meta->numRecords--;
-
-    // Simple approach: don't merge/redistribute for now
-    // Production code would handle underflow here
+    if (count >= APPLY_JOIN_MIN &&
+        meta->numRecords <= count / APPLY_JOIN_RATIO) {
+      SortedSource batch{keys, values, expiries, count};
+      const uint32_t oldRoot = meta->rootPageId;
+      uint32_t root = INVALID_PAGE, records = 0;
+      if (!mergeJoin(batch, fillPercent, root, records))
+        return false;
+      std::vector<uint32_t> oldPages;
+      collectPages(oldRoot, true, oldPages);
+      SharedCoordinator::WriteScope scope(coord);
+      for (uint32_t id : oldPages)
+        pm.freePage(id);
+      meta = pm.getMetadata();
+      meta->rootPageId = root;
+      meta->numRecords = records;
+      meta->lsn++;
+      meta->bumpEpoch();
+      if (leafFlags & LEAF_FLAG_TTL)
+        expiryIndexBuilt = false; // Rebuilt on the next sweep
+      for (size_t i = 0; changes.isActive() && i < count; i++)
+        noteChange(values[i] ? ChangeOp::PUT : ChangeOp::DELETE, keys[i],
+                   values[i], values[i] && expiries ? expiries[i] : 0);
+      return true;
+    }
 
-    // If root leaf becomes empty, reset tree
-    if (leaf->numKeys == 0 && leafId == meta->rootPageId) {
-      // Check if it's a leaf (not internal)
-      if (leaf->type == PageType::LEAF) {
-        pm.freePage(leafId);
-        meta->rootPageId = INVALID_PAGE;
+    SharedCoordinator::WriteScope scope(coord);
+    uint32_t hint = INVALID_PAGE;
+    for (size_t i = 0; i < count; i++) {
+      if (!values[i]) {
+        removeOne(keys[i], hint);
+        continue;
       }
+      const uint32_t expiresAt = expiries ? expiries[i] : 0;
+      if (!insertOne(keys[i], values[i], hint, expiresAt))
+        return false;
+      if (expiresAt)
+        expiryIndex[expiresAt].push_back(keys[i]);
+      noteChange(ChangeOp::PUT, keys[i], values[i], expiresAt);
     }
-
     return true;
   }
 
   // API: readData(key) - returns pointer to data or nullptr
   const uint8_t *readData(int32_t key) {
+    ReadGuard guard(locking);
+    return lookup(key);
+  }
+
+  // BATCHED LOOKUP: descends groups of keys level by level in lockstep.
+  // Each key's child is prefetched as soon as it is known but only searched
+  // after the rest of the group has taken its step, so up to BATCH_GROUP
+  // descents have their misses in flight at once. out[i] receives the value
+  // pointer or nullptr (valid as for readData); returns the number found.
+  size_t readBatch(const int32_t *keys, size_t count, const uint8_t **out) {
+    ReadGuard guard(locking);
     MetadataPage *meta = pm.getMetadata();
-    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE)
-      return nullptr;
+    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE) {
+      std::fill(out, out + count, nullptr);
+      return 0;
+    }
 
-    uint32_t leafId = findLeaf(key);
-    LeafNode *leaf = pm.getLeafNode(leafId);
+    const uint32_t rootId = meta->rootPageId;
+    uint32_t pages[BATCH_GROUP];
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += BATCH_GROUP) {
+      const size_t g = std::min(BATCH_GROUP, count - base);
+      const int32_t *k = keys + base;
+      std::fill(pages, pages + g, rootId);
+
+      // Every leaf is at the same depth, so the group steps together
+      while (*static_cast<const PageType *>(pm.getPage(pages[0])) ==
+             PageType::INTERNAL) {
+        for (size_t i = 0; i < g; i++) {
+          const InternalNode *node = pm.getInternalNode(pages[i]);
+          pages[i] = node->getChild(Search::childIndex(node, k[i]));
+          prefetchNodeSearch(pm.getPage(pages[i]), node->numKeys);
+        }
+      }
 
-    uint32_t pos = leaf->findPosition(key);
-    if (pos < leaf->numKeys && leaf->keys()[pos] == key) {
-      return leaf->getValue(pos);
+      for (size_t i = 0; i < g; i++) {
+        const LeafNode *leaf = pm.getLeafNode(pages[i]);
+        uint32_t pos = Search::leafSlot(leaf, k[i]);
+        const uint8_t *v = nullptr;
+        if (pos < leaf->numKeys && isLive(leaf, pos)) {
+          v = leaf->getValue(pos);
+          PREFETCH_READ(v);
+          PREFETCH_READ(v + DATA_SIZE - 1);
+          found++;
+        }
+        out[base + i] = v;
+      }
     }
+    return found;
+  }
 
-    return nullptr;
+  // Copying point lookup that is safe while a writer process modifies the
+  // file: the lookup is validated against the seqlock and retried if a
+  // write overlapped it. Returns true and fills out[DATA_SIZE] if found;
+  // false, without waiting forever, if the writer died in mid-write.
+  bool readDataShared(int32_t key, uint8_t *out) {
+    bool found = false;
+    sharedRead([&] {
+      if (!coord.isActive()) {
+        const uint8_t *v = lookup(key);
+        if (v)
+          std::memcpy(out, v, DATA_SIZE);
+        found = v != nullptr;
+        return true;
+      }
+
+      while (true) {
+        uint64_t seq;
+        found = false;
+        if (!coord.readBegin(seq))
+          return true; // The writer died mid-write
+
+        uint32_t leafId = findLeafChecked(key);
+        if (leafId != INVALID_PAGE) {
+          const LeafNode *leaf = pm.getLeafNode(leafId);
+          uint32_t pos = Search::leafSlot(leaf, key);
+          if (pos < leaf->numKeys && isLive(leaf, pos)) {
+            std::memcpy(out, leaf->getValue(pos), DATA_SIZE);
+            found = true;
+          }
+        }
+
+        if (pm.mappingIsShort())
+          return false; // The writer has grown the file
+        if (coord.readValidate(seq))
+          return true;
+      }
+    });
+    return found;
+  }
+
+  // Copying range scan with the same validation as readDataShared (and
+  // nothing copied after a writer died in mid-write). Tuples are appended
+  // to out (n * DATA_SIZE bytes). Retries the whole scan if a
+  // write overlapped it, so keep ranges short under heavy write load.
+  void readRangeShared(int32_t lowerKey, int32_t upperKey,
+                       std::vector<uint8_t> &out, uint32_t &n) {
+    bool full = false;
+    sharedRead([&] {
+      return copyRangeShared(lowerKey, upperKey, UINT32_MAX, nullptr, nullptr,
+                             out, full);
+    });
+    n = static_cast<uint32_t>(out.size() / DATA_SIZE);
+  }
+
+  // Chunked variant for snapshots: replaces keys/values with up to `limit`
+  // live records at or above fromKey, in key order, each chunk validated as
+  // a whole. Returns true if the chunk was cut short by the limit, i.e.
+  // the caller should continue from keys.back() + 1. Expiries (0 = never)
+  // are copied into *expiries if given.
+  bool scanShared(int32_t fromKey, uint32_t limit, std::vector<int32_t> &keys,
+                  std::vector<uint8_t> &values,
+                  std::vector<uint32_t> *expiries = nullptr) {
+    bool full = false;
+    sharedRead([&] {
+      return copyRangeShared(fromKey, INT32_MAX, std::max<uint32_t>(limit, 1),
+                             &keys, expiries, values, full);
+    });
+    return full;
   }
 
   // API: readRangeData(lowerKey, upperKey, n) - returns array of tuples
   // OPTIMIZED: Prefetch next leaf during scan
   std::vector<uint8_t *> readRangeData(int32_t lowerKey, int32_t upperKey,
                                        uint32_t &n) {
+    ReadGuard guard(locking);
     std::vector<uint8_t *> results;
     n = 0;
 
@@ -138,20 +640,30 @@ public:
     while (leafId != INVALID_PAGE) {
       LeafNode *leaf = pm.getLeafNode(leafId);
 
-      // Prefetch next leaf while processing current one
+      // A high fence at or past upperKey makes this the last leaf, so the
+      // next one is neither prefetched nor read
       uint32_t nextLeafId = leaf->nextLeaf;
+      if (leaf->hasFences() && leaf->highFence() >= upperKey)
+        nextLeafId = INVALID_PAGE;
+
+      // Prefetch next leaf while processing current one
       if (nextLeafId != INVALID_PAGE) {
         PREFETCH_READ(pm.getPage(nextLeafId));
       }
 
       const int32_t *leafKeys = leaf->keys();
-      for (uint32_t i = 0; i < leaf->numKeys; i++) {
+      const uint64_t dead = hiddenSlots(leaf);
+      uint8_t order[LEAF_MAX_KEYS];
+      const bool unsorted = leaf->tailCount != 0;
+      const uint32_t count = unsorted ? leaf->orderedSlots(order) : leaf->numKeys;
+      for (uint32_t j = 0; j < count; j++) {
+        const uint32_t i = unsorted ? order[j] : j;
         int32_t k = leafKeys[i];
         if (k > upperKey) {
           n = results.size();
           return results;
         }
-        if (k >= lowerKey) {
+        if (k >= lowerKey && !((dead >> i) & 1)) {
           results.push_back(const_cast<uint8_t *>(leaf->getValue(i)));
         }
       }
@@ -165,11 +677,1234 @@ public:
 
   // Get total record count
   uint32_t getRecordCount() const {
-    MetadataPage *meta = const_cast<PageManager &>(pm).getMetadata();
+    MetadataPage *meta = const_cast<PageManagerType &>(pm).getMetadata();
     return meta ? meta->numRecords : 0;
   }
 
+  // Pages allocated so far (high-water mark, including metadata)
+  uint32_t getPageCount() const {
+    MetadataPage *meta = const_cast<PageManagerType &>(pm).getMetadata();
+    return meta ? meta->numPages : 0;
+  }
+
+  // Pages on the free list; getPageCount() minus this is the pages in use
+  uint32_t getFreePageCount() {
+    ReadGuard guard(locking);
+    return pm.freePageCount();
+  }
+
+  // Per-tree split policy; fillPercent is used by FILL_FACTOR and by
+  // ADAPTIVE outside of sequential runs. Not persisted. Ignored when the
+  // tree was instantiated with a FixedSplit strategy.
+  void setSplitPolicy(SplitPolicy policy, uint32_t fillPercent = 50) {
+    if (!Split::runtime)
+      return;
+    splitPolicy = policy;
+    splitFillPercent = std::min<uint32_t>(std::max<uint32_t>(fillPercent, 1),
+                                          100);
+  }
+
+  SplitPolicy getSplitPolicy() const { return effectiveSplitPolicy(); }
+
+  // LAZY DELETION: deleteData only sets the slot's tombstone bit. A leaf is
+  // compacted in one pass once it holds compactThreshold tombstones, when it
+  // would otherwise split, or by purgeTombstones(). Tombstones are stored in
+  // the page, so readers honour them whether or not this is enabled.
+  void setLazyDelete(bool enabled, uint32_t threshold = LEAF_MAX_KEYS / 4) {
+    lazyDelete = enabled;
+    compactThreshold =
+        std::min<uint32_t>(std::max<uint32_t>(threshold, 1), LEAF_MAX_KEYS);
+  }
+
+  // UNSORTED TAIL: inserts append to up to `slots` unsorted entries at the
+  // end of each leaf, which are merged into the sorted region in one pass
+  // when the area fills or the leaf splits. Trades a short SIMD equality
+  // probe on lookups for shift-free random inserts. 0 disables; leaves that
+  // already have a tail stay readable either way.
+  void setUnsortedTail(uint32_t slots) {
+    tailSlots = std::min<uint32_t>(slots, LEAF_TAIL_MAX);
+  }
+
+  // SLOTTED VALUES: leaves created from now on (the root of an empty tree,
+  // bulk-loaded leaves) keep values in unordered slots behind a one-byte
+  // slot map, so in-leaf inserts and deletes move keys and slot bytes only.
+  // Capacity drops to LEAF_SLOTTED_MAX_KEYS. Each leaf records its format,
+  // and split halves inherit it, so this is not persisted.
+  void setSlottedValues(bool enabled) {
+    leafFlags = enabled ? LEAF_FLAG_SLOTTED : 0;
+  }
+
+  // Batch cleanup: compact every leaf that holds tombstones. Returns the
+  // number of slots reclaimed.
+  uint32_t purgeTombstones() {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE ||
+        pm.isReadOnly())
+      return 0;
+
+    SharedCoordinator::WriteScope scope(coord);
+    uint32_t reclaimed = 0;
+    for (uint32_t id = findLeaf(INT32_MIN); id != INVALID_PAGE;) {
+      LeafNode *leaf = pm.getLeafNode(id);
+      if (leaf->tombstones()) {
+        reclaimed += leaf->deadCount();
+        leaf->compact();
+      }
+      id = leaf->nextLeaf;
+    }
+    if (reclaimed)
+      pm.getMetadata()->lsn++;
+    return reclaimed;
+  }
+
+  // TTL LEAVES: leaves created from now on carry a per-entry expiry (so
+  // writeData can take expiresAt) at the cost of LEAF_TTL_MAX_KEYS capacity.
+  // Like slotted values, the format is recorded per leaf and inherited by
+  // split halves; enable it before the first write to cover the whole tree.
+  void setTtlLeaves(bool enabled) {
+    leafFlags = enabled ? leafFlags | LEAF_FLAG_TTL
+                        : leafFlags & ~LEAF_FLAG_TTL;
+  }
+
+  // The clock expiries are compared with, in seconds since the Unix epoch.
+  // pinClock fixes it (tests, replaying a log); 0 returns to the wall clock.
+  uint32_t clockNow() const { return nowSeconds(); }
+  void pinClock(uint32_t now) {
+    pinnedClock.store(now, std::memory_order_relaxed);
+  }
+
+  // EXPIRY SWEEP: removes up to maxKeys entries whose expiry has passed.
+  // Due keys come from the expiry index in expiry order, are sorted, and
+  // are removed leaf by leaf: one descent and one compaction per leaf.
+  // Each removal is a delete for the change stream. At most maxKeys index
+  // entries are examined, which bounds the time the write guard is held.
+  // Returns the number of records removed.
+  size_t sweepExpired(size_t maxKeys = SIZE_MAX) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE ||
+        pm.isReadOnly() || maxKeys == 0)
+      return 0;
+    if (!expiryIndexBuilt)
+      rebuildExpiryIndex();
+
+    const uint32_t now = nowSeconds();
+    std::vector<int32_t> due;
+    while (!expiryIndex.empty() && expiryIndex.begin()->first <= now &&
+           due.size() < maxKeys) {
+      std::vector<int32_t> &bucket = expiryIndex.begin()->second;
+      while (!bucket.empty() && due.size() < maxKeys) {
+        due.push_back(bucket.back());
+        bucket.pop_back();
+      }
+      if (bucket.empty())
+        expiryIndex.erase(expiryIndex.begin());
+    }
+    if (due.empty())
+      return 0;
+    std::sort(due.begin(), due.end());
+    due.erase(std::unique(due.begin(), due.end()), due.end());
+
+    SharedCoordinator::WriteScope scope(coord);
+    size_t removed = 0;
+    for (size_t i = 0; i < due.size();) {
+      const uint32_t leafId = findLeaf(due[i]);
+      LeafNode *leaf = pm.getLeafNode(leafId);
+      uint32_t marked = 0;
+      // Every due key the leaf's fences cover is handled in this visit
+      do {
+        uint32_t pos = Search::leafSlot(leaf, due[i]);
+        if (pos < leaf->numKeys && !leaf->isDead(pos) &&
+            leaf->isExpired(pos, now)) {
+          leaf->markDead(pos);
+          noteChange(ChangeOp::DELETE, due[i], nullptr);
+          marked++;
+        }
+        i++;
+      } while (i < due.size() && leaf->hasFences() && leaf->covers(due[i]));
+      if (!marked)
+        continue;
+
+      if (!lazyDelete || leaf->deadCount() >= compactThreshold)
+        leaf->compact();
+      meta->numRecords -= marked;
+      removed += marked;
+      if (leaf->liveCount() == 0 && leafId == meta->rootPageId) {
+        pm.freePage(leafId);
+        meta->rootPageId = INVALID_PAGE;
+        meta->bumpEpoch();
+        break;
+      }
+    }
+    if (removed)
+      meta->lsn++;
+    return removed;
+  }
+
+  // Keys waiting in the expiry index (stale entries included)
+  size_t pendingExpiries() const {
+    size_t n = 0;
+    for (const auto &bucket : expiryIndex)
+      n += bucket.second.size();
+    return n;
+  }
+
+  // BULK LOAD: streams strictly ascending records into an empty tree.
+  // Leaves are filled left to right to fillPercent, linked as they go, and
+  // the internal levels are built bottom-up alongside, so every page is
+  // written once, sequentially. The tree becomes visible at finish(). A
+  // failed append, or a loader dropped before finish(), frees the pages
+  // built so far and leaves the tree empty.
+  class BulkLoader {
+    BasicBPlusTree &tree;
+    LeafChainBuilder chain;
+    bool ok;
+    bool published = false;
+
+  public:
+    explicit BulkLoader(BasicBPlusTree &t, uint32_t fillPercent = 100)
+        : tree(t), chain(t.pm, t.leafFlags, fillPercent) {
+      const MetadataPage *meta = tree.pm.getMetadata();
+      ok = meta && meta->isValid() && !tree.pm.isReadOnly() &&
+           meta->rootPageId == INVALID_PAGE;
+    }
+
+    ~BulkLoader() {
+      WriteGuard guard(tree.locking);
+      if (!published)
+        chain.release();
+    }
+
+    // expiresAt needs TTL leaves (setTtlLeaves), as for writeData
+    bool append(int32_t key, const uint8_t *value, uint32_t expiresAt = 0) {
+      WriteGuard guard(tree.locking);
+      if (!ok || (chain.appended() > 0 && key <= chain.lastKey()) ||
+          (expiresAt && !(tree.leafFlags & LEAF_FLAG_TTL)) ||
+          !chain.append(key, value, expiresAt)) {
+        chain.release();
+        return ok = false;
+      }
+      if (expiresAt)
+        tree.expiryIndex[expiresAt].push_back(key);
+      tree.noteChange(ChangeOp::PUT, key, value, expiresAt);
+      return true;
+    }
+
+    // Publish the root. Returns false if any append failed.
+    bool finish() {
+      WriteGuard guard(tree.locking);
+      if (!ok)
+        return false;
+      SharedCoordinator::WriteScope scope(tree.coord);
+      MetadataPage *meta = tree.pm.getMetadata();
+      meta->rootPageId = chain.finish();
+      meta->numRecords = chain.appended();
+      meta->lsn++;
+      meta->bumpEpoch();
+      ok = false; // One-shot
+      published = true;
+      return true;
+    }
+
+    uint32_t appended() const { return chain.appended(); }
+  };
+
+  // Convenience wrapper: keys must be strictly ascending, tree empty
+  bool bulkLoad(const int32_t *keys, const uint8_t *values, size_t count,
+                uint32_t fillPercent = 100) {
+    BulkLoader loader(*this, fillPercent);
+    for (size_t i = 0; i < count; i++) {
+      if (!loader.append(keys[i], values + i * DATA_SIZE))
+        return false;
+    }
+    return loader.finish();
+  }
+
+  // PARALLEL BULK LOAD: as bulkLoad, with the leaf level built by up to
+  // `threads` workers (0 = one per core). Leaf boundaries follow from the
+  // fill factor alone, so all leaf pages are reserved as one contiguous
+  // range and each worker fills, links and checks the order of its own
+  // slice of it; no page is written by two threads. The internal levels,
+  // about 1/200 of the pages, are then built here by the LevelBuilder.
+  bool bulkLoadParallel(const int32_t *keys, const uint8_t *values,
+                        size_t count, uint32_t fillPercent = 100,
+                        unsigned threads = 0) {
+    WriteGuard guard(locking);
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly() ||
+        meta->rootPageId != INVALID_PAGE || count >= UINT32_MAX)
+      return false;
+
+    const uint32_t perLeaf =
+        percentOf(LeafNode::capacityFor(leafFlags), fillPercent);
+    const uint32_t leaves =
+        static_cast<uint32_t>((count + perLeaf - 1) / perLeaf);
+    const uint32_t first = leaves ? pm.allocateRange(leaves) : 0;
+    if (first == INVALID_PAGE)
+      return false;
+
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1u, std::min(threads, (leaves + 255) / 256));
+    std::atomic<bool> ordered{true};
+    auto build = [&](uint32_t from, uint32_t to) {
+      for (uint32_t i = from; i < to; i++) {
+        LeafNode *leaf = pm.getLeafNode(first + i);
+        leaf->init(leafFlags);
+        leaf->prevLeaf = i > 0 ? first + i - 1 : INVALID_PAGE;
+        leaf->nextLeaf = i + 1 < leaves ? first + i + 1 : INVALID_PAGE;
+        const size_t begin = size_t(i) * perLeaf;
+        const size_t end = std::min(count, begin + perLeaf);
+        for (size_t r = begin; r < end; r++) {
+          if (UNLIKELY(r > 0 && keys[r] <= keys[r - 1])) {
+            ordered = false;
+            return;
+          }
+          leaf->insertAt(leaf->numKeys, keys[r], values + r * DATA_SIZE);
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    const uint32_t slice = (leaves + threads - 1) / threads;
+    for (uint32_t from = slice; from < leaves; from += slice)
+      workers.emplace_back(build, from, std::min(leaves, from + slice));
+    build(0, std::min(leaves, slice));
+    for (std::thread &t : workers)
+      t.join();
+
+    LevelBuilder builder(pm, percentOf(INTERNAL_MAX_KEYS, fillPercent));
+    bool ok = ordered.load();
+    for (uint32_t i = 0; ok && i < leaves; i++) {
+      const size_t r = size_t(i) * perLeaf;
+      ok = builder.add(first + i,
+                       i > 0 ? shortestSeparator(keys[r - 1], keys[r])
+                             : keys[0]); // Also sets the fences
+    }
+    if (!ok) {
+      builder.release();
+      for (uint32_t i = 0; i < leaves; i++)
+        pm.freePage(first + i);
+      return false;
+    }
+    for (size_t r = 0; r < count; r++)
+      noteChange(ChangeOp::PUT, keys[r], values + r * DATA_SIZE);
+
+    SharedCoordinator::WriteScope scope(coord);
+    meta = pm.getMetadata();
+    meta->rootPageId = builder.finish();
+    meta->numRecords = static_cast<uint32_t>(count);
+    meta->lsn++;
+    meta->bumpEpoch();
+    return true;
+  }
+
+  // EXPORT: streams the live records, in key order, into a compressed
+  // sorted-run file (see interchange.hpp), reading the leaf chain once and
+  // writing sequentially. Expiries of TTL leaves are carried along.
+  // Returns the number of records written, or -1 on I/O failure.
+  int64_t exportTo(const std::string &path,
+                   uint32_t recordsPerBlock = EXPORT_BLOCK_RECORDS) {
+    ReadGuard guard(locking);
+    ExportWriter writer;
+    if (!writer.open(path, recordsPerBlock))
+      return -1;
+
+    for (LiveCursor c(*this); c.valid(); c.next()) {
+      if (!writer.add(c.key(), c.value(), c.expiry()))
+        return -1;
+    }
+    return writer.finish() ? static_cast<int64_t>(writer.records()) : -1;
+  }
+
+  // IMPORT: feeds an exported file block by block into the bottom-up bulk
+  // builder, so the tree is written once, sequentially. The tree must be
+  // empty; a file with expiries needs setTtlLeaves(true). On failure (a
+  // truncated or corrupt file) the tree stays empty and the loader frees
+  // the pages it built.
+  bool importFrom(const std::string &path, uint32_t fillPercent = 100) {
+    ImportReader reader;
+    if (!reader.open(path))
+      return false;
+    BulkLoader loader(*this, fillPercent);
+    size_t n;
+    while (reader.next(n)) {
+      if (n == 0)
+        return loader.finish();
+      for (size_t i = 0; i < n; i++) {
+        if (!loader.append(reader.keys()[i], reader.values() + i * DATA_SIZE,
+                           reader.expiries()[i]))
+          return false;
+      }
+    }
+    return false;
+  }
+
+  // MERGE: folds the live records of another tree (typically a partition
+  // built offline) into this one; on equal keys the other tree's record
+  // wins. Two strategies:
+  //  - The key ranges do not overlap and the other tree's leaves have this
+  //    tree's format: they are copied in page by page and spliced onto the
+  //    matching end of the leaf chain. Only the internal levels are rebuilt,
+  //    from the leaves' fences, so this tree's leaves are read but, apart
+  //    from the one at the seam, not written.
+  //  - Otherwise both leaf chains are merge-joined, in one sequential pass,
+  //    into freshly built leaves at fillPercent, and the old pages are freed.
+  // Tombstoned and expired records are dropped by the join and stay hidden
+  // after a splice. `other` is only read and may be open read-only.
+  // Returns the record count afterwards, or -1 with this tree unchanged
+  // and the pages built so far back on the free list.
+  int64_t merge(BasicBPlusTree &other, uint32_t fillPercent = 100) {
+    if (&other == this)
+      return -1;
+    WriteGuard guard(locking);
+    ReadGuard otherGuard(other.locking);
+    MetadataPage *meta = pm.getMetadata();
+    const MetadataPage *otherMeta = other.pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly() || !otherMeta ||
+        !otherMeta->isValid())
+      return -1;
+    if (otherMeta->rootPageId == INVALID_PAGE)
+      return meta->numRecords;
+
+    const uint32_t oldRoot = meta->rootPageId;
+    uint32_t root = INVALID_PAGE;
+    uint32_t records = meta->numRecords + otherMeta->numRecords;
+    // A splice rewrites the fences and links of the leaves at the seam,
+    // which readers of the old root still reach
+    SharedCoordinator::WriteScope scope(coord);
+    const bool spliced = spliceLeaves(other, fillPercent, root);
+    LiveCursor theirs(other);
+    if (!spliced && !mergeJoin(theirs, fillPercent, root, records))
+      return -1;
+    for (LiveCursor c(other); changes.isActive() && c.valid(); c.next())
+      noteChange(ChangeOp::PUT, c.key(), c.value(), c.expiry());
+
+    // A splice keeps the old leaves: only the internal nodes go
+    std::vector<uint32_t> oldPages;
+    collectPages(oldRoot, !spliced, oldPages);
+    for (uint32_t id : oldPages)
+      pm.freePage(id);
+    meta = pm.getMetadata();
+    meta->rootPageId = root;
+    meta->numRecords = records;
+    meta->lsn++;
+    meta->bumpEpoch();
+    if (leafFlags & LEAF_FLAG_TTL)
+      expiryIndexBuilt = false; // Rebuilt on the next sweep
+    return records;
+  }
+
+  // SPLIT: moves every record with a key >= splitKey into `upper`, an
+  // empty tree in another file, leaving two independent indexes (e.g. to
+  // reshard a hot one). The leaves right of the cut are copied page by page,
+  // sequentially, into a contiguous range of the new file; only the leaf
+  // holding splitKey is decoded and divided. Each side then gets its
+  // internal levels rebuilt from the leaves' fences. This file keeps its
+  // size: the pages that moved go on its free list. Returns the number of
+  // records moved, or -1 with both trees unchanged and any pages built in
+  // either file back on its free list.
+  int64_t splitAt(int32_t splitKey, BasicBPlusTree &upper) {
+    if (&upper == this)
+      return -1;
+    WriteGuard guard(locking);
+    WriteGuard upperGuard(upper.locking);
+    MetadataPage *meta = pm.getMetadata();
+    const MetadataPage *upperMeta = upper.pm.getMetadata();
+    if (!meta || !meta->isValid() || pm.isReadOnly() || !upperMeta ||
+        !upperMeta->isValid() || upper.pm.isReadOnly() ||
+        upperMeta->rootPageId != INVALID_PAGE)
+      return -1;
+    const uint32_t oldRoot = meta->rootPageId;
+    std::vector<uint32_t> chain;
+    if (!leafChain(*this, chain))
+      return -1;
+    if (chain.empty())
+      return 0;
+
+    // The cut leaf's entries on either side, dead ones dropped
+    const uint32_t cutId = findLeaf(splitKey);
+    const size_t cut = static_cast<size_t>(
+        std::find(chain.begin(), chain.end(), cutId) - chain.begin());
+    const LeafNode *cutLeaf = pm.getLeafNode(cutId);
+    const uint8_t format = cutLeaf->flags & ~LEAF_FLAG_FENCED;
+    struct Entry {
+      int32_t key;
+      uint32_t expiry;
+      uint8_t value[DATA_SIZE];
+    };
+    std::vector<Entry> below, above;
+    {
+      uint8_t order[LEAF_MAX_KEYS];
+      const bool unsorted = cutLeaf->tailCount != 0;
+      const uint32_t n =
+          unsorted ? cutLeaf->orderedSlots(order) : cutLeaf->numKeys;
+      for (uint32_t j = 0; j < n; j++) {
+        const uint32_t i = unsorted ? order[j] : j;
+        if (cutLeaf->isDead(i))
+          continue;
+        Entry e;
+        e.key = cutLeaf->keys()[i];
+        e.expiry = cutLeaf->expiryAt(i);
+        std::memcpy(e.value, cutLeaf->getValue(i), DATA_SIZE);
+        (e.key < splitKey ? below : above).push_back(e);
+      }
+    }
+
+    // Upper file: the top of the cut leaf, then copies of the leaves after it
+    const uint32_t copied = static_cast<uint32_t>(chain.size() - cut - 1);
+    const uint32_t upperLeaves = copied + (above.empty() ? 0 : 1);
+    uint64_t moved = above.size();
+    uint32_t upperRoot = INVALID_PAGE;
+    uint32_t first = INVALID_PAGE;
+    LevelBuilder upperBuilder(upper.pm), builder(pm);
+    // Until the write scope below neither tree is changed, so a failure
+    // only has to free what was built: the upper range and both levels
+    auto abandon = [&]() {
+      builder.release();
+      upperBuilder.release();
+      for (uint32_t i = 0; first != INVALID_PAGE && i < upperLeaves; i++)
+        upper.pm.freePage(first + i);
+      return int64_t(-1);
+    };
+    if (upperLeaves > 0) {
+      first = upper.pm.allocateRange(upperLeaves);
+      if (first == INVALID_PAGE)
+        return -1;
+      uint32_t id = first;
+      if (!above.empty()) {
+        LeafNode *leaf = upper.pm.getLeafNode(id++);
+        leaf->init(format);
+        for (const Entry &e : above)
+          leaf->insertAt(leaf->numKeys, e.key, e.value, e.expiry);
+      }
+      for (size_t i = cut + 1; i < chain.size(); i++, id++) {
+        const LeafNode *src = pm.getLeafNode(chain[i]);
+        std::memcpy(upper.pm.getPage(id), src, PAGE_SIZE);
+        moved += src->numKeys - POPCOUNT64(src->tombstones());
+      }
+      for (uint32_t i = 0; i < upperLeaves; i++) {
+        LeafNode *leaf = upper.pm.getLeafNode(first + i);
+        leaf->prevLeaf = i > 0 ? first + i - 1 : INVALID_PAGE;
+        leaf->nextLeaf = i + 1 < upperLeaves ? first + i + 1 : INVALID_PAGE;
+        if (!upperBuilder.add(first + i, i > 0 ? leaf->lowFence() : splitKey))
+          return abandon();
+      }
+      upperRoot = upperBuilder.finish();
+    }
+
+    // Lower levels, built before this tree is touched. The cut leaf stays
+    // unless nothing is left in it (and it is not the only leaf).
+    const bool keepCut = !below.empty() || cut == 0;
+    const size_t lowerLeaves = cut + (keepCut ? 1 : 0);
+    for (size_t i = 0; i < lowerLeaves; i++) {
+      if (!builder.add(chain[i], pm.getLeafNode(chain[i])->lowFence()))
+        return abandon();
+    }
+
+    SharedCoordinator::WriteScope scope(coord);
+    {
+      LeafNode *leaf = pm.getLeafNode(cutId);
+      const uint32_t prev = leaf->prevLeaf;
+      const int32_t low = leaf->lowFence(), high = leaf->highFence();
+      leaf->init(format);
+      leaf->prevLeaf = prev;
+      leaf->setFences(low, high);
+      for (const Entry &e : below)
+        leaf->insertAt(leaf->numKeys, e.key, e.value, e.expiry);
+    }
+    if (lowerLeaves > 0)
+      pm.getLeafNode(chain[lowerLeaves - 1])->nextLeaf = INVALID_PAGE;
+    const uint32_t lowerRoot =
+        below.empty() && cut == 0 ? INVALID_PAGE : builder.finish();
+
+    std::vector<uint32_t> oldPages;
+    collectPages(oldRoot, false, oldPages);
+    for (size_t i = lowerRoot == INVALID_PAGE ? 0 : lowerLeaves;
+         i < chain.size(); i++)
+      oldPages.push_back(chain[i]);
+    for (uint32_t id : oldPages)
+      pm.freePage(id);
+    meta = pm.getMetadata();
+    meta->rootPageId = lowerRoot;
+    meta->numRecords -= static_cast<uint32_t>(moved);
+    meta->lsn++;
+    meta->bumpEpoch();
+
+    {
+      SharedCoordinator::WriteScope upperScope(upper.coord);
+      MetadataPage *um = upper.pm.getMetadata();
+      um->rootPageId = upperRoot;
+      um->numRecords = static_cast<uint32_t>(moved);
+      um->lsn++;
+      um->bumpEpoch();
+    }
+    if (changes.isActive() || upper.changes.isActive()) {
+      for (LiveCursor c(upper); c.valid(); c.next()) {
+        noteChange(ChangeOp::DELETE, c.key(), nullptr);
+        upper.noteChange(ChangeOp::PUT, c.key(), c.value(), c.expiry());
+      }
+    }
+    expiryIndexBuilt = upper.expiryIndexBuilt = false;
+    return static_cast<int64_t>(moved);
+  }
+
 private:
+  FORCE_INLINE uint32_t nowSeconds() const {
+    const uint32_t pinned = pinnedClock.load(std::memory_order_relaxed);
+    return pinned ? pinned : static_cast<uint32_t>(std::time(nullptr));
+  }
+
+  // Neither tombstoned nor expired. The clock is only read for TTL leaves.
+  FORCE_INLINE bool isLive(const LeafNode *leaf, uint32_t pos) const {
+    if (leaf->isDead(pos))
+      return false;
+    return !UNLIKELY(leaf->hasExpiry()) || !leaf->isExpired(pos, nowSeconds());
+  }
+
+  // Slots scans must skip: tombstones, plus expired entries of TTL leaves
+  FORCE_INLINE uint64_t hiddenSlots(const LeafNode *leaf) const {
+    uint64_t hidden = leaf->tombstones();
+    if (UNLIKELY(leaf->hasExpiry()))
+      hidden |= leaf->expiredMask(nowSeconds());
+    return hidden;
+  }
+
+  // Live records of a tree in key order, decoded a leaf at a time. Holds
+  // page ids only, so the tree may grow (and remap) while a cursor is open.
+  class LiveCursor {
+    BasicBPlusTree &tree;
+    uint32_t leafId = INVALID_PAGE;
+    uint8_t order[LEAF_MAX_KEYS];
+    uint32_t count = 0;
+    uint32_t pos = 0;
+
+  public:
+    explicit LiveCursor(BasicBPlusTree &t) : tree(t) {
+      const MetadataPage *meta = t.pm.getMetadata();
+      if (meta && meta->isValid() && meta->rootPageId != INVALID_PAGE)
+        load(t.findLeaf(INT32_MIN));
+    }
+
+    bool valid() const { return leafId != INVALID_PAGE; }
+    int32_t key() const { return leaf()->keys()[order[pos]]; }
+    const uint8_t *value() const { return leaf()->getValue(order[pos]); }
+    uint32_t expiry() const { return leaf()->expiryAt(order[pos]); }
+    bool erased() const { return false; }
+    void next() {
+      if (++pos == count)
+        load(leaf()->nextLeaf);
+    }
+
+  private:
+    const LeafNode *leaf() const { return tree.pm.getLeafNode(leafId); }
+
+    // Position on the first live slot from leaf id onwards
+    void load(uint32_t id) {
+      for (leafId = id, pos = 0; leafId != INVALID_PAGE;
+           leafId = leaf()->nextLeaf) {
+        const LeafNode *l = leaf();
+        if (l->nextLeaf != INVALID_PAGE)
+          PREFETCH_READ(tree.pm.getPage(l->nextLeaf));
+        const uint64_t hidden = tree.hiddenSlots(l);
+        uint8_t slots[LEAF_MAX_KEYS];
+        const bool unsorted = l->tailCount != 0;
+        const uint32_t n = unsorted ? l->orderedSlots(slots) : l->numKeys;
+        count = 0;
+        for (uint32_t j = 0; j < n; j++) {
+          const uint32_t i = unsorted ? slots[j] : j;
+          if (!((hidden >> i) & 1))
+            order[count++] = static_cast<uint8_t>(i);
+        }
+        if (count > 0)
+          return;
+      }
+    }
+  };
+
+  // An applySorted batch seen as a cursor; erased() records delete their key
+  struct SortedSource {
+    const int32_t *keys;
+    const uint8_t *const *values;
+    const uint32_t *expiries;
+    size_t count;
+    size_t pos = 0;
+
+    bool valid() const { return pos < count; }
+    int32_t key() const { return keys[pos]; }
+    const uint8_t *value() const { return values[pos]; }
+    uint32_t expiry() const { return expiries ? expiries[pos] : 0; }
+    bool erased() const { return values[pos] == nullptr; }
+    void next() { pos++; }
+  };
+
+  // Smallest and largest key stored in a leaf, dead entries included.
+  // False for an empty leaf.
+  static bool keySpan(const LeafNode *leaf, int32_t &lo, int32_t &hi) {
+    if (leaf->numKeys == 0)
+      return false;
+    const int32_t *k = leaf->keys();
+    lo = hi = k[0];
+    for (uint32_t i = 1; i < leaf->numKeys; i++) {
+      lo = std::min(lo, k[i]);
+      hi = std::max(hi, k[i]);
+    }
+    return true;
+  }
+
+  // Page ids of a subtree, internal nodes first at each level; leaves only
+  // if asked for
+  void collectPages(uint32_t root, bool leaves, std::vector<uint32_t> &out) {
+    std::vector<uint32_t> stack;
+    if (root != INVALID_PAGE)
+      stack.push_back(root);
+    while (!stack.empty()) {
+      const uint32_t id = stack.back();
+      stack.pop_back();
+      const void *page = pm.getPage(id);
+      if (*static_cast<const PageType *>(page) == PageType::LEAF) {
+        if (leaves)
+          out.push_back(id);
+        continue;
+      }
+      const InternalNode *node = static_cast<const InternalNode *>(page);
+      out.push_back(id);
+      for (uint32_t i = 0; i <= node->numKeys; i++)
+        stack.push_back(node->getChild(i));
+    }
+  }
+
+  // Leaf chain of a tree in key order. False if a leaf has no fences or,
+  // when format is given, a different leaf format.
+  static bool leafChain(BasicBPlusTree &t, std::vector<uint32_t> &out,
+                        const uint8_t *format = nullptr) {
+    const MetadataPage *meta = t.pm.getMetadata();
+    if (meta->rootPageId == INVALID_PAGE)
+      return true;
+    for (uint32_t id = t.findLeaf(INT32_MIN); id != INVALID_PAGE;) {
+      const LeafNode *leaf = t.pm.getLeafNode(id);
+      if (!leaf->hasFences() ||
+          (format && (leaf->flags & ~LEAF_FLAG_FENCED) !=
+                         (*format & ~LEAF_FLAG_FENCED)))
+        return false;
+      out.push_back(id);
+      id = leaf->nextLeaf;
+    }
+    return true;
+  }
+
+  // Merge by splicing copied leaves; false, with this tree unchanged and
+  // the pages built freed again, when the ranges overlap, the formats
+  // differ or pages run out. The caller holds the write scope.
+  bool spliceLeaves(BasicBPlusTree &other, uint32_t fillPercent,
+                    uint32_t &root) {
+    std::vector<uint32_t> mine, theirs;
+    if (!leafChain(*this, mine) || !leafChain(other, theirs, &leafFlags) ||
+        theirs.empty())
+      return false;
+
+    int32_t myLo = 0, myHi = 0, theirLo, theirHi, unused;
+    if (!keySpan(other.pm.getLeafNode(theirs.front()), theirLo, unused) ||
+        !keySpan(other.pm.getLeafNode(theirs.back()), unused, theirHi))
+      return false;
+    if (!mine.empty() &&
+        (!keySpan(pm.getLeafNode(mine.front()), myLo, unused) ||
+         !keySpan(pm.getLeafNode(mine.back()), unused, myHi)))
+      return false;
+    const bool append = mine.empty() || myHi < theirLo;
+    if (!append && theirHi >= myLo)
+      return false; // Overlap
+
+    const uint32_t n = static_cast<uint32_t>(theirs.size());
+    const uint32_t first = pm.allocateRange(n);
+    if (first == INVALID_PAGE)
+      return false;
+    for (uint32_t i = 0; i < n; i++) {
+      LeafNode *leaf = pm.getLeafNode(first + i);
+      std::memcpy(leaf, other.pm.getPage(theirs[i]), PAGE_SIZE);
+      leaf->prevLeaf = i > 0 ? first + i - 1 : INVALID_PAGE;
+      leaf->nextLeaf = i + 1 < n ? first + i + 1 : INVALID_PAGE;
+    }
+
+    std::vector<uint32_t> chain;
+    chain.reserve(mine.size() + n);
+    if (append)
+      chain.insert(chain.end(), mine.begin(), mine.end());
+    for (uint32_t i = 0; i < n; i++)
+      chain.push_back(first + i);
+    if (!append)
+      chain.insert(chain.end(), mine.begin(), mine.end());
+
+    // Every leaf keeps its low fence as separator, except the first one
+    // past the seam
+    const size_t seam = mine.empty() ? 0 : append ? mine.size() : n;
+    const int32_t seamKey = append ? shortestSeparator(myHi, theirLo)
+                                   : shortestSeparator(theirHi, myLo);
+    int32_t saved[4] = {};
+    if (seam > 0) {
+      const LeafNode *l = pm.getLeafNode(chain[seam - 1]);
+      const LeafNode *r = pm.getLeafNode(chain[seam]);
+      saved[0] = l->lowFence(), saved[1] = l->highFence();
+      saved[2] = r->lowFence(), saved[3] = r->highFence();
+    }
+    LevelBuilder builder(pm, percentOf(INTERNAL_MAX_KEYS, fillPercent));
+    for (size_t i = 0; i < chain.size(); i++) {
+      const int32_t low = i == seam && seam > 0
+                              ? seamKey
+                              : pm.getLeafNode(chain[i])->lowFence();
+      if (!builder.add(chain[i], low)) {
+        if (seam > 0) {
+          pm.getLeafNode(chain[seam - 1])->setFences(saved[0], saved[1]);
+          pm.getLeafNode(chain[seam])->setFences(saved[2], saved[3]);
+        }
+        builder.release();
+        for (uint32_t j = 0; j < n; j++)
+          pm.freePage(first + j);
+        return false;
+      }
+    }
+    root = builder.finish();
+    if (seam > 0) {
+      pm.getLeafNode(chain[seam - 1])->nextLeaf = chain[seam];
+      pm.getLeafNode(chain[seam])->prevLeaf = chain[seam - 1];
+    }
+    return true;
+  }
+
+  // Merge by a sequential merge join of this tree's live records with an
+  // ascending source (a LiveCursor of another tree, or a SortedSource) into
+  // new leaves; the source wins on equal keys and its erased() records
+  // only remove. This tree's old pages are untouched, and on failure the
+  // pages built are freed again.
+  template <typename Source>
+  bool mergeJoin(Source &theirs, uint32_t fillPercent, uint32_t &root,
+                 uint32_t &records) {
+    LeafChainBuilder chain(pm, leafFlags, fillPercent);
+    LiveCursor mine(*this);
+    uint8_t value[DATA_SIZE]; // A new leaf may remap the page it lives on
+    while (mine.valid() || theirs.valid()) {
+      if (mine.valid() && (!theirs.valid() || mine.key() < theirs.key())) {
+        const uint32_t expiry = mine.expiry();
+        std::memcpy(value, mine.value(), DATA_SIZE);
+        if (!chain.append(mine.key(), value, expiry)) {
+          chain.release();
+          return false;
+        }
+        mine.next();
+        continue;
+      }
+      if (mine.valid() && mine.key() == theirs.key())
+        mine.next(); // Replaced or erased
+      if (!theirs.erased()) {
+        const uint32_t expiry = theirs.expiry();
+        std::memcpy(value, theirs.value(), DATA_SIZE);
+        if ((expiry && !(leafFlags & LEAF_FLAG_TTL)) ||
+            !chain.append(theirs.key(), value, expiry)) {
+          chain.release();
+          return false;
+        }
+      }
+      theirs.next();
+    }
+    root = chain.finish();
+    records = chain.appended();
+    return true;
+  }
+
+  // Entries per node at a bulk-load fill factor, at least 2
+  static uint32_t percentOf(uint32_t capacity, uint32_t pct) {
+    uint32_t n = capacity * std::min<uint32_t>(pct, 100) / 100;
+    return std::max<uint32_t>(n, 2);
+  }
+
+  FORCE_INLINE void noteChange(ChangeOp op, int32_t key, const uint8_t *value,
+                               uint32_t expiresAt = 0) {
+    if (UNLIKELY(changes.isActive()))
+      changes.publish(op, key, value, expiresAt);
+  }
+
+  // One pass over the leaves to index every expiry written before open()
+  void rebuildExpiryIndex() {
+    expiryIndex.clear();
+    for (uint32_t id = findLeaf(INT32_MIN); id != INVALID_PAGE;) {
+      const LeafNode *leaf = pm.getLeafNode(id);
+      for (uint32_t i = 0; leaf->hasExpiry() && i < leaf->numKeys; i++) {
+        const uint32_t e = leaf->expiryAt(i);
+        if (e && !leaf->isDead(i))
+          expiryIndex[e].push_back(leaf->keys()[i]);
+      }
+      id = leaf->nextLeaf;
+    }
+    expiryIndexBuilt = true;
+  }
+
+  // Point lookup without taking the guard
+  const uint8_t *lookup(int32_t key) {
+    MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid() || meta->rootPageId == INVALID_PAGE)
+      return nullptr;
+
+    uint32_t leafId = findLeaf(key);
+    LeafNode *leaf = pm.getLeafNode(leafId);
+
+    uint32_t pos = Search::leafSlot(leaf, key);
+    if (pos < leaf->numKeys && isLive(leaf, pos)) {
+      return leaf->getValue(pos);
+    }
+
+    return nullptr;
+  }
+
+  // Runs a shared read under the ReadGuard. A read that reached past the
+  // mapping returns false and is rerun once the file has been remapped
+  // under the WriteGuard: a remap moves the pages other readers are using.
+  template <typename Read> void sharedRead(Read read) {
+    while (true) {
+      {
+        ReadGuard guard(locking);
+        if (read())
+          return;
+      }
+      WriteGuard guard(locking);
+      pm.refresh();
+    }
+  }
+
+  // Body of the shared scans: copies live records in [lowerKey, upperKey]
+  // into out (and their keys and expiries into *keys / *expiries if given),
+  // stopping after `limit`; full says whether it stopped on the limit.
+  // Returns false if the mapping must be refreshed first (see sharedRead).
+  bool copyRangeShared(int32_t lowerKey, int32_t upperKey, uint32_t limit,
+                       std::vector<int32_t> *keys,
+                       std::vector<uint32_t> *expiries,
+                       std::vector<uint8_t> &out, bool &full) {
+    while (true) {
+      uint64_t seq = 0;
+      out.clear();
+      if (keys)
+        keys->clear();
+      if (expiries)
+        expiries->clear();
+      full = false;
+      if (coord.isActive() && !coord.readBegin(seq))
+        return true; // The writer died mid-write: nothing to copy
+
+      bool torn = false;
+      uint32_t copied = 0;
+      uint32_t leafId = findLeafChecked(lowerKey);
+      uint32_t hops = 0;
+      const MetadataPage *meta = pm.getMetadata();
+      const uint32_t numPages = meta ? meta->numPages : 0;
+
+      while (leafId != INVALID_PAGE) {
+        const LeafNode *leaf = pm.getLeafNode(leafId);
+        if (!leaf || leaf->type != PageType::LEAF ||
+            leaf->numKeys > LEAF_MAX_KEYS || ++hops > numPages) {
+          torn = true;
+          break;
+        }
+
+        bool done = false;
+        const int32_t *leafKeys = leaf->keys();
+        const uint64_t dead = hiddenSlots(leaf);
+        uint8_t order[LEAF_MAX_KEYS];
+        const bool unsorted = leaf->tailCount != 0;
+        const uint32_t n = unsorted ? leaf->orderedSlots(order) : leaf->numKeys;
+        for (uint32_t j = 0; j < n; j++) {
+          const uint32_t i = unsorted ? order[j] : j;
+          int32_t k = leafKeys[i];
+          if (k > upperKey) {
+            done = true;
+            break;
+          }
+          if (k >= lowerKey && !((dead >> i) & 1)) {
+            if (copied == limit) {
+              done = full = true;
+              break;
+            }
+            const uint8_t *v = leaf->getValue(i);
+            out.insert(out.end(), v, v + DATA_SIZE);
+            if (keys)
+              keys->push_back(k);
+            if (expiries)
+              expiries->push_back(leaf->expiryAt(i));
+            copied++;
+          }
+        }
+        // The high fence says whether the next leaf can hold anything
+        if (done || (leaf->hasFences() && leaf->highFence() >= upperKey))
+          break;
+        leafId = leaf->nextLeaf;
+      }
+
+      if (pm.mappingIsShort())
+        return false;
+      if (!coord.isActive() || (!torn && coord.readValidate(seq)))
+        return true;
+    }
+  }
+
+  // One delete; the caller holds the guard and the write scope. hint is as
+  // for insertOne.
+  bool removeOne(int32_t key, uint32_t &hint) {
+    MetadataPage *meta = pm.getMetadata();
+    if (meta->rootPageId == INVALID_PAGE)
+      return false;
+    const LeafNode *last =
+        hint == INVALID_PAGE ? nullptr : pm.getLeafNode(hint);
+    uint32_t leafId = last && last->hasFences() && last->covers(key)
+                          ? hint
+                          : findLeaf(key);
+    hint = leafId;
+    LeafNode *leaf = pm.getLeafNode(leafId);
+
+    uint32_t pos = Search::leafSlot(leaf, key);
+    if (pos >= leaf->numKeys || !isLive(leaf, pos)) {
+      return false; // Key not found (expired ones are left to the sweeper)
+    }
+
+    if (lazyDelete) {
+      // O(1): flag the slot, shift nothing until enough have piled up
+      leaf->markDead(pos);
+      if (leaf->deadCount() >= compactThreshold)
+        leaf->compact();
+    } else {
+      leaf->removeAt(pos);
+    }
+    meta->numRecords--;
+    meta->lsn++;
+    noteChange(ChangeOp::DELETE, key, nullptr);
+
+    // Simple approach: don't merge/redistribute for now
+    // Production code would handle underflow here
+
+    // If root leaf becomes empty, reset tree
+    if (leaf->liveCount() == 0 && leafId == meta->rootPageId) {
+      // Check if it's a leaf (not internal)
+      if (leaf->type == PageType::LEAF) {
+        pm.freePage(leafId);
+        meta->rootPageId = INVALID_PAGE;
+        meta->bumpEpoch();
+        hint = INVALID_PAGE;
+      }
+    }
+
+    return true;
+  }
+
+  // One insert or update; the caller holds the guard and the write scope.
+  // hint is the leaf the previous insert of a batch went to (INVALID_PAGE
+  // if none) and is updated to this one.
+  bool insertOne(int32_t key, const uint8_t *data, uint32_t &hint,
+                 uint32_t expiresAt = 0) {
+    MetadataPage *meta = pm.getMetadata();
+    meta->lsn++;
+    noteInsertKey(key);
+
+    // Tree is empty - create root leaf
+    if (meta->rootPageId == INVALID_PAGE) {
+      if (expiresAt && !(leafFlags & LEAF_FLAG_TTL))
+        return false;
+      uint32_t rootId = pm.allocatePage();
+      if (rootId == INVALID_PAGE)
+        return false;
+
+      LeafNode *root = pm.getLeafNode(rootId);
+      root->init(leafFlags);
+      root->setFences(INT32_MIN, INT32_MAX);
+      root->insertAt(0, key, data, expiresAt);
+
+      meta->rootPageId = rootId;
+      meta->numRecords = 1;
+      meta->bumpEpoch();
+      hint = rootId;
+      return true;
+    }
+
+    // Find leaf for insertion, reusing the hint if its fences cover key
+    const LeafNode *last =
+        hint == INVALID_PAGE ? nullptr : pm.getLeafNode(hint);
+    uint32_t leafId = last && last->hasFences() && last->covers(key)
+                          ? hint
+                          : findLeaf(key);
+    hint = leafId;
+    LeafNode *leaf = pm.getLeafNode(leafId);
+    if (expiresAt && !leaf->hasExpiry())
+      return false; // Leaf predates setTtlLeaves
+
+    // Check for duplicate key
+    uint32_t pos = Search::leafSlot(leaf, key);
+    if (pos < leaf->numKeys) {
+      // Update existing (reviving it if it was lazily deleted)
+      std::memcpy(leaf->getValue(pos), data, DATA_SIZE);
+      if (leaf->hasExpiry())
+        leaf->expiries()[pos] = expiresAt;
+      if (UNLIKELY(leaf->isDead(pos))) {
+        leaf->clearDead(pos);
+        meta->numRecords++;
+      }
+      return true;
+    }
+
+    // Reclaim tombstones and fold the tail in before resorting to a split
+    if (leaf->isFull() || (tailSlots && leaf->tailCount >= tailSlots))
+      leaf->mergeTail();
+
+    // Leaf has space
+    if (!leaf->isFull()) {
+      if (tailSlots)
+        leaf->appendToTail(key, data, expiresAt);
+      else
+        leaf->insertAt(leaf->findPosition(key), key, data, expiresAt);
+      meta->numRecords++;
+      return true;
+    }
+
+    // Need to split
+    return insertAndSplit(leafId, key, data, expiresAt);
+  }
+
+  bool recoverIfNeeded() {
+    recovery = RecoveryStats();
+    if (!pm.needsRecovery())
+      return true;
+    if (!recover()) {
+      pm.close();
+      return false;
+    }
+    pm.clearRecoveryNeeded();
+    pm.sync();
+    return true;
+  }
+
+  // Leftmost leaf reached by descending child 0, or INVALID_PAGE if the
+  // internal levels look damaged
+  uint32_t findHeadLeafFromRoot() {
+    const MetadataPage *meta = pm.getMetadata();
+    uint32_t pageId = meta->rootPageId;
+    for (uint32_t depth = 0; depth < MAX_TREE_DEPTH; depth++) {
+      if (pageId == 0 || pageId >= meta->numPages)
+        return INVALID_PAGE;
+      const void *page = pm.getPage(pageId);
+      PageType type = *static_cast<const PageType *>(page);
+      if (type == PageType::LEAF) {
+        const LeafNode *leaf = static_cast<const LeafNode *>(page);
+        return leaf->prevLeaf == INVALID_PAGE ? pageId : INVALID_PAGE;
+      }
+      if (type != PageType::INTERNAL)
+        return INVALID_PAGE;
+      pageId = static_cast<const InternalNode *>(page)->getChild(0);
+    }
+    return INVALID_PAGE;
+  }
+
+  static bool leafLooksSane(const LeafNode *leaf) {
+    if (leaf->type != PageType::LEAF || leaf->numKeys > leaf->capacity() ||
+        leaf->tailCount > std::min(leaf->numKeys, LEAF_TAIL_MAX) ||
+        (leaf->tombstones() >> leaf->numKeys) != 0)
+      return false;
+    for (uint32_t i = 0; leaf->isSlotted() && i < leaf->numKeys; i++) {
+      if (leaf->slotMap()[i] >= LEAF_SLOTTED_MAX_KEYS)
+        return false;
+    }
+    const int32_t *k = leaf->keys();
+    for (uint32_t i = 1; i < leaf->sortedCount(); i++) {
+      if (k[i - 1] >= k[i])
+        return false;
+    }
+    return true;
+  }
+
+  // FAST RECOVERY: the leaf chain is the source of truth. Walk it once,
+  // unlink empty or damaged leaves, then rebuild the internal levels
+  // bottom-up and regenerate numRecords and the free list. Cost is one
+  // sequential pass over the leaves instead of re-inserting every record.
+  bool recover() {
+    MetadataPage *meta = pm.getMetadata();
+    const uint32_t oldNumPages = meta->numPages;
+    recovery.performed = true;
+
+    uint32_t head = meta->rootPageId == INVALID_PAGE ? INVALID_PAGE
+                                                     : findHeadLeafFromRoot();
+    if (head == INVALID_PAGE && meta->rootPageId != INVALID_PAGE) {
+      // Internal levels unusable: look for a chain head directly
+      for (uint32_t id = 1; id < oldNumPages && head == INVALID_PAGE; id++) {
+        const LeafNode *leaf = pm.getLeafNode(id);
+        if (leafLooksSane(leaf) && leaf->prevLeaf == INVALID_PAGE &&
+            leaf->numKeys > 0)
+          head = id;
+      }
+    }
+
+    std::vector<bool> used(oldNumPages, false);
+    used[0] = true;
+
+    // New internal nodes must not come from a possibly damaged free list
+    meta->freeListHead = INVALID_PAGE;
+    meta->rootPageId = INVALID_PAGE;
+
+    LevelBuilder builder(pm);
+    uint32_t prevId = INVALID_PAGE;
+    int32_t prevMax = 0;
+    uint32_t records = 0;
+
+    for (uint32_t id = head; id != INVALID_PAGE;) {
+      if (id == 0 || id >= oldNumPages || used[id])
+        break; // Out of range or a cycle: the chain ends here
+      LeafNode *leaf = pm.getLeafNode(id);
+      if (!leafLooksSane(leaf)) {
+        recovery.droppedLeaves++;
+        break;
+      }
+      uint32_t next = leaf->nextLeaf;
+
+      leaf->mergeTail(); // Drop tombstones, order the tail: ends are exact
+      if (leaf->numKeys == 0 ||
+          (prevId != INVALID_PAGE && leaf->keys()[0] <= prevMax)) {
+        recovery.droppedLeaves++;
+        id = next;
+        continue;
+      }
+
+      used[id] = true;
+      leaf->prevLeaf = prevId;
+      if (prevId != INVALID_PAGE)
+        pm.getLeafNode(prevId)->nextLeaf = id;
+      if (!builder.add(id, prevId == INVALID_PAGE
+                               ? leaf->keys()[0]
+                               : shortestSeparator(prevMax, leaf->keys()[0])))
+        return false;
+
+      leaf = pm.getLeafNode(id); // builder may have grown the mapping
+      prevMax = leaf->keys()[leaf->numKeys - 1];
+      records += leaf->numKeys;
+      recovery.leaves++;
+      prevId = id;
+      id = next;
+    }
+    if (prevId != INVALID_PAGE)
+      pm.getLeafNode(prevId)->nextLeaf = INVALID_PAGE;
+
+    meta = pm.getMetadata();
+    meta->rootPageId = builder.finish();
+    meta->numRecords = records;
+    recovery.records = records;
+
+    // Everything else below the old high-water mark is garbage now.
+    // Freed in descending order so allocation proceeds upwards.
+    for (uint32_t id = oldNumPages; id-- > 1;) {
+      if (!used[id]) {
+        pm.freePage(id);
+        recovery.freedPages++;
+      }
+    }
+
+    meta = pm.getMetadata();
+    meta->checkpointLsn = meta->lsn;
+    meta->bumpEpoch();
+    return true;
+  }
+
   // Find leaf node containing key - OPTIMIZED with prefetching
   uint32_t findLeaf(int32_t key) {
     MetadataPage *meta = pm.getMetadata();
@@ -184,71 +1919,129 @@ private:
       }
 
       InternalNode *node = static_cast<InternalNode *>(page);
-      uint32_t childIdx = node->findChildIndex(key);
+      uint32_t childIdx = Search::childIndex(node, key);
       pageId = node->getChild(childIdx);
 
-      // Prefetch next node - safe since we're only reading
-      PREFETCH_READ(pm.getPage(pageId));
+      // Prefetch the lines the child's search will touch - safe since
+      // we're only reading
+      prefetchNodeSearch(pm.getPage(pageId), node->numKeys);
     }
   }
 
-  // Insert with splitting
-  bool insertAndSplit(uint32_t leafId, int32_t key, const uint8_t *data) {
-    MetadataPage *meta = pm.getMetadata();
-    LeafNode *leaf = pm.getLeafNode(leafId);
-
-    // Create temporary arrays with all entries + new entry
-    const uint32_t totalKeys = leaf->numKeys + 1;
-    std::vector<int32_t> tempKeys(totalKeys);
-    std::vector<uint8_t> tempValues(totalKeys * DATA_SIZE);
+  // Defensive descent for optimistic readers: a concurrent writer can leave
+  // any field torn, so every page id, type and count is range-checked.
+  // Returns INVALID_PAGE if the tree is empty or looked inconsistent.
+  uint32_t findLeafChecked(int32_t key) {
+    const MetadataPage *meta = pm.getMetadata();
+    if (!meta || !meta->isValid())
+      return INVALID_PAGE;
 
-    // Copy existing entries
-    const int32_t *leafKeys = leaf->keys();
-    const uint8_t *leafVals = leaf->values();
+    const uint32_t numPages = meta->numPages;
+    uint32_t pageId = meta->rootPageId;
 
-    uint32_t pos = leaf->findPosition(key);
+    for (uint32_t depth = 0; depth < MAX_TREE_DEPTH; depth++) {
+      if (pageId == 0 || pageId >= numPages)
+        return INVALID_PAGE;
+      const void *page = pm.getPage(pageId);
+      if (!page)
+        return INVALID_PAGE;
+
+      PageType type = *static_cast<const PageType *>(page);
+      // A node whose fences exclude the key was reached through a torn
+      // pointer (or is corrupt): report it instead of searching it
+      if (type == PageType::LEAF) {
+        const LeafNode *leaf = static_cast<const LeafNode *>(page);
+        return leaf->numKeys <= LEAF_MAX_KEYS && leaf->covers(key)
+                   ? pageId
+                   : INVALID_PAGE;
+      }
+      if (type != PageType::INTERNAL)
+        return INVALID_PAGE;
 
-    // Copy keys before insertion point
-    for (uint32_t i = 0; i < pos; i++) {
-      tempKeys[i] = leafKeys[i];
-      std::memcpy(&tempValues[i * DATA_SIZE], leaf->getValue(i), DATA_SIZE);
+      const InternalNode *node = static_cast<const InternalNode *>(page);
+      if (node->numKeys > INTERNAL_KEY_SLOTS || !node->covers(key))
+        return INVALID_PAGE;
+      pageId = node->getChild(Search::childIndex(node, key));
     }
+    return INVALID_PAGE;
+  }
 
-    // Insert new entry
-    tempKeys[pos] = key;
-    std::memcpy(&tempValues[pos * DATA_SIZE], data, DATA_SIZE);
+  FORCE_INLINE void noteInsertKey(int32_t key) {
+    if (effectiveSplitPolicy() != SplitPolicy::ADAPTIVE)
+      return;
+    if (key > lastInsertKey)
+      insertRun = insertRun > 0 ? std::min(insertRun + 1, ADAPTIVE_RUN) : 1;
+    else
+      insertRun = insertRun < 0 ? std::max(insertRun - 1, -ADAPTIVE_RUN) : -1;
+    lastInsertKey = key;
+  }
+
+  // A FixedSplit strategy folds to a constant here
+  FORCE_INLINE SplitPolicy effectiveSplitPolicy() const {
+    return Split::runtime ? splitPolicy : Split::policy;
+  }
 
-    // Copy keys after insertion point
-    for (uint32_t i = pos; i < leaf->numKeys; i++) {
-      tempKeys[i + 1] = leafKeys[i];
-      std::memcpy(&tempValues[(i + 1) * DATA_SIZE], leaf->getValue(i),
-                  DATA_SIZE);
+  // Left-side entry count for splitting `total` entries (existing + new),
+  // clamped to [1, total - minRight]. Leaves pass 1 so the right keeps an
+  // entry; internal nodes pass 2 since one key is promoted as well.
+  uint32_t chooseSplitPoint(uint32_t total, bool atEnd, bool atStart,
+                            uint32_t minRight) const {
+    uint32_t sp = (total + 1) / 2;
+    SplitPolicy p = effectiveSplitPolicy();
+    if (p == SplitPolicy::ADAPTIVE) {
+      bool run = (atEnd && insertRun >= ADAPTIVE_RUN) ||
+                 (atStart && insertRun <= -ADAPTIVE_RUN);
+      p = run ? SplitPolicy::APPEND_AWARE : SplitPolicy::FILL_FACTOR;
     }
 
-    // Create new leaf
+    switch (p) {
+    case SplitPolicy::APPEND_AWARE:
+      if (atEnd)
+        sp = total;
+      else if (atStart)
+        sp = 1;
+      break;
+    case SplitPolicy::FILL_FACTOR:
+      sp = (total * (Split::runtime ? splitFillPercent : Split::fillPercent) +
+            50) /
+           100;
+      break;
+    default:
+      break;
+    }
+    return std::max<uint32_t>(1, std::min(sp, total - minRight));
+  }
+
+  // Insert with splitting - allocation-free: the split point is chosen up
+  // front, the upper half moves to the new leaf with two bulk memcpys and
+  // the new entry is then placed directly into whichever half owns it
+  bool insertAndSplit(uint32_t leafId, int32_t key, const uint8_t *data,
+                      uint32_t expiresAt) {
+    // Allocate first: growing the file may move the mapping
     uint32_t newLeafId = pm.allocatePage();
     if (newLeafId == INVALID_PAGE)
       return false;
 
+    MetadataPage *meta = pm.getMetadata();
+    LeafNode *leaf = pm.getLeafNode(leafId);
     LeafNode *newLeaf = pm.getLeafNode(newLeafId);
     newLeaf->init();
 
-    // Split point
-    uint32_t splitPoint = (totalKeys + 1) / 2;
-
-    // Reinitialize old leaf
-    leaf->numKeys = 0;
-    for (uint32_t i = 0; i < splitPoint; i++) {
-      leaf->insertAt(i, tempKeys[i], &tempValues[i * DATA_SIZE]);
-    }
-    leaf->numKeys = splitPoint;
-
-    // Fill new leaf
-    for (uint32_t i = splitPoint; i < totalKeys; i++) {
-      newLeaf->insertAt(i - splitPoint, tempKeys[i],
-                        &tempValues[i * DATA_SIZE]);
+    const uint32_t totalKeys = leaf->numKeys + 1;
+    const uint32_t pos = leaf->findPosition(key);
+
+    // Split point: entries kept by the left leaf
+    const bool atEnd = pos == leaf->numKeys;
+    uint32_t splitPoint = chooseSplitPoint(totalKeys, atEnd, pos == 0, 1);
+
+    if (pos < splitPoint) {
+      // New entry belongs left: one more existing entry moves right
+      leaf->moveTailTo(newLeaf, splitPoint - 1);
+      leaf->insertAt(pos, key, data, expiresAt);
+    } else {
+      leaf->moveTailTo(newLeaf, splitPoint);
+      newLeaf->insertAt(pos - splitPoint, key, data, expiresAt);
     }
-    newLeaf->numKeys = totalKeys - splitPoint;
 
     // Update sibling pointers
     newLeaf->nextLeaf = leaf->nextLeaf;
@@ -260,8 +2053,10 @@ private:
       nextLeaf->prevLeaf = newLeafId;
     }
 
-    // Insert separator into parent
-    int32_t separatorKey = newLeaf->keys()[0];
+    // Insert the shortest separator between the two halves into the parent
+    int32_t separatorKey = shortestSeparator(leaf->keys()[leaf->numKeys - 1],
+                                             newLeaf->keys()[0]);
+    leaf->splitFencesWith(newLeaf, separatorKey);
     meta->numRecords++;
 
     return insertIntoParent(leafId, separatorKey, newLeafId);
@@ -283,30 +2078,21 @@ private:
       newRoot->setKey(0, key);
       newRoot->setChild(1, rightId);
       newRoot->numKeys = 1;
+      newRoot->setFences(INT32_MIN, INT32_MAX);
 
       meta->rootPageId = newRootId;
+      meta->bumpEpoch();
       return true;
     }
 
     // Find parent (simplified: traverse from root)
-    uint32_t parentId = findParent(meta->rootPageId, leftId);
+    uint32_t parentId = findParentByKey(leftId);
+    if (parentId == INVALID_PAGE)
+      parentId = findParent(meta->rootPageId, leftId);
     InternalNode *parent = pm.getInternalNode(parentId);
 
-    // Find position for new key
-    uint32_t pos = 0;
-    while (pos < parent->numKeys && parent->getKey(pos) < key) {
-      pos++;
-    }
-
     if (!parent->isFull()) {
-      // Shift and insert
-      for (uint32_t i = parent->numKeys; i > pos; i--) {
-        parent->setKey(i, parent->getKey(i - 1));
-        parent->setChild(i + 1, parent->getChild(i));
-      }
-      parent->setKey(pos, key);
-      parent->setChild(pos + 1, rightId);
-      parent->numKeys++;
+      parent->insertAt(parent->findInsertPosition(key), key, rightId);
       return true;
     }
 
@@ -314,7 +2100,38 @@ private:
     return splitInternal(parentId, key, rightId);
   }
 
-  // Find parent of a node
+  // Find parent of a node by descending with one of its own keys: O(height)
+  // pages instead of visiting every child of every internal node
+  uint32_t findParentByKey(uint32_t childId) {
+    const void *childPage = pm.getPage(childId);
+    int32_t routeKey;
+    if (*static_cast<const PageType *>(childPage) == PageType::LEAF) {
+      const LeafNode *leaf = static_cast<const LeafNode *>(childPage);
+      if (leaf->numKeys == 0)
+        return INVALID_PAGE;
+      routeKey = leaf->keys()[0];
+    } else {
+      const InternalNode *node = static_cast<const InternalNode *>(childPage);
+      if (node->numKeys == 0)
+        return INVALID_PAGE;
+      routeKey = node->getKey(0);
+    }
+
+    uint32_t pageId = pm.getMetadata()->rootPageId;
+    for (uint32_t depth = 0; depth < MAX_TREE_DEPTH; depth++) {
+      const void *page = pm.getPage(pageId);
+      if (*static_cast<const PageType *>(page) != PageType::INTERNAL)
+        return INVALID_PAGE;
+      const InternalNode *node = static_cast<const InternalNode *>(page);
+      uint32_t next = node->getChild(Search::childIndex(node, routeKey));
+      if (next == childId)
+        return pageId;
+      pageId = next;
+    }
+    return INVALID_PAGE;
+  }
+
+  // Find parent of a node (exhaustive fallback)
   uint32_t findParent(uint32_t currentId, uint32_t childId) {
     void *page = pm.getPage(currentId);
     PageType type = *static_cast<PageType *>(page);
@@ -340,66 +2157,50 @@ private:
     return INVALID_PAGE;
   }
 
-  // Split internal node
+  // Split internal node - allocation-free. With n keys plus the new one,
+  // virtual key sp = (n + 1) / 2 moves up. Depending on where the new key
+  // falls relative to sp, the upper run is moved with one memcpy and the
+  // new (key, child) pair is inserted into the half that owns it.
   bool splitInternal(uint32_t nodeId, int32_t newKey, uint32_t newChild) {
-    MetadataPage *meta = pm.getMetadata();
-    InternalNode *node = pm.getInternalNode(nodeId);
-
-    // Create temporary arrays
-    const uint32_t totalKeys = node->numKeys + 1;
-    std::vector<int32_t> tempKeys(totalKeys);
-    std::vector<uint32_t> tempChildren(totalKeys + 1);
-
-    // Find position for new key
-    uint32_t pos = 0;
-    while (pos < node->numKeys && node->getKey(pos) < newKey)
-      pos++;
-
-    // Copy with insertion
-    for (uint32_t i = 0, j = 0; i < totalKeys; i++) {
-      if (i == pos) {
-        tempKeys[i] = newKey;
-        tempChildren[i] = node->getChild(j);
-        tempChildren[i + 1] = newChild;
-      } else {
-        tempKeys[i] = node->getKey(j);
-        tempChildren[i] = node->getChild(j);
-        if (i == totalKeys - 1)
-          tempChildren[i + 1] = node->getChild(j + 1);
-        j++;
-      }
-    }
-
-    // Create new internal node
+    // Allocate first: growing the file may move the mapping
     uint32_t newNodeId = pm.allocatePage();
     if (newNodeId == INVALID_PAGE)
       return false;
 
+    InternalNode *node = pm.getInternalNode(nodeId);
     InternalNode *newNode = pm.getInternalNode(newNodeId);
     newNode->init();
 
-    // Split point - middle key goes up
-    uint32_t splitPoint = totalKeys / 2;
-    int32_t separatorKey = tempKeys[splitPoint];
-
-    // Left node keeps first half
-    node->numKeys = splitPoint;
-    for (uint32_t i = 0; i < splitPoint; i++) {
-      node->setKey(i, tempKeys[i]);
-      node->setChild(i, tempChildren[i]);
+    const uint32_t pos = node->findInsertPosition(newKey);
+    // Keys kept by the left node; the right one keeps at least one key
+    const uint32_t splitPoint = chooseSplitPoint(
+        node->numKeys + 1, pos == node->numKeys, pos == 0, 2);
+    int32_t separatorKey;
+
+    if (pos < splitPoint) {
+      // key[sp-1] goes up, new pair joins the left half
+      separatorKey = node->getKey(splitPoint - 1);
+      node->moveTailTo(newNode, splitPoint);
+      node->numKeys = splitPoint - 1;
+      node->insertAt(pos, newKey, newChild);
+    } else if (pos == splitPoint) {
+      // The new key itself goes up; its child heads the right half
+      separatorKey = newKey;
+      node->moveTailTo(newNode, splitPoint);
+      newNode->setChild(0, newChild);
+    } else {
+      // key[sp] goes up, new pair joins the right half
+      separatorKey = node->getKey(splitPoint);
+      node->moveTailTo(newNode, splitPoint + 1);
+      node->numKeys = splitPoint;
+      newNode->insertAt(pos - splitPoint - 1, newKey, newChild);
     }
-    node->setChild(splitPoint, tempChildren[splitPoint]);
-
-    // Right node gets second half
-    newNode->numKeys = totalKeys - splitPoint - 1;
-    for (uint32_t i = 0; i < newNode->numKeys; i++) {
-      newNode->setKey(i, tempKeys[splitPoint + 1 + i]);
-      newNode->setChild(i, tempChildren[splitPoint + 1 + i]);
-    }
-    newNode->setChild(newNode->numKeys, tempChildren[totalKeys]);
+    node->splitFencesWith(newNode, separatorKey);
 
     return insertIntoParent(nodeId, separatorKey, newNodeId);
   }
 };
 
+using BPlusTree = BasicBPlusTree<>;
+
 #endif // BPTREE_HPP
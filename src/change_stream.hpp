@@ -0,0 +1,369 @@
+#ifndef CHANGE_STREAM_HPP
+#define CHANGE_STREAM_HPP
+
+#include "page.hpp"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =============================================================================
+// CHANGE STREAM (change data capture)
+// =============================================================================
+//
+// Every committed put or delete is appended to a fixed-size ring with a
+// sequence number (1, 2, 3, ... across reopens of the same file). The ring
+// either lives in the process (openPrivate) or in a MAP_SHARED sidecar,
+// <index>.changes, that consumer processes attach to read-only.
+//
+// There is one producer, the tree's writer, and no back-pressure: it never
+// waits for consumers. Each slot carries its own sequence number, written
+// last, so a consumer that copies a slot and finds the number unchanged
+// knows the copy is intact. A consumer that falls more than `capacity`
+// records behind is told so (lagged()) and has to resynchronise from the
+// index itself before following the stream again.
+//
+// Puts carry their expiry (0 = never), so a follower of a tree with TTL
+// leaves expires records at the same time as the primary; the header flag
+// CHANGE_FLAG_TTL tells it to create TTL leaves.
+
+constexpr uint32_t CHANGE_MAGIC = 0xC4A6E5E1;
+constexpr uint32_t CHANGE_FLAG_TTL = 0x1; // Producer uses TTL leaves
+constexpr uint32_t CHANGE_DEFAULT_CAPACITY = 1u << 16; // Records (8 MB)
+
+enum class ChangeOp : uint8_t { PUT = 1, DELETE = 2 };
+
+// One record as handed to consumers
+struct ChangeEvent {
+  uint64_t seq;
+  int32_t key;
+  ChangeOp op;
+  uint32_t expiresAt;       // PUT only; 0 = never
+  uint8_t value[DATA_SIZE]; // Unspecified for DELETE
+};
+
+struct alignas(CACHE_LINE_SIZE) ChangeSlot {
+  std::atomic<uint64_t> seq; // 0 while being (re)written
+  int32_t key;
+  ChangeOp op;
+  uint32_t expiresAt;
+  uint8_t value[DATA_SIZE];
+};
+
+struct alignas(CACHE_LINE_SIZE) ChangeRingHeader {
+  uint32_t magic;
+  uint32_t capacity;
+  uint32_t flags; // CHANGE_FLAG_*
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> next; // Next sequence
+};
+
+static_assert(sizeof(ChangeSlot) == 2 * CACHE_LINE_SIZE,
+              "a change slot should span exactly two cache lines");
+static_assert(sizeof(ChangeRingHeader) <= PAGE_SIZE,
+              "the ring header must fit its page");
+
+class ChangeStream {
+  ChangeRingHeader *header = nullptr;
+  ChangeSlot *slots = nullptr;
+  uint64_t mask = 0;
+  size_t mappedSize = 0;
+  bool producer = false;
+  bool shared = false;
+#ifndef _WIN32
+  int fd = -1;
+#endif
+
+public:
+  ChangeStream() = default;
+  ~ChangeStream() { close(); }
+
+  ChangeStream(const ChangeStream &) = delete;
+  ChangeStream &operator=(const ChangeStream &) = delete;
+
+  FORCE_INLINE bool isActive() const { return header != nullptr; }
+  bool isProducer() const { return producer; }
+  uint32_t capacity() const { return header ? header->capacity : 0; }
+  uint32_t flags() const { return header ? header->flags : 0; }
+
+  // Producer only: describe the records, e.g. CHANGE_FLAG_TTL
+  void setFlags(uint32_t f) {
+    if (header && producer)
+      header->flags = f;
+  }
+
+  // Producer ring visible to this process only. Capacity is rounded up to
+  // a power of two.
+  bool openPrivate(uint32_t records = CHANGE_DEFAULT_CAPACITY) {
+    if (header)
+      return false;
+    const uint32_t cap = roundCapacity(records);
+    uint8_t *mem = static_cast<uint8_t *>(
+        ::operator new(bytesFor(cap), std::align_val_t(PAGE_SIZE),
+                       std::nothrow));
+    if (!mem)
+      return false;
+    std::memset(mem, 0, bytesFor(cap));
+    attachMemory(mem, cap);
+    header->magic = CHANGE_MAGIC;
+    header->capacity = cap;
+    header->next.store(1, std::memory_order_release);
+    producer = true;
+    return true;
+  }
+
+  // Producer ring in a shared file. An existing ring of the same capacity
+  // is continued, so sequence numbers keep increasing across restarts.
+  bool openShared(const std::string &path,
+                  uint32_t records = CHANGE_DEFAULT_CAPACITY) {
+#ifdef _WIN32
+    (void)path;
+    (void)records;
+    return false;
+#else
+    if (header)
+      return false;
+    const uint32_t cap = roundCapacity(records);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      closeFd();
+      return false;
+    }
+    // A ring of a different size starts over
+    const bool fresh = static_cast<size_t>(st.st_size) != bytesFor(cap);
+    if ((fresh && ftruncate(fd, 0) != 0) ||
+        ftruncate(fd, static_cast<off_t>(bytesFor(cap))) != 0 ||
+        !mapFile(bytesFor(cap), PROT_READ | PROT_WRITE)) {
+      closeFd();
+      return false;
+    }
+    if (header->magic != CHANGE_MAGIC || header->capacity != cap) {
+      header->magic = CHANGE_MAGIC;
+      header->capacity = cap;
+      header->next.store(1, std::memory_order_release);
+    }
+    mask = cap - 1;
+    producer = true;
+    return true;
+#endif
+  }
+
+  // Consumer view of a ring written by another process
+  bool attach(const std::string &path) {
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    if (header)
+      return false;
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < PAGE_SIZE ||
+        !mapFile(static_cast<size_t>(st.st_size), PROT_READ) ||
+        header->magic != CHANGE_MAGIC ||
+        bytesFor(header->capacity) != mappedSize) {
+      closeFd();
+      return false;
+    }
+    return true;
+#endif
+  }
+
+  void close() {
+    if (!header)
+      return;
+    if (shared) {
+#ifndef _WIN32
+      closeFd();
+#endif
+    } else {
+      ::operator delete(static_cast<void *>(header),
+                        std::align_val_t(PAGE_SIZE));
+    }
+    header = nullptr;
+    slots = nullptr;
+    mask = 0;
+    mappedSize = 0;
+    producer = false;
+    shared = false;
+  }
+
+  // Sequence the next record will get; everything below it is published
+  uint64_t nextSeq() const {
+    return header ? header->next.load(std::memory_order_acquire) : 1;
+  }
+
+  // Oldest sequence still held by the ring
+  uint64_t oldestSeq() const {
+    const uint64_t next = nextSeq();
+    return next > capacity() ? next - capacity() : 1;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Producer side (single thread, which the tree guarantees)
+  // ---------------------------------------------------------------------------
+
+  FORCE_INLINE void publish(ChangeOp op, int32_t key, const uint8_t *value,
+                            uint32_t expiresAt = 0) {
+    const uint64_t s = header->next.load(std::memory_order_relaxed);
+    ChangeSlot &slot = slots[s & mask];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.key = key;
+    slot.op = op;
+    slot.expiresAt = expiresAt;
+    if (value)
+      std::memcpy(slot.value, value, DATA_SIZE);
+    slot.seq.store(s, std::memory_order_release);
+    header->next.store(s + 1, std::memory_order_release);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Consumer side: copy record `seq` out. False if it was overwritten (or
+  // is being overwritten) by a later record.
+  // ---------------------------------------------------------------------------
+
+  bool read(uint64_t seq, ChangeEvent &out) const {
+    const ChangeSlot &slot = slots[seq & mask];
+    if (slot.seq.load(std::memory_order_acquire) != seq)
+      return false;
+    out.seq = seq;
+    out.key = slot.key;
+    out.op = slot.op;
+    out.expiresAt = slot.expiresAt;
+    std::memcpy(out.value, slot.value, DATA_SIZE);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+private:
+  static uint32_t roundCapacity(uint32_t records) {
+    uint32_t cap = 2;
+    while (cap < records && cap < (1u << 30))
+      cap <<= 1;
+    return cap;
+  }
+
+  static size_t bytesFor(uint32_t cap) {
+    return PAGE_SIZE + size_t(cap) * sizeof(ChangeSlot);
+  }
+
+  void attachMemory(uint8_t *mem, uint32_t cap) {
+    header = reinterpret_cast<ChangeRingHeader *>(mem);
+    slots = reinterpret_cast<ChangeSlot *>(mem + PAGE_SIZE);
+    mask = cap - 1;
+    mappedSize = bytesFor(cap);
+  }
+
+#ifndef _WIN32
+  bool mapFile(size_t size, int prot) {
+    void *p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return false;
+    header = static_cast<ChangeRingHeader *>(p);
+    slots = reinterpret_cast<ChangeSlot *>(static_cast<uint8_t *>(p) +
+                                           PAGE_SIZE);
+    mappedSize = size;
+    mask = header->capacity ? header->capacity - 1 : 0;
+    shared = true;
+    return true;
+  }
+
+  void closeFd() {
+    if (header && shared)
+      munmap(static_cast<void *>(header), mappedSize);
+    header = nullptr;
+    slots = nullptr;
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+#endif
+};
+
+// Follows a ChangeStream from a starting sequence, handing out records in
+// batches. Cheap to create; any number can follow the same stream.
+class ChangeCursor {
+  const ChangeStream &stream;
+  uint64_t cursor;
+  bool behind = false;
+
+public:
+  // Starts at `from`, or at the current end of the stream when 0
+  explicit ChangeCursor(const ChangeStream &s, uint64_t from = 0)
+      : stream(s), cursor(from ? from : s.nextSeq()) {}
+
+  // Sequence of the next record this cursor will return
+  uint64_t position() const { return cursor; }
+
+  // True once records were overwritten before this cursor read them. The
+  // consumer must resynchronise, then seek() to a sequence it is sure of.
+  bool lagged() const { return behind; }
+
+  void seek(uint64_t seq) {
+    cursor = seq;
+    behind = false;
+  }
+
+  // Records published but not yet consumed
+  uint64_t pending() const {
+    const uint64_t next = stream.nextSeq();
+    return next > cursor ? next - cursor : 0;
+  }
+
+  // Copy up to max records into out. Returns the number copied; 0 if the
+  // cursor is caught up or lagged.
+  size_t poll(ChangeEvent *out, size_t max) {
+    if (behind || !stream.isActive())
+      return 0;
+    const uint64_t next = stream.nextSeq();
+    if (next > cursor && next - cursor > stream.capacity()) {
+      behind = true;
+      return 0;
+    }
+
+    size_t n = 0;
+    while (n < max && cursor < next) {
+      if (!stream.read(cursor, out[n])) {
+        behind = true;
+        break;
+      }
+      cursor++;
+      n++;
+    }
+    return n;
+  }
+
+  // poll(), waiting up to timeoutMs for the first record to arrive
+  size_t pollWait(ChangeEvent *out, size_t max, uint32_t timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeoutMs);
+    uint32_t spins = 0;
+    while (true) {
+      size_t n = poll(out, max);
+      if (n || behind || std::chrono::steady_clock::now() >= deadline)
+        return n;
+      if (++spins < 64)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+};
+
+#endif // CHANGE_STREAM_HPP
@@ -4,13 +4,32 @@
  */
 
 #include "bptree.hpp"
+#include "external_sort.hpp"
+#include "replica.hpp"
+#include "ttl_sweeper.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <random>
 #include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include "server.hpp"
+#include "sharded_server.hpp"
+#endif
 
 // Logging
 class Logger {
@@ -168,6 +187,883 @@ bool testBulkInsert(BPlusTree &tree, Logger &log, int count) {
   return true;
 }
 
+// Shuffled keys exercise splits where the new entry lands in either half
+bool testRandomInsert(Logger &log, int count) {
+  log.log("--- Testing Random-Order Insert (" + std::to_string(count) +
+          " records) ---");
+
+  const std::string file = "random.idx";
+  std::remove(file.c_str());
+  BPlusTree tree;
+  tree.open(file);
+
+  std::vector<int32_t> keys(count);
+  for (int i = 0; i < count; i++)
+    keys[i] = i * 3;
+  std::mt19937 gen(42);
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  bool ok = true;
+  uint8_t data[DATA_SIZE];
+  for (int32_t k : keys) {
+    fillData(data, k);
+    if (!tree.writeData(k, data)) {
+      log.log("FAIL: Insert failed at key " + std::to_string(k));
+      ok = false;
+      break;
+    }
+  }
+
+  for (int i = 0; i < count && ok; i++) {
+    const uint8_t *result = tree.readData(i * 3);
+    if (!result || !verifyData(result, i * 3) || tree.readData(i * 3 + 1)) {
+      log.log("FAIL: Lookup mismatch around key " + std::to_string(i * 3));
+      ok = false;
+    }
+  }
+
+  uint32_t n = 0;
+  auto results = tree.readRangeData(0, count * 3, n);
+  for (uint32_t i = 0; i < n && ok; i++) {
+    if (!verifyData(results[i], static_cast<int32_t>(i * 3))) {
+      log.log("FAIL: Range scan out of order at " + std::to_string(i));
+      ok = false;
+    }
+  }
+  if (ok && (n != static_cast<uint32_t>(count) ||
+             tree.getRecordCount() != static_cast<uint32_t>(count))) {
+    log.log("FAIL: Expected " + std::to_string(count) + " records, scan saw " +
+            std::to_string(n));
+    ok = false;
+  }
+
+  tree.close();
+  std::remove(file.c_str());
+  if (ok)
+    log.log("PASS: Shuffled inserts read back in order");
+  return ok;
+}
+
+bool testSplitPolicies(Logger &log) {
+  log.log("--- Testing Split Policies & Bulk Load ---");
+
+  const std::string file = "policy.idx";
+  const int count = 20000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+
+  auto fillTree = [&](SplitPolicy policy, uint32_t pct, bool shuffled,
+                      uint32_t &pages) {
+    std::remove(file.c_str());
+    BPlusTree tree;
+    tree.open(file);
+    tree.setSplitPolicy(policy, pct);
+
+    std::vector<int32_t> keys(count);
+    for (int i = 0; i < count; i++)
+      keys[i] = i;
+    if (shuffled) {
+      std::mt19937 gen(5);
+      std::shuffle(keys.begin(), keys.end(), gen);
+    }
+    for (int32_t k : keys) {
+      fillData(data, k);
+      tree.writeData(k, data);
+    }
+    bool good = tree.getRecordCount() == static_cast<uint32_t>(count);
+    for (int i = 0; i < count && good; i++) {
+      const uint8_t *result = tree.readData(i);
+      good = result && verifyData(result, i);
+    }
+    pages = tree.getPageCount();
+    tree.close();
+    return good;
+  };
+
+  uint32_t midPages = 0, appendPages = 0, descPages = 0, pages = 0;
+  ok &= fillTree(SplitPolicy::MIDPOINT, 50, false, midPages);
+  ok &= fillTree(SplitPolicy::APPEND_AWARE, 50, false, appendPages);
+  ok &= fillTree(SplitPolicy::FILL_FACTOR, 70, true, pages);
+  ok &= fillTree(SplitPolicy::ADAPTIVE, 70, true, pages);
+  ok &= fillTree(SplitPolicy::ADAPTIVE, 70, false, pages);
+  if (!ok)
+    log.log("FAIL: Data lost under a split policy");
+
+  if (ok && appendPages * 10 > midPages * 6) {
+    log.log("FAIL: Append-aware split used " + std::to_string(appendPages) +
+            " pages vs " + std::to_string(midPages) + " for midpoint");
+    ok = false;
+  }
+
+  // Descending keys under APPEND_AWARE keep the right-hand leaves full
+  {
+    std::remove(file.c_str());
+    BPlusTree tree;
+    tree.open(file);
+    tree.setSplitPolicy(SplitPolicy::APPEND_AWARE);
+    for (int i = count - 1; i >= 0; i--) {
+      fillData(data, i);
+      tree.writeData(i, data);
+    }
+    uint32_t n = 0;
+    tree.readRangeData(0, count, n);
+    descPages = tree.getPageCount();
+    if (n != static_cast<uint32_t>(count) || descPages * 10 > midPages * 6) {
+      log.log("FAIL: Descending append-aware inserts");
+      ok = false;
+    }
+    tree.close();
+  }
+
+  // Bulk load: sorted input, fill factor, preconditions
+  {
+    std::remove(file.c_str());
+    std::vector<int32_t> keys(count);
+    std::vector<uint8_t> values(static_cast<size_t>(count) * DATA_SIZE);
+    for (int i = 0; i < count; i++) {
+      keys[i] = i * 2;
+      fillData(&values[static_cast<size_t>(i) * DATA_SIZE], i * 2);
+    }
+
+    BPlusTree tree;
+    tree.open(file);
+    std::swap(keys[10], keys[11]);
+    if (tree.bulkLoad(keys.data(), values.data(), count)) {
+      log.log("FAIL: Bulk load accepted unsorted input");
+      ok = false;
+    }
+    std::swap(keys[10], keys[11]);
+    tree.close();
+    std::remove(file.c_str());
+    tree.open(file);
+
+    if (!tree.bulkLoad(keys.data(), values.data(), count, 100)) {
+      log.log("FAIL: Bulk load of sorted input");
+      ok = false;
+    }
+    for (int i = 0; i < count && ok; i++) {
+      const uint8_t *result = tree.readData(i * 2);
+      if (!result || !verifyData(result, i * 2)) {
+        log.log("FAIL: Bulk-loaded key " + std::to_string(i * 2));
+        ok = false;
+      }
+    }
+    uint32_t n = 0;
+    tree.readRangeData(0, count * 2, n);
+    if (ok && (n != static_cast<uint32_t>(count) ||
+               tree.getPageCount() > static_cast<uint32_t>(
+                                         count / LEAF_MAX_KEYS + 6))) {
+      log.log("FAIL: Bulk load produced " + std::to_string(n) +
+              " records in " + std::to_string(tree.getPageCount()) + " pages");
+      ok = false;
+    }
+    // Inserting into a packed tree splits normally
+    for (int i = 0; i < count && ok; i += 7) {
+      fillData(data, i * 2 + 1);
+      ok = tree.writeData(i * 2 + 1, data);
+    }
+    if (ok && tree.bulkLoad(keys.data(), values.data(), count)) {
+      log.log("FAIL: Bulk load into a non-empty tree");
+      ok = false;
+    }
+    tree.close();
+  }
+
+  std::remove(file.c_str());
+  if (ok)
+    log.log("PASS: Sequential fill: midpoint " + std::to_string(midPages) +
+            " pages, append-aware " + std::to_string(appendPages) +
+            " (descending " + std::to_string(descPages) + ")");
+  return ok;
+}
+
+bool testLazyDelete(Logger &log) {
+  log.log("--- Testing Lazy Deletion ---");
+
+  const std::string file = "lazy.idx";
+  const int count = 20000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+  std::remove(file.c_str());
+
+  BPlusTree tree;
+  tree.open(file);
+  tree.setLazyDelete(true, LEAF_MAX_KEYS); // Compact only when forced
+  for (int i = 0; i < count; i++) {
+    fillData(data, i);
+    tree.writeData(i, data);
+  }
+  uint32_t pagesBefore = tree.getPageCount();
+
+  for (int i = 0; i < count; i += 2)
+    ok &= tree.deleteData(i);
+  if (!ok || tree.deleteData(0) ||
+      tree.getRecordCount() != static_cast<uint32_t>(count / 2)) {
+    log.log("FAIL: Lazy delete bookkeeping");
+    ok = false;
+  }
+
+  // Tombstones are invisible to point reads and range scans
+  for (int i = 0; i < count && ok; i++) {
+    const uint8_t *result = tree.readData(i);
+    if ((i % 2 == 0) != (result == nullptr) ||
+        (result && !verifyData(result, i))) {
+      log.log("FAIL: Lazy-deleted key " + std::to_string(i));
+      ok = false;
+    }
+  }
+  uint32_t n = 0;
+  std::vector<uint8_t *> range = tree.readRangeData(0, count, n);
+  if (ok && n != static_cast<uint32_t>(count / 2)) {
+    log.log("FAIL: Range scan returned " + std::to_string(n) +
+            " records with tombstones present");
+    ok = false;
+  }
+  for (uint32_t i = 0; i < n && ok; i++) {
+    if (!verifyData(range[i], static_cast<int32_t>(i * 2 + 1))) {
+      log.log("FAIL: Range scan content after lazy delete");
+      ok = false;
+    }
+  }
+
+  // Tombstones survive a reopen
+  tree.close();
+  tree.open(file);
+  tree.setLazyDelete(true, LEAF_MAX_KEYS);
+  if (ok && (tree.readData(10) || tree.getRecordCount() !=
+                                      static_cast<uint32_t>(count / 2))) {
+    log.log("FAIL: Tombstones lost across reopen");
+    ok = false;
+  }
+
+  // Rewriting a dead key revives its slot; new keys reuse dead slots
+  // instead of splitting
+  for (int i = 0; i < count && ok; i += 4) {
+    fillData(data, i);
+    ok = tree.writeData(i, data);
+  }
+  for (int i = 0; i < count && ok; i += 4) {
+    fillData(data, i + count);
+    ok = tree.writeData(i + count, data);
+  }
+  for (int i = 0; i < count && ok; i += 4) {
+    const uint8_t *result = tree.readData(i);
+    if (!result || !verifyData(result, i)) {
+      log.log("FAIL: Revived key " + std::to_string(i));
+      ok = false;
+    }
+  }
+  if (ok && tree.getRecordCount() != static_cast<uint32_t>(count)) {
+    log.log("FAIL: Record count after revive");
+    ok = false;
+  }
+
+  uint32_t reclaimed = tree.purgeTombstones();
+  tree.readRangeData(0, count * 2, n);
+  if (ok && (reclaimed == 0 || reclaimed > static_cast<uint32_t>(count / 4) ||
+             n != static_cast<uint32_t>(count) || tree.purgeTombstones())) {
+    log.log("FAIL: Purge reclaimed " + std::to_string(reclaimed) + " slots");
+    ok = false;
+  }
+  uint32_t pagesAfter = tree.getPageCount();
+  tree.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Lazy delete, revive, purge (" +
+            std::to_string(pagesBefore) + " -> " +
+            std::to_string(pagesAfter) + " pages)");
+  return ok;
+}
+
+bool testUnsortedTail(Logger &log) {
+  log.log("--- Testing Unsorted-Tail Leaves ---");
+
+  const std::string file = "tail.idx";
+  const int count = 20000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+  std::remove(file.c_str());
+
+  std::vector<int32_t> keys(count);
+  for (int i = 0; i < count; i++)
+    keys[i] = i;
+  std::mt19937 gen(11);
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  BPlusTree tree;
+  tree.open(file);
+  tree.setUnsortedTail(8);
+  for (int32_t k : keys) {
+    fillData(data, k);
+    ok &= tree.writeData(k, data);
+  }
+  // Updates and deletes must find entries still sitting in a tail
+  for (int i = 0; i < count && ok; i += 3) {
+    fillData(data, i + 1);
+    ok = tree.writeData(i, data);
+  }
+  for (int i = 1; i < count && ok; i += 3)
+    ok = tree.deleteData(i);
+  if (!ok) {
+    log.log("FAIL: Writes with unsorted tails");
+    tree.close();
+    return false;
+  }
+
+  auto verify = [&](const char *when) {
+    for (int i = 0; i < count; i++) {
+      const uint8_t *result = tree.readData(i);
+      int32_t expect = i % 3 == 0 ? i + 1 : i;
+      if ((i % 3 == 1) != (result == nullptr) ||
+          (result && !verifyData(result, expect))) {
+        log.log(std::string("FAIL: Key ") + std::to_string(i) + " " + when);
+        return false;
+      }
+    }
+    // Scans merge tails on the fly and must come back in key order
+    uint32_t n = 0;
+    std::vector<uint8_t *> range = tree.readRangeData(0, count, n);
+    uint32_t expectN = count - (count + 1) / 3;
+    if (n != expectN) {
+      log.log(std::string("FAIL: Range returned ") + std::to_string(n) +
+              " records " + when);
+      return false;
+    }
+    for (uint32_t j = 1; j < n; j++) {
+      int32_t a, b;
+      std::memcpy(&a, range[j - 1], sizeof(a));
+      std::memcpy(&b, range[j], sizeof(b));
+      if (a >= b) {
+        log.log(std::string("FAIL: Range out of order ") + when);
+        return false;
+      }
+    }
+    std::vector<uint8_t> copies;
+    tree.readRangeShared(100, 199, copies, n);
+    if (n != 66) {
+      log.log(std::string("FAIL: Shared range over tails ") + when);
+      return false;
+    }
+    return true;
+  };
+
+  ok &= verify("with tails");
+  uint32_t tailPages = tree.getPageCount();
+
+  // Tails persist; a writer without the option still reads and merges them
+  tree.close();
+  tree.open(file);
+  ok = ok && verify("after reopen");
+  tree.setLazyDelete(true, 4);
+  for (int i = 1; i < count && ok; i += 3) {
+    fillData(data, i);
+    ok = tree.writeData(i, data) && tree.deleteData(i);
+  }
+  ok = ok && verify("after sorted-mode writes") &&
+       tree.getRecordCount() == static_cast<uint32_t>(count - (count + 1) / 3);
+  tree.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Random inserts through 8-slot tails (" +
+            std::to_string(tailPages) + " pages)");
+  return ok;
+}
+
+bool testSlottedValues(Logger &log) {
+  log.log("--- Testing Slotted-Value Leaves ---");
+
+  const std::string file = "slotted.idx";
+  const int count = 20000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+
+  // Random inserts, updates and deletes with and without an unsorted tail
+  for (uint32_t tail : {0u, 8u}) {
+    std::remove(file.c_str());
+    std::vector<int32_t> keys(count);
+    for (int i = 0; i < count; i++)
+      keys[i] = i;
+    std::mt19937 gen(17 + tail);
+    std::shuffle(keys.begin(), keys.end(), gen);
+
+    BPlusTree tree;
+    tree.open(file);
+    tree.setSlottedValues(true);
+    tree.setUnsortedTail(tail);
+    for (int32_t k : keys) {
+      fillData(data, k);
+      ok &= tree.writeData(k, data);
+    }
+    for (int i = 0; i < count && ok; i += 2)
+      ok = tree.deleteData(i);
+    // Reinsert half of them: freed value slots are reused
+    for (int i = 0; i < count && ok; i += 4) {
+      fillData(data, i);
+      ok = tree.writeData(i, data);
+    }
+    tree.close();
+    tree.open(file);
+
+    for (int i = 0; i < count && ok; i++) {
+      const uint8_t *result = tree.readData(i);
+      bool present = i % 2 == 1 || i % 4 == 0;
+      if (present != (result != nullptr) ||
+          (result && !verifyData(result, i))) {
+        log.log("FAIL: Slotted key " + std::to_string(i) + " (tail " +
+                std::to_string(tail) + ")");
+        ok = false;
+      }
+    }
+    uint32_t n = 0;
+    std::vector<uint8_t *> range = tree.readRangeData(0, count, n);
+    int32_t prev = -1;
+    for (uint32_t j = 0; j < n && ok; j++) {
+      int32_t k;
+      std::memcpy(&k, range[j], sizeof(k));
+      ok = k > prev && verifyData(range[j], k);
+      prev = k;
+    }
+    if (ok && n != static_cast<uint32_t>(count / 2 + count / 4)) {
+      log.log("FAIL: Slotted range returned " + std::to_string(n));
+      ok = false;
+    }
+    tree.close();
+  }
+
+  // Bulk-loaded slotted leaves fill to the reduced capacity
+  if (ok) {
+    std::remove(file.c_str());
+    std::vector<int32_t> keys(count);
+    std::vector<uint8_t> values(static_cast<size_t>(count) * DATA_SIZE);
+    for (int i = 0; i < count; i++) {
+      keys[i] = i;
+      fillData(&values[static_cast<size_t>(i) * DATA_SIZE], i);
+    }
+    BPlusTree tree;
+    tree.open(file);
+    tree.setSlottedValues(true);
+    ok = tree.bulkLoad(keys.data(), values.data(), count);
+    for (int i = 0; i < count && ok; i += 2) {
+      fillData(data, i + count);
+      ok = tree.writeData(i + count, data) && tree.readData(i) &&
+           verifyData(tree.readData(i), i);
+    }
+    uint32_t leaves = count / LEAF_SLOTTED_MAX_KEYS;
+    if (!ok || tree.getPageCount() < leaves) {
+      log.log("FAIL: Slotted bulk load");
+      ok = false;
+    }
+    tree.close();
+  }
+
+  std::remove(file.c_str());
+  if (ok)
+    log.log("PASS: Slotted leaves (" + std::to_string(LEAF_SLOTTED_MAX_KEYS) +
+            " entries) with and without tails");
+  return ok;
+}
+
+// Every node's fences must equal the range its parent's separators give it
+bool fencesMatch(PageManager &pm, uint32_t pageId, int32_t low, int32_t high) {
+  const void *page = pm.getPage(pageId);
+  if (*static_cast<const PageType *>(page) == PageType::LEAF) {
+    const LeafNode *leaf = static_cast<const LeafNode *>(page);
+    if (!leaf->hasFences() || leaf->lowFence() != low ||
+        leaf->highFence() != high)
+      return false;
+    for (uint32_t i = 0; i < leaf->numKeys; i++) {
+      if (!leaf->covers(leaf->keys()[i]))
+        return false;
+    }
+    return true;
+  }
+  const InternalNode *node = static_cast<const InternalNode *>(page);
+  if (!node->hasFences() || node->lowFence() != low ||
+      node->highFence() != high)
+    return false;
+  for (uint32_t i = 0; i <= node->numKeys; i++) {
+    int32_t childLow = i == 0 ? low : node->getKey(i - 1);
+    int32_t childHigh = i == node->numKeys ? high : node->getKey(i) - 1;
+    if (!fencesMatch(pm, node->getChild(i), childLow, childHigh))
+      return false;
+  }
+  return true;
+}
+
+bool testFenceKeys(Logger &log) {
+  log.log("--- Testing Fence Keys ---");
+
+  const std::string file = "fence.idx";
+  const int count = 100000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+
+  auto check = [&](const char *what) {
+    PageManager pm;
+    if (!pm.open(file, OpenMode::READ_ONLY) ||
+        !fencesMatch(pm, pm.getMetadata()->rootPageId, INT32_MIN,
+                     INT32_MAX)) {
+      log.log(std::string("FAIL: Fences after ") + what);
+      return false;
+    }
+    return true;
+  };
+
+  // Splits at every level, including internal ones
+  std::remove(file.c_str());
+  std::vector<int32_t> keys(count);
+  for (int i = 0; i < count; i++)
+    keys[i] = i * 3;
+  std::mt19937 gen(23);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  {
+    BPlusTree tree;
+    tree.open(file);
+    tree.setSplitPolicy(SplitPolicy::FILL_FACTOR, 10); // Deepen the tree
+    for (int32_t k : keys) {
+      fillData(data, k);
+      tree.writeData(k, data);
+    }
+    tree.close();
+  }
+  ok &= check("random inserts");
+
+  // Bulk load builds them bottom-up
+  if (ok) {
+    std::remove(file.c_str());
+    std::sort(keys.begin(), keys.end());
+    std::vector<uint8_t> values(static_cast<size_t>(count) * DATA_SIZE);
+    for (int i = 0; i < count; i++)
+      fillData(&values[static_cast<size_t>(i) * DATA_SIZE], keys[i]);
+    BPlusTree tree;
+    tree.open(file);
+    ok = tree.bulkLoad(keys.data(), values.data(), count, 60);
+    tree.close();
+    ok = ok && check("bulk load");
+  }
+
+  // Scans that end inside a leaf's fence range stop there; results are
+  // unchanged, including ranges that fall in the gaps between keys
+  if (ok) {
+    BPlusTree tree;
+    tree.open(file);
+    for (int lo = 0; lo < count * 3 && ok; lo += 997) {
+      uint32_t n = 0;
+      tree.readRangeData(lo, lo + 200, n);
+      uint32_t expect = static_cast<uint32_t>((lo + 200) / 3 - (lo + 2) / 3 + 1);
+      std::vector<uint8_t> out;
+      uint32_t shared = 0;
+      tree.readRangeShared(lo, lo + 200, out, shared);
+      if (n != expect || shared != expect) {
+        log.log("FAIL: Range [" + std::to_string(lo) + ", " +
+                std::to_string(lo + 200) + "] returned " + std::to_string(n));
+        ok = false;
+      }
+    }
+    tree.close();
+  }
+
+  std::remove(file.c_str());
+  if (ok)
+    log.log("PASS: Fence keys match separators after splits and bulk load");
+  return ok;
+}
+
+bool testSeparators(Logger &log) {
+  log.log("--- Testing Shortest Separators ---");
+
+  bool ok = true;
+  auto trailingZeros = [](int32_t v) {
+    uint32_t u = static_cast<uint32_t>(v) ^ 0x80000000u;
+    int n = 0;
+    while (n < 32 && !((u >> n) & 1))
+      n++;
+    return n;
+  };
+
+  // In (left, right], and neither neighbouring multiple of the next power
+  // of two (a "rounder" candidate) is in range
+  std::mt19937 gen(29);
+  std::uniform_int_distribution<int32_t> any(INT32_MIN, INT32_MAX);
+  for (int i = 0; i < 100000 && ok; i++) {
+    int32_t a = any(gen), b = any(gen);
+    if (i % 2 == 0 && a < INT32_MAX - 64)
+      b = a + 1 + static_cast<int32_t>(gen() % 64); // Close pairs too
+    if (a == b)
+      continue;
+    int32_t left = std::min(a, b), right = std::max(a, b);
+    int32_t sep = shortestSeparator(left, right);
+    int64_t l = static_cast<int64_t>(left) - INT32_MIN;
+    int64_t r = static_cast<int64_t>(right) - INT32_MIN;
+    int64_t u = static_cast<int64_t>(sep) - INT32_MIN;
+    int64_t step = u == 0 ? (int64_t(1) << 32) : (u & -u) * 2;
+    int64_t below = u - (u & -u);
+    if (sep <= left || sep > right ||
+        (u != 0 && (below > l || below + step <= r))) {
+      log.log("FAIL: Separator " + std::to_string(sep) + " for (" +
+              std::to_string(left) + ", " + std::to_string(right) + "]");
+      ok = false;
+    }
+  }
+  ok &= shortestSeparator(-1, 0) == 0 &&
+        shortestSeparator(INT32_MIN, INT32_MIN + 1) == INT32_MIN + 1 &&
+        shortestSeparator(1000, 1999) == 1024;
+
+  // Byte-string form: shortest prefix of right sorting after left
+  const uint8_t a[] = {'a', 'p', 'p', 'l', 'e'};
+  const uint8_t b[] = {'a', 'p', 'r', 'i', 'c', 'o', 't'};
+  const uint8_t c[] = {'a', 'p'};
+  ok &= shortestSeparatorLength(a, 5, b, 7) == 3 &&
+        shortestSeparatorLength(c, 2, a, 5) == 3 &&
+        shortestSeparatorLength(a, 5, a, 5) == 5;
+  if (!ok) {
+    log.log("FAIL: Separator helper");
+    return false;
+  }
+
+  // Sparse keys: tree separators are rounder than the keys themselves
+  const std::string file = "separator.idx";
+  std::remove(file.c_str());
+  const int count = 50000;
+  std::vector<int32_t> keys(count);
+  for (int i = 0; i < count; i++)
+    keys[i] = i * 1001 + 7;
+  std::shuffle(keys.begin(), keys.end(), gen);
+  uint8_t data[DATA_SIZE];
+  {
+    BPlusTree tree;
+    tree.open(file);
+    for (int32_t k : keys) {
+      fillData(data, k);
+      tree.writeData(k, data);
+    }
+    for (int32_t k : keys) {
+      const uint8_t *result = tree.readData(k);
+      if (!result || !verifyData(result, k) || tree.readData(k + 1)) {
+        log.log("FAIL: Lookup " + std::to_string(k) + " with truncated "
+                                                       "separators");
+        ok = false;
+        break;
+      }
+    }
+    tree.close();
+  }
+  PageManager pm;
+  pm.open(file, OpenMode::READ_ONLY);
+  const InternalNode *root = pm.getInternalNode(pm.getMetadata()->rootPageId);
+  uint32_t rounder = 0;
+  for (uint32_t i = 0; i < root->numKeys; i++)
+    rounder += trailingZeros(root->getKey(i)) >= 6;
+  if (ok && (!fencesMatch(pm, pm.getMetadata()->rootPageId, INT32_MIN,
+                          INT32_MAX) ||
+             rounder * 2 < root->numKeys)) {
+    log.log("FAIL: Root separators not truncated (" + std::to_string(rounder) +
+            " of " + std::to_string(root->numKeys) + ")");
+    ok = false;
+  }
+  const uint32_t rootKeys = root->numKeys;
+  pm.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Shortest separators (" + std::to_string(rounder) + "/" +
+            std::to_string(rootKeys) + " root keys with >= 6 zero bits)");
+  return ok;
+}
+
+bool testReadBatch(Logger &log) {
+  log.log("--- Testing Batched Lookups ---");
+
+  const std::string file = "batch.idx";
+  const int count = 50000;
+  uint8_t data[DATA_SIZE];
+  bool ok = true;
+  std::remove(file.c_str());
+
+  BPlusTree tree;
+  tree.open(file);
+  std::vector<int32_t> probe(1003); // Not a multiple of the group size
+  std::vector<const uint8_t *> out(probe.size());
+  if (tree.readBatch(probe.data(), probe.size(), out.data()) != 0 ||
+      out[0] != nullptr) {
+    log.log("FAIL: Batch lookup on an empty tree");
+    ok = false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    fillData(data, i * 2);
+    tree.writeData(i * 2, data);
+  }
+  tree.setLazyDelete(true);
+  for (int i = 0; i < count; i += 10)
+    tree.deleteData(i * 2);
+
+  std::mt19937 gen(31);
+  std::uniform_int_distribution<int32_t> dist(-10, count * 2 + 10);
+  for (int round = 0; round < 20 && ok; round++) {
+    for (int32_t &k : probe)
+      k = dist(gen);
+    size_t found = tree.readBatch(probe.data(), probe.size(), out.data());
+    size_t expect = 0;
+    for (size_t i = 0; i < probe.size() && ok; i++) {
+      const uint8_t *single = tree.readData(probe[i]);
+      expect += single != nullptr;
+      if (out[i] != single) {
+        log.log("FAIL: Batch lookup of " + std::to_string(probe[i]));
+        ok = false;
+      }
+    }
+    if (ok && found != expect) {
+      log.log("FAIL: Batch found " + std::to_string(found) + ", expected " +
+              std::to_string(expect));
+      ok = false;
+    }
+  }
+  tree.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Batched lookups match single lookups");
+  return ok;
+}
+
+// Random writes, deletes and reads on one policy combination, checked
+// against std::map
+template <typename Tree> bool checkVariant(const char *name, Logger &log) {
+  const std::string file = "policy.idx";
+  std::remove(file.c_str());
+  Tree tree;
+  tree.open(file);
+
+  std::map<int32_t, int32_t> model;
+  std::mt19937 gen(41);
+  std::uniform_int_distribution<int32_t> dist(0, 60000);
+  uint8_t data[DATA_SIZE];
+  for (int i = 0; i < 80000; i++) {
+    int32_t k = dist(gen);
+    if (i % 4 == 3) {
+      tree.deleteData(k);
+      model.erase(k);
+    } else {
+      fillData(data, k + i);
+      tree.writeData(k, data);
+      model[k] = k + i;
+    }
+  }
+
+  bool ok = tree.getRecordCount() == model.size();
+  for (int32_t k = 0; k <= 60000 && ok; k += 7) {
+    auto it = model.find(k);
+    const uint8_t *v = tree.readData(k);
+    ok = it == model.end() ? v == nullptr : v && verifyData(v, it->second);
+  }
+  uint32_t n = 0;
+  std::vector<uint8_t *> range = tree.readRangeData(1000, 30000, n);
+  auto lo = model.lower_bound(1000), hi = model.upper_bound(30000);
+  ok = ok && n == static_cast<uint32_t>(std::distance(lo, hi));
+  for (uint32_t i = 0; ok && i < n; i++, ++lo)
+    ok = verifyData(range[i], lo->second);
+
+  tree.close();
+  std::remove(file.c_str());
+  if (!ok)
+    log.log(std::string("FAIL: Policy variant ") + name);
+  return ok;
+}
+
+// Pages used by 20000 ascending inserts
+template <typename Tree> uint32_t sequentialPages(Tree &tree) {
+  std::remove("policy.idx");
+  tree.open("policy.idx");
+  uint8_t data[DATA_SIZE];
+  for (int i = 0; i < 20000; i++) {
+    fillData(data, i);
+    tree.writeData(i, data);
+  }
+  uint32_t pages = tree.getPageCount();
+  tree.close();
+  std::remove("policy.idx");
+  return pages;
+}
+
+bool testPolicyVariants(Logger &log) {
+  log.log("--- Testing Policy Variants ---");
+
+  bool ok = checkVariant<BPlusTree>("default", log);
+  ok &= checkVariant<BasicBPlusTree<SimdSearch>>("SimdSearch", log);
+  ok &= checkVariant<BasicBPlusTree<ScalarSearch>>("ScalarSearch", log);
+  ok &= checkVariant<BasicBPlusTree<DefaultSearch, HugePageStorage>>(
+      "HugePageStorage", log);
+  ok &= checkVariant<BasicBPlusTree<DefaultSearch, MlockStorage>>(
+      "MlockStorage", log);
+  ok &= checkVariant<BasicBPlusTree<SimdSearch, MmapStorage, SharedMutexLocking,
+                                    FixedSplit<SplitPolicy::ADAPTIVE, 70>>>(
+      "SimdSearch+SharedMutexLocking+FixedSplit", log);
+
+  // A fixed strategy ignores the runtime setter and packs sequential input
+  BasicBPlusTree<DefaultSearch, MmapStorage, NoLocking,
+                 FixedSplit<SplitPolicy::APPEND_AWARE>>
+      fixed;
+  fixed.setSplitPolicy(SplitPolicy::MIDPOINT);
+  if (fixed.getSplitPolicy() != SplitPolicy::APPEND_AWARE) {
+    log.log("FAIL: FixedSplit was overridden at runtime");
+    ok = false;
+  }
+  uint32_t fixedPages = sequentialPages(fixed);
+  BPlusTree plain;
+  uint32_t plainPages = sequentialPages(plain);
+  if (fixedPages >= plainPages) {
+    log.log("FAIL: FixedSplit<APPEND_AWARE> used " +
+            std::to_string(fixedPages) + " pages, midpoint " +
+            std::to_string(plainPages));
+    ok = false;
+  }
+
+  // SharedMutexLocking: reader threads run against a writer thread
+  {
+    const std::string file = "policy.idx";
+    std::remove(file.c_str());
+    BasicBPlusTree<DefaultSearch, MmapStorage, SharedMutexLocking> tree;
+    tree.open(file);
+    const int count = 40000;
+    std::atomic<bool> bad(false);
+    std::thread writer([&] {
+      uint8_t buf[DATA_SIZE];
+      for (int i = 0; i < count; i++) {
+        fillData(buf, i);
+        tree.writeData(i, buf);
+      }
+    });
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++) {
+      readers.emplace_back([&, r] {
+        std::mt19937 rng(r);
+        uint8_t buf[DATA_SIZE];
+        for (int i = 0; i < 50000; i++) {
+          int32_t k = static_cast<int32_t>(rng() % count);
+          if (tree.readDataShared(k, buf) && !verifyData(buf, k))
+            bad = true;
+        }
+      });
+    }
+    writer.join();
+    for (std::thread &t : readers)
+      t.join();
+    if (bad || tree.getRecordCount() != static_cast<uint32_t>(count)) {
+      log.log("FAIL: Concurrent readers under SharedMutexLocking");
+      ok = false;
+    }
+    tree.close();
+    std::remove(file.c_str());
+  }
+
+  if (ok)
+    log.log("PASS: Policy variants agree with the default tree");
+  return ok;
+}
+
 bool testRandomReads(BPlusTree &tree, Logger &log, int count, int maxKey) {
   log.log("--- Testing Random Reads (" + std::to_string(count) + " reads) ---");
 
@@ -248,20 +1144,1880 @@ bool testPersistence(Logger &log, const std::string &indexFile) {
   return true;
 }
 
-void runBenchmark(BPlusTree &tree, Logger &log) {
-  log.log("=== PERFORMANCE BENCHMARK ===");
-
-  const int SIZES[] = {1000, 10000, 100000};
-
-  for (int size : SIZES) {
-    log.log("\n--- Benchmark: " + std::to_string(size) + " records ---");
+bool testStriping(Logger &log) {
+  log.log("--- Testing Multi-File Striping ---");
 
-    tree.close();
-    std::remove("benchmark.idx");
-    tree.open("benchmark.idx");
+  const std::vector<std::string> files = {"stripe0.idx", "stripe1.idx",
+                                          "stripe2.idx"};
+  for (const auto &f : files)
+    std::remove(f.c_str());
 
+  const int count = 20000;
+  bool ok = true;
+  {
+    BPlusTree tree;
+    if (!tree.open(files)) {
+      log.log("FAIL: Could not open striped index");
+      return false;
+    }
     uint8_t data[DATA_SIZE];
-
+    for (int i = 0; i < count && ok; i++) {
+      fillData(data, i);
+      ok = tree.writeData(i, data);
+    }
+    tree.close();
+  }
+
+  {
+    BPlusTree tree;
+    if (!ok || !tree.open(files)) {
+      log.log("FAIL: Striped insert or reopen failed");
+      return false;
+    }
+    for (int i = 0; i < count; i++) {
+      const uint8_t *result = tree.readData(i);
+      if (!result || !verifyData(result, i)) {
+        log.log("FAIL: Striped read of key " + std::to_string(i));
+        ok = false;
+        break;
+      }
+    }
+    uint32_t n = 0;
+    tree.readRangeData(0, count - 1, n);
+    if (n != static_cast<uint32_t>(count)) {
+      log.log("FAIL: Striped range scan returned " + std::to_string(n));
+      ok = false;
+    }
+    tree.close();
+  }
+
+  {
+    // Opening with a different file set must be rejected
+    BPlusTree tree;
+    if (tree.open(std::vector<std::string>{files[0], files[1]})) {
+      log.log("FAIL: Opened striped index with wrong stripe count");
+      ok = false;
+    }
+  }
+
+  {
+    // A missing stripe (e.g. an absent mount) must not be recreated empty,
+    // and a new stripe 0 must not be initialised over existing stripes
+    std::rename(files[1].c_str(), "stripe1.moved");
+    BPlusTree tree;
+    std::ifstream recreated(files[1]);
+    if (tree.open(files) || recreated.good()) {
+      log.log("FAIL: Opened striped index with a stripe missing");
+      ok = false;
+    }
+    std::rename("stripe1.moved", files[1].c_str());
+    std::rename(files[0].c_str(), "stripe0.moved");
+    BPlusTree fresh;
+    if (fresh.open(files)) {
+      log.log("FAIL: Initialised a new stripe 0 over existing stripes");
+      ok = false;
+    }
+    std::rename("stripe0.moved", files[0].c_str());
+    BPlusTree intact;
+    if (ok && (!intact.open(files) || !intact.readData(count - 1))) {
+      log.log("FAIL: Striped index unreadable after a rejected open");
+      ok = false;
+    }
+  }
+
+  {
+    // A new set whose last stripe cannot be created leaves nothing behind,
+    // so the next attempt starts from scratch
+    const std::vector<std::string> broken = {"newstripe0.idx", "newstripe1.idx",
+                                             "no_such_dir/newstripe2.idx"};
+    BPlusTree tree;
+    std::ifstream left0, left1;
+    if (!tree.open(broken)) {
+      left0.open(broken[0]);
+      left1.open(broken[1]);
+    }
+    BPlusTree retry;
+    std::vector<std::string> fixed = broken;
+    fixed[2] = "newstripe2.idx";
+    if (left0.is_open() || left1.is_open() || !retry.open(fixed)) {
+      log.log("FAIL: A failed open of a new stripe set left files behind");
+      ok = false;
+    }
+    retry.close();
+    for (const auto &f : fixed)
+      std::remove(f.c_str());
+  }
+
+  for (const auto &f : files)
+    std::remove(f.c_str());
+
+  if (ok)
+    log.log("PASS: " + std::to_string(count) + " records across " +
+            std::to_string(files.size()) + " stripes");
+  return ok;
+}
+
+bool testReadOnlyMode(Logger &log) {
+  log.log("--- Testing Read-Only Shared Mapping ---");
+
+  const std::string file = "shared.idx";
+  std::remove(file.c_str());
+
+  BPlusTree reader;
+  if (reader.open(file, OpenMode::READ_ONLY)) {
+    log.log("FAIL: Read-only open of a missing index succeeded");
+    return false;
+  }
+
+  BPlusTree writer;
+  writer.open(file);
+  uint8_t data[DATA_SIZE];
+  fillData(data, 1);
+  writer.writeData(1, data);
+  writer.sync();
+
+  bool ok = true;
+  if (!reader.open(file, OpenMode::READ_ONLY) || !reader.isReadOnly()) {
+    log.log("FAIL: Read-only open of an existing index");
+    ok = false;
+  }
+
+  const uint8_t *result = reader.readData(1);
+  if (ok && (!result || !verifyData(result, 1))) {
+    log.log("FAIL: Reader cannot see committed key");
+    ok = false;
+  }
+
+  fillData(data, 2);
+  if (ok && (reader.writeData(2, data) || reader.deleteData(1))) {
+    log.log("FAIL: Reader was allowed to modify the index");
+    ok = false;
+  }
+
+  if (ok && reader.refresh()) {
+    log.log("FAIL: Refresh reported a change with no new version");
+    ok = false;
+  }
+
+  // Writer grows the tree past the root leaf and publishes a new version
+  for (int i = 2; i < 2000; i++) {
+    fillData(data, i);
+    writer.writeData(i, data);
+  }
+  writer.sync();
+
+  if (ok && !reader.refresh()) {
+    log.log("FAIL: Refresh missed the writer's new version");
+    ok = false;
+  }
+  for (int i = 1; ok && i < 2000; i++) {
+    result = reader.readData(i);
+    if (!result || !verifyData(result, i)) {
+      log.log("FAIL: Reader missing key " + std::to_string(i));
+      ok = false;
+    }
+  }
+
+  reader.close();
+  writer.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Read-only reader follows writer versions");
+  return ok;
+}
+
+bool testSharedReaders(Logger &log) {
+  log.log("--- Testing Single-Writer / Multi-Process Readers ---");
+#ifdef _WIN32
+  log.log("SKIP: Multi-process coordination is POSIX-only");
+  return true;
+#else
+  const std::string file = "mpshared.idx";
+  std::remove(file.c_str());
+  std::remove((file + ".lock").c_str());
+
+  // Enough inserts to grow the file past the reader's initial mapping
+  const int committed = 1000;
+  const int total = 300000;
+
+  BPlusTree writer;
+  writer.open(file);
+  uint8_t data[DATA_SIZE];
+  for (int i = 0; i < committed; i++) {
+    fillData(data, i);
+    writer.writeData(i, data);
+  }
+  writer.sync();
+
+  bool ok = writer.enableSharedAccess();
+  BPlusTree second;
+  second.open(file);
+  if (ok && second.enableSharedAccess()) {
+    log.log("FAIL: Second writer joined the shared protocol");
+    ok = false;
+  }
+  second.close();
+  if (!ok) {
+    writer.close();
+    return false;
+  }
+
+  pid_t child = fork();
+  if (child == 0) {
+    // Reader process: every committed key must always be readable and
+    // intact, keys being inserted must be either absent or intact. Several
+    // threads share the reader, so the writer's growth is remapped while
+    // other threads are between reads.
+    BasicBPlusTree<DefaultSearch, MmapStorage, SharedMutexLocking> reader;
+    if (!reader.open(file, OpenMode::READ_ONLY) || !reader.enableSharedAccess())
+      _exit(2);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    std::atomic<bool> torn{false}, sawLast{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; t++) {
+      threads.emplace_back([&, t] {
+        uint8_t out[DATA_SIZE];
+        std::mt19937 gen(7 + t);
+        std::uniform_int_distribution<> dis(0, total - 1);
+        while (!sawLast && !torn &&
+               std::chrono::steady_clock::now() < deadline) {
+          for (int r = 0; r < 256; r++) {
+            int key = dis(gen);
+            bool found = reader.readDataShared(key, out);
+            if ((key < committed && !found) || (found && !verifyData(out, key)))
+              torn = true;
+          }
+          if (reader.readDataShared(total - 1, out))
+            sawLast = true;
+        }
+      });
+    }
+    for (auto &th : threads)
+      th.join();
+    if (torn)
+      _exit(1);
+
+    std::vector<uint8_t> range;
+    uint32_t n = 0;
+    reader.readRangeShared(0, total - 1, range, n);
+    if (!sawLast || n != static_cast<uint32_t>(total))
+      _exit(3);
+    reader.close();
+    _exit(0);
+  }
+
+  for (int i = committed; i < total; i++) {
+    fillData(data, i);
+    writer.writeData(i, data);
+  }
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  writer.close();
+  std::remove(file.c_str());
+  std::remove((file + ".lock").c_str());
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    log.log("FAIL: Reader process saw inconsistent data (status " +
+            std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1) +
+            ")");
+    return false;
+  }
+  log.log("PASS: Reader process followed " + std::to_string(total) +
+          " concurrent inserts consistently");
+  return true;
+#endif
+}
+
+bool testDeadWriter(Logger &log) {
+  log.log("--- Testing Readers After a Writer Crash ---");
+#ifdef _WIN32
+  log.log("SKIP: Multi-process coordination is POSIX-only");
+  return true;
+#else
+  const std::string file = "deadwriter.idx";
+  std::remove(file.c_str());
+  std::remove((file + ".lock").c_str());
+  uint8_t data[DATA_SIZE];
+  {
+    BPlusTree writer;
+    writer.open(file);
+    writer.enableSharedAccess();
+    for (int i = 0; i < 1000; i++) {
+      fillData(data, i);
+      writer.writeData(i, data);
+    }
+    writer.close();
+  }
+
+  // A writer process that dies inside a write leaves the sequence odd
+  pid_t child = fork();
+  if (child == 0) {
+    SharedCoordinator coord;
+    if (!coord.openWriter(file + ".lock"))
+      _exit(2);
+    coord.writeBegin();
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+
+  // Readers notice and fail instead of spinning forever
+  BPlusTree reader;
+  bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+            reader.open(file, OpenMode::READ_ONLY) &&
+            reader.enableSharedAccess();
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> range;
+  uint32_t n = 1;
+  ok = ok && !reader.readDataShared(5, data);
+  reader.readRangeShared(0, 999, range, n);
+  ok = ok && n == 0 &&
+       std::chrono::steady_clock::now() - start < std::chrono::seconds(5);
+
+  // The next writer evens the sequence out and reads work again
+  BPlusTree writer;
+  ok = ok && writer.open(file) && writer.enableSharedAccess() &&
+       reader.readDataShared(5, data) && verifyData(data, 5);
+  reader.readRangeShared(0, 999, range, n);
+  ok = ok && n == 1000;
+  reader.close();
+  writer.close();
+  std::remove(file.c_str());
+  std::remove((file + ".lock").c_str());
+
+  if (!ok) {
+    log.log("FAIL: Reader after a writer died mid-write");
+    return false;
+  }
+  log.log("PASS: Readers fail fast when the writer dies mid-write");
+  return true;
+#endif
+}
+
+bool testChangeStream(Logger &log) {
+  log.log("--- Testing Change Stream ---");
+  BPlusTree tree;
+  const std::string file = "changes.idx";
+  std::remove(file.c_str());
+  std::remove((file + ".changes").c_str());
+  tree.open(file);
+  if (!tree.enableChangeStream(false, 64)) {
+    log.log("FAIL: Could not open a private change stream");
+    return false;
+  }
+
+  // Puts, batched puts and deletes come out in order, in batches
+  uint8_t data[DATA_SIZE];
+  ChangeCursor cursor(tree.changeStream());
+  for (int i = 0; i < 20; i++) {
+    fillData(data, i);
+    tree.writeData(i, data);
+  }
+  std::vector<int32_t> keys;
+  std::vector<uint8_t> values;
+  for (int i = 20; i < 30; i++) {
+    keys.push_back(i);
+    values.resize(values.size() + DATA_SIZE);
+    fillData(values.data() + values.size() - DATA_SIZE, i);
+  }
+  tree.writeBatch(keys.data(), values.data(), keys.size());
+  for (int i = 0; i < 30; i += 3)
+    tree.deleteData(i);
+  tree.deleteData(1000); // Missing: no event
+
+  ChangeEvent batch[16];
+  std::vector<ChangeEvent> seen;
+  size_t n;
+  while ((n = cursor.poll(batch, 16)) > 0)
+    seen.insert(seen.end(), batch, batch + n);
+
+  bool ok = seen.size() == 40 && !cursor.lagged();
+  for (size_t i = 0; ok && i < seen.size(); i++) {
+    const ChangeEvent &e = seen[i];
+    ok = e.seq == i + 1;
+    if (i < 30)
+      ok = ok && e.op == ChangeOp::PUT && e.key == int32_t(i) &&
+           verifyData(e.value, e.key);
+    else
+      ok = ok && e.op == ChangeOp::DELETE && e.key == int32_t(i - 30) * 3;
+  }
+  if (!ok) {
+    log.log("FAIL: Change stream delivered " + std::to_string(seen.size()) +
+            " events, expected 40 in order");
+    return false;
+  }
+
+  // A consumer that falls a full ring behind is told, and can resume
+  for (int i = 100; i < 200; i++) {
+    fillData(data, i);
+    tree.writeData(i, data);
+  }
+  if (cursor.poll(batch, 16) != 0 || !cursor.lagged()) {
+    log.log("FAIL: Overrun consumer was not reported as lagged");
+    return false;
+  }
+  cursor.seek(tree.changeStream().oldestSeq());
+  seen.clear();
+  while ((n = cursor.poll(batch, 16)) > 0)
+    seen.insert(seen.end(), batch, batch + n);
+  if (seen.size() != 64 || seen.back().key != 199 || cursor.lagged()) {
+    log.log("FAIL: Consumer did not resume from the oldest retained record");
+    return false;
+  }
+  tree.close();
+  std::remove(file.c_str());
+
+#ifndef _WIN32
+  // Another process tails the shared <index>.changes ring
+  tree.open(file);
+  if (!tree.enableChangeStream()) {
+    log.log("FAIL: Could not open the shared change stream");
+    return false;
+  }
+  const int total = 20000;
+  const uint64_t first = tree.changeStream().nextSeq();
+  pid_t child = fork();
+  if (child == 0) {
+    ChangeStream stream;
+    if (!stream.attach(file + ".changes"))
+      _exit(2);
+    ChangeCursor follower(stream, first);
+    std::vector<ChangeEvent> buf(256);
+    int expected = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (expected < total && std::chrono::steady_clock::now() < deadline) {
+      size_t got = follower.pollWait(buf.data(), buf.size(), 100);
+      if (follower.lagged())
+        _exit(3);
+      for (size_t i = 0; i < got; i++) {
+        if (buf[i].key != expected || !verifyData(buf[i].value, expected))
+          _exit(1);
+        expected++;
+      }
+    }
+    _exit(expected == total ? 0 : 4);
+  }
+  for (int i = 0; i < total; i++) {
+    fillData(data, i);
+    tree.writeData(i, data);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  tree.close();
+  std::remove(file.c_str());
+  std::remove((file + ".changes").c_str());
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    log.log("FAIL: Consumer process lost or misread changes (status " +
+            std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1) +
+            ")");
+    return false;
+  }
+#endif
+
+  log.log("PASS: Change stream delivers ordered puts/deletes, reports "
+          "overrun, and is followed across processes");
+  return true;
+}
+
+#ifndef _WIN32
+static bool sameContents(BPlusTree &a, Replica<BPlusTree> &b) {
+  uint32_t na = 0, nb = 0;
+  std::vector<uint8_t *> ra = a.readRangeData(INT32_MIN, INT32_MAX, na);
+  std::vector<uint8_t *> rb = b.readRange(INT32_MIN, INT32_MAX, nb);
+  if (na != nb)
+    return false;
+  for (uint32_t i = 0; i < na; i++) {
+    if (std::memcmp(ra[i], rb[i], DATA_SIZE) != 0)
+      return false;
+  }
+  return true;
+}
+#endif
+
+bool testReplica(Logger &log) {
+  log.log("--- Testing Log-Shipping Replica ---");
+#ifdef _WIN32
+  log.log("SKIP: Replicas need the shared change stream (POSIX-only)");
+  return true;
+#else
+  const std::string primaryFile = "primary.idx";
+  const std::string followerFile = "follower.idx";
+  auto cleanup = [&]() {
+    for (const std::string &f : {primaryFile, followerFile}) {
+      std::remove(f.c_str());
+      std::remove((f + ".lock").c_str());
+      std::remove((f + ".changes").c_str());
+    }
+  };
+  cleanup();
+
+  // The primary runs in another process and keeps writing while the
+  // replica takes its snapshot and follows the stream
+  int ready[2];
+  if (pipe(ready) != 0)
+    return false;
+  pid_t child = fork();
+  if (child == 0) {
+    ::close(ready[0]);
+    BPlusTree primary;
+    uint8_t data[DATA_SIZE];
+    if (!primary.open(primaryFile))
+      _exit(2);
+    for (int i = 0; i < 5000; i++) {
+      fillData(data, i * 2);
+      primary.writeData(i * 2, data);
+    }
+    if (!primary.enableSharedAccess() || !primary.enableChangeStream())
+      _exit(3);
+    char c = 1;
+    if (write(ready[1], &c, 1) != 1)
+      _exit(4);
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> dis(0, 20000);
+    for (int i = 0; i < 40000; i++) {
+      int key = dis(gen);
+      if (i % 10 == 9) {
+        primary.deleteData(key);
+      } else {
+        fillData(data, key);
+        primary.writeData(key, data);
+      }
+    }
+    primary.close();
+    _exit(0);
+  }
+  ::close(ready[1]);
+  char c;
+  bool started = read(ready[0], &c, 1) == 1;
+  ::close(ready[0]);
+
+  Replica<BPlusTree> replica;
+  bool ok = started && replica.open(primaryFile, followerFile);
+  int status = 0;
+  while (ok && waitpid(child, &status, WNOHANG) == 0)
+    ok = replica.poll(50) >= 0;
+  if (!ok)
+    waitpid(child, &status, 0);
+  ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+       replica.catchUp();
+
+  BPlusTree primary;
+  ok = ok && primary.open(primaryFile) && sameContents(primary, replica);
+  if (!ok) {
+    log.log("FAIL: Replica diverged from a concurrently written primary");
+    cleanup();
+    return false;
+  }
+
+  // Restarting the replica resumes from the stored position
+  const uint64_t resyncs = replica.statistics().resyncs;
+  replica.close();
+  if (!primary.enableSharedAccess() || !primary.enableChangeStream() ||
+      !replica.open(primaryFile, followerFile) ||
+      replica.statistics().resyncs != resyncs) {
+    log.log("FAIL: Reopened replica did not resume from its position");
+    cleanup();
+    return false;
+  }
+
+  // Batched apply versus the primary's own write rate, on a follower that
+  // already holds 200K records: bursts of random puts, a tenth of them
+  // deleting a key put earlier in the burst, with both files synced first
+  std::vector<int32_t> preload(50000);
+  std::vector<uint8_t> preValues(preload.size() * DATA_SIZE);
+  for (int chunk = 0; ok && chunk < 4; chunk++) {
+    for (size_t i = 0; i < preload.size(); i++) {
+      preload[i] = 2000000 + int32_t(chunk * preload.size() + i) * 5;
+      fillData(&preValues[i * DATA_SIZE], preload[i]);
+    }
+    ok = primary.writeBatch(preload.data(), preValues.data(), preload.size()) ==
+             preload.size() &&
+         replica.catchUp();
+  }
+  primary.sync();
+  replica.sync();
+
+  const int burst = 50000, rounds = 3;
+  std::mt19937 gen(12);
+  std::uniform_int_distribution<> dis(0, 1000000);
+  uint8_t data[DATA_SIZE];
+  double primaryUs = 0, replicaUs = 0;
+  for (int r = 0; ok && r < rounds; r++) {
+    std::vector<int> written;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < burst; i++) {
+      if (i % 10 == 9) {
+        primary.deleteData(written[gen() % written.size()]);
+        continue;
+      }
+      int key = dis(gen);
+      fillData(data, key);
+      primary.writeData(key, data);
+      written.push_back(key);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    ok = replica.catchUp();
+    auto t2 = std::chrono::steady_clock::now();
+    primaryUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+    replicaUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+  }
+  ok = ok && sameContents(primary, replica) &&
+       replica.statistics().resyncs == resyncs &&
+       replica.statistics().superseded > 0;
+  replica.close();
+  primary.close();
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Replica did not catch up with a burst of writes");
+    return false;
+  }
+  // Sorted, deduplicated batches must beat the primary's random writes
+  if (replicaUs * 1.25 > primaryUs) {
+    std::ostringstream msg;
+    msg << std::fixed << std::setprecision(1) << "FAIL: Replica applied "
+        << rounds * burst << " changes in " << replicaUs / 1000
+        << " ms, not clearly faster than the primary's " << primaryUs / 1000
+        << " ms";
+    log.log(msg.str());
+    return false;
+  }
+
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1) << "PASS: Replica follows a "
+      << "primary process, resumes after restart, and applied "
+      << rounds * burst << " changes in " << replicaUs / 1000
+      << " ms (primary " << primaryUs / 1000 << " ms, "
+      << primaryUs / replicaUs << "x)";
+  log.log(msg.str());
+  return true;
+#endif
+}
+
+bool testReplicaTtl(Logger &log) {
+  log.log("--- Testing Replica of a TTL Primary ---");
+#ifdef _WIN32
+  log.log("SKIP: Replicas need the shared change stream (POSIX-only)");
+  return true;
+#else
+  const std::string primaryFile = "ttlprimary.idx";
+  const std::string followerFile = "ttlfollower.idx";
+  auto cleanup = [&]() {
+    for (const std::string &f : {primaryFile, followerFile}) {
+      std::remove(f.c_str());
+      std::remove((f + ".lock").c_str());
+      std::remove((f + ".changes").c_str());
+    }
+  };
+  cleanup();
+
+  // Every other key expires in an hour; the first half reaches the
+  // follower through the snapshot, the second through the stream
+  BPlusTree primary;
+  primary.setTtlLeaves(true);
+  bool ok = primary.open(primaryFile) && primary.enableSharedAccess() &&
+            primary.enableChangeStream();
+  const uint32_t now = primary.clockNow();
+  uint8_t data[DATA_SIZE];
+  auto writeRange = [&](int from, int to) {
+    for (int i = from; i < to && ok; i++) {
+      fillData(data, i);
+      ok = primary.writeData(i, data, i % 2 ? now + 3600 : 0);
+    }
+  };
+  writeRange(0, 2000);
+
+  Replica<> replica;
+  ok = ok && replica.open(primaryFile, followerFile);
+  writeRange(2000, 4000);
+  ok = ok && replica.catchUp() && replica.recordCount() == 4000;
+
+  // An hour on, only the keys without an expiry are left on the follower
+  replica.pinClock(now + 7200);
+  uint8_t out[DATA_SIZE];
+  for (int i = 0; i < 4000 && ok; i++) {
+    const bool found = replica.read(i, out);
+    fillData(data, i);
+    ok = found == (i % 2 == 0) &&
+         (!found || std::memcmp(out, data, DATA_SIZE) == 0);
+  }
+  replica.close();
+  primary.close();
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Replica did not carry the primary's expiries");
+    return false;
+  }
+  log.log("PASS: Replica expires records from both its snapshot and the "
+          "stream with the primary");
+  return true;
+#endif
+}
+
+bool testTtl(Logger &log) {
+  log.log("--- Testing TTL Expiry ---");
+  const std::string file = "ttl.idx";
+  std::remove(file.c_str());
+  uint8_t data[DATA_SIZE];
+
+  {
+    BPlusTree plain; // Leaves without an expiry array refuse one
+    plain.open(file);
+    fillData(data, 1);
+    bool refused = !plain.writeData(1, data, 100);
+    plain.close();
+    std::remove(file.c_str());
+    if (!refused) {
+      log.log("FAIL: Expiry accepted by a leaf without an expiry array");
+      return false;
+    }
+  }
+
+  const int n = 3000;
+  BPlusTree tree;
+  tree.setTtlLeaves(true);
+  tree.open(file);
+  tree.pinClock(1000);
+  for (int i = 0; i < n; i++) {
+    fillData(data, i);
+    uint32_t expiry = i % 3 == 0 ? 1100 : i % 3 == 1 ? 1200 : 0;
+    tree.writeData(i, data, expiry);
+  }
+
+  auto visible = [&]() {
+    uint32_t count = 0;
+    tree.readRangeData(INT32_MIN, INT32_MAX, count);
+    return count;
+  };
+  bool ok = visible() == uint32_t(n);
+
+  // Expired entries are absent to every read path before any sweep
+  tree.pinClock(1150);
+  std::vector<int32_t> keys(n);
+  std::vector<const uint8_t *> out(n);
+  for (int i = 0; i < n; i++)
+    keys[i] = i;
+  size_t found = tree.readBatch(keys.data(), n, out.data());
+  uint8_t copy[DATA_SIZE];
+  ok = ok && visible() == uint32_t(n - n / 3) && found == size_t(n - n / 3) &&
+       !tree.readData(0) && !tree.readDataShared(3, copy) &&
+       tree.readData(1) && !tree.deleteData(6);
+  fillData(data, 3);
+  ok = ok && tree.writeData(3, data, 2000) && tree.readData(3);
+  if (!ok) {
+    log.log("FAIL: Expired entries visible to lookups or scans");
+    return false;
+  }
+
+  // Bounded sweeps, then the rest; the rewritten key survives
+  size_t first = tree.sweepExpired(100);
+  size_t rest = tree.sweepExpired();
+  if (first != 100 || first + rest != size_t(n / 3 - 1) ||
+      tree.getRecordCount() != uint32_t(n - n / 3 + 1) || !tree.readData(3) ||
+      visible() != tree.getRecordCount()) {
+    log.log("FAIL: Sweep removed " + std::to_string(first + rest) +
+            " records, expected " + std::to_string(n / 3 - 1));
+    return false;
+  }
+  tree.close();
+
+  // The expiry index is rebuilt from the leaves after reopening
+  tree.setTtlLeaves(true);
+  tree.open(file);
+  tree.pinClock(1250);
+  size_t swept = tree.sweepExpired();
+  ok = swept == size_t(n / 3) && tree.getRecordCount() == uint32_t(n / 3 + 1);
+  tree.close();
+  std::remove(file.c_str());
+  if (!ok) {
+    log.log("FAIL: Sweep after reopen removed " + std::to_string(swept) +
+            " records");
+    return false;
+  }
+
+  // Background sweeper alongside a writer thread
+  using LockedTree = BasicBPlusTree<DefaultSearch, MmapStorage,
+                                    SharedMutexLocking>;
+  LockedTree locked;
+  locked.setTtlLeaves(true);
+  locked.open(file);
+  locked.pinClock(5000);
+  for (int i = 0; i < 2000; i++) {
+    fillData(data, i);
+    locked.writeData(i, data, 5001);
+  }
+  TtlSweeper<LockedTree> sweeper(locked, std::chrono::milliseconds(5), 256);
+  sweeper.start();
+  locked.pinClock(5002);
+  std::thread writer([&]() {
+    uint8_t d[DATA_SIZE];
+    for (int i = 2000; i < 6000; i++) {
+      fillData(d, i);
+      locked.writeData(i, d);
+    }
+  });
+  writer.join();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (sweeper.removedRecords() < 2000 &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  sweeper.stop();
+  ok = sweeper.removedRecords() == 2000 && sweeper.sweeps() >= 8 &&
+       locked.getRecordCount() == 4000 && locked.readData(2000) &&
+       !locked.readData(0);
+  locked.close();
+  std::remove(file.c_str());
+  if (!ok) {
+    log.log("FAIL: Background sweeper removed " +
+            std::to_string(sweeper.removedRecords()) + " of 2000 records");
+    return false;
+  }
+
+  log.log("PASS: Expired records are hidden at once, swept leaf by leaf in "
+          "bounded batches, and swept in the background");
+  return true;
+}
+
+static bool sameRecords(BPlusTree &a, BPlusTree &b) {
+  uint32_t na = 0, nb = 0;
+  std::vector<uint8_t *> ra = a.readRangeData(INT32_MIN, INT32_MAX, na);
+  std::vector<uint8_t *> rb = b.readRangeData(INT32_MIN, INT32_MAX, nb);
+  if (na != nb)
+    return false;
+  for (uint32_t i = 0; i < na; i++) {
+    if (std::memcmp(ra[i], rb[i], DATA_SIZE) != 0)
+      return false;
+  }
+  return true;
+}
+
+static size_t fileSize(const std::string &path) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  return f ? static_cast<size_t>(f.tellg()) : 0;
+}
+
+bool testExportImport(Logger &log) {
+  log.log("--- Testing Export / Import ---");
+  const std::string srcFile = "export_src.idx", dstFile = "export_dst.idx";
+  const std::string runFile = "export.run";
+  auto cleanup = [&]() {
+    std::remove(srcFile.c_str());
+    std::remove(dstFile.c_str());
+    std::remove(runFile.c_str());
+  };
+  cleanup();
+  uint8_t data[DATA_SIZE];
+
+  // Clustered values, with tombstones and unsorted tails to skip over
+  BPlusTree src;
+  src.setLazyDelete(true);
+  src.setUnsortedTail(8);
+  src.open(srcFile);
+  const int n = 50000;
+  for (int i = 0; i < n; i++) {
+    int key = (i * 7919) % n; // Every key once, out of order
+    fillData(data, key);
+    src.writeData(key, data);
+  }
+  for (int i = 0; i < n; i += 10)
+    src.deleteData(i);
+
+  int64_t exported = src.exportTo(runFile);
+  const size_t rawBytes = size_t(src.getRecordCount()) * (4 + DATA_SIZE);
+  const size_t runBytes = fileSize(runFile);
+  BPlusTree dst;
+  dst.open(dstFile);
+  bool ok = exported == int64_t(src.getRecordCount()) &&
+            dst.importFrom(runFile) &&
+            dst.getRecordCount() == src.getRecordCount() &&
+            sameRecords(src, dst) && !dst.readData(0) && dst.readData(1);
+  // The tree must be empty
+  ok = ok && !dst.importFrom(runFile);
+  dst.close();
+  std::remove(dstFile.c_str());
+  if (!ok || runBytes * 2 > rawBytes) {
+    log.log("FAIL: Clustered export/import round trip (" +
+            std::to_string(runBytes) + " bytes for " +
+            std::to_string(rawBytes) + " raw)");
+    cleanup();
+    return false;
+  }
+
+  // Damage one payload byte: the block checksum catches it
+  {
+    std::fstream f(runFile, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekg(static_cast<std::streamoff>(runBytes / 2));
+    char c;
+    f.read(&c, 1);
+    c = static_cast<char>(c ^ 0x5A);
+    f.seekp(static_cast<std::streamoff>(runBytes / 2));
+    f.write(&c, 1);
+  }
+  // The blocks before the damaged one were loaded; their pages are freed
+  dst.open(dstFile);
+  const uint32_t inUse = dst.getPageCount() - dst.getFreePageCount();
+  ok = !dst.importFrom(runFile) && dst.getRecordCount() == 0 &&
+       dst.getPageCount() > inUse + 100 &&
+       dst.getPageCount() - dst.getFreePageCount() == inUse;
+  dst.close();
+  std::remove(dstFile.c_str());
+  src.close();
+  std::remove(srcFile.c_str());
+  if (!ok) {
+    log.log("FAIL: Import accepted a corrupted file");
+    cleanup();
+    return false;
+  }
+
+  // Incompressible values still round-trip, with little overhead
+  std::mt19937 gen(21);
+  src.open(srcFile);
+  for (int i = 0; i < 20000; i++) {
+    for (size_t j = 0; j < DATA_SIZE; j++)
+      data[j] = static_cast<uint8_t>(gen());
+    src.writeData(static_cast<int32_t>(gen()), data);
+  }
+  exported = src.exportTo(runFile, 1000);
+  const size_t randomRaw = size_t(src.getRecordCount()) * (4 + DATA_SIZE);
+  const size_t randomRun = fileSize(runFile);
+  dst.open(dstFile);
+  ok = exported == int64_t(src.getRecordCount()) && dst.importFrom(runFile, 70) &&
+       sameRecords(src, dst) && randomRun < randomRaw * 105 / 100;
+  dst.close();
+  src.close();
+  std::remove(dstFile.c_str());
+  std::remove(srcFile.c_str());
+  if (!ok) {
+    log.log("FAIL: Random-value export/import round trip");
+    cleanup();
+    return false;
+  }
+
+  // Expiries travel with the records; expired ones are left behind
+  src.setTtlLeaves(true);
+  src.open(srcFile);
+  src.pinClock(100);
+  for (int i = 0; i < 1000; i++) {
+    fillData(data, i);
+    src.writeData(i, data, i % 2 ? 150 : 0);
+  }
+  src.pinClock(120);
+  for (int i = 0; i < 1000; i += 4)
+    src.writeData(i, data, 110); // Already expired
+  exported = src.exportTo(runFile);
+  BPlusTree plain;
+  plain.open(dstFile);
+  ok = exported == 750 && !plain.importFrom(runFile) &&
+       plain.getPageCount() - plain.getFreePageCount() == 1;
+  plain.close();
+  std::remove(dstFile.c_str());
+  dst.setTtlLeaves(true);
+  dst.open(dstFile);
+  dst.pinClock(120);
+  ok = ok && dst.importFrom(runFile) && sameRecords(src, dst);
+  dst.pinClock(160);
+  ok = ok && dst.readData(2) && !dst.readData(1) &&
+       dst.sweepExpired() == 500;
+  dst.close();
+  src.close();
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Expiries lost in export/import");
+    return false;
+  }
+
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1)
+      << "PASS: Export/import round trips (clustered "
+      << double(rawBytes) / runBytes << "x smaller, random "
+      << 100.0 * randomRun / randomRaw << "% of raw), checksums and TTLs";
+  log.log(msg.str());
+  return true;
+}
+
+bool testExternalSort(Logger &log) {
+  log.log("--- Testing External Sort ---");
+  const std::string file = "extsort.idx";
+  std::remove(file.c_str());
+  std::mt19937 gen(97);
+  uint8_t data[DATA_SIZE];
+
+  // A small budget forces many runs and more than one merge pass; about a
+  // quarter of the keys repeat, and the last value added must win
+  const int n = 200000;
+  std::map<int32_t, int32_t> expected;
+  ExternalSorter sorter(4 << 20, 2);
+  for (int i = 0; i < n; i++) {
+    int32_t key = static_cast<int32_t>(gen() % (n * 3 / 4)) - n / 3;
+    fillData(data, i);
+    sorter.add(key, data);
+    expected[key] = i;
+  }
+  BPlusTree tree;
+  tree.open(file);
+  bool ok = bulkLoadUnsorted(tree, sorter) &&
+            tree.getRecordCount() == expected.size();
+  for (auto it = expected.begin(); ok && it != expected.end(); ++it) {
+    fillData(data, it->second);
+    const uint8_t *v = tree.readData(it->first);
+    ok = v && std::memcmp(v, data, DATA_SIZE) == 0;
+  }
+  const ExternalSorter::Stats st = sorter.statistics();
+  ok = ok && st.runs > 4 && st.mergePasses > 1 &&
+       st.duplicates == uint64_t(n) - expected.size();
+  tree.close();
+  std::remove(file.c_str());
+  if (!ok) {
+    log.log("FAIL: External sort through runs on disk");
+    return false;
+  }
+
+  // Input that fits in memory is sorted in place; sink errors propagate
+  ExternalSorter small;
+  for (int32_t key : {5, -3, 9, 5, 0}) {
+    fillData(data, key);
+    small.add(key, data);
+  }
+  std::vector<int32_t> seen;
+  ok = small.finish([&](int32_t k, const uint8_t *) {
+    seen.push_back(k);
+    return true;
+  }) && seen == std::vector<int32_t>{-3, 0, 5, 9} &&
+       small.statistics().runs == 0 && small.statistics().duplicates == 1 &&
+       !small.add(1, data);
+  ExternalSorter refused;
+  refused.add(1, data);
+  ok = ok && !refused.finish([](int32_t, const uint8_t *) { return false; });
+  if (!ok) {
+    log.log("FAIL: In-memory external sort");
+    return false;
+  }
+
+  log.log("PASS: External sort (" + std::to_string(st.runs) + " runs, " +
+          std::to_string(st.mergePasses) + " merge passes, " +
+          std::to_string(st.duplicates) + " duplicates resolved)");
+  return true;
+}
+
+bool testParallelBulkLoad(Logger &log) {
+  log.log("--- Testing Parallel Bulk Load ---");
+  const std::string seqFile = "bulk_seq.idx", parFile = "bulk_par.idx";
+  std::remove(seqFile.c_str());
+  std::remove(parFile.c_str());
+
+  const int count = 300000;
+  std::vector<int32_t> keys(count);
+  std::vector<uint8_t> values(static_cast<size_t>(count) * DATA_SIZE);
+  for (int i = 0; i < count; i++) {
+    keys[i] = i * 5 - count;
+    fillData(&values[static_cast<size_t>(i) * DATA_SIZE], keys[i]);
+  }
+
+  // Same records, fences and leaf chain as the sequential loader
+  BPlusTree seq, par;
+  seq.open(seqFile);
+  par.open(parFile);
+  bool ok = seq.bulkLoad(keys.data(), values.data(), count, 70) &&
+            par.bulkLoadParallel(keys.data(), values.data(), count, 70, 4) &&
+            par.getRecordCount() == uint32_t(count) && sameRecords(seq, par) &&
+            !par.bulkLoadParallel(keys.data(), values.data(), count); // Not empty
+  uint8_t data[DATA_SIZE];
+  fillData(data, 3);
+  ok = ok && par.writeData(3, data) && par.readData(3) &&
+       par.readData(keys[count - 1]) && !par.readData(keys[0] + 1);
+  seq.close();
+  par.close();
+  {
+    PageManager pm;
+    ok = ok && pm.open(parFile, OpenMode::READ_ONLY) &&
+         fencesMatch(pm, pm.getMetadata()->rootPageId, INT32_MIN, INT32_MAX);
+  }
+  std::remove(seqFile.c_str());
+  std::remove(parFile.c_str());
+  if (!ok) {
+    log.log("FAIL: Parallel bulk load differs from the sequential one");
+    return false;
+  }
+
+  // An out-of-order key in any worker's slice rejects the load and leaves
+  // the tree empty and usable
+  std::swap(keys[count * 3 / 4], keys[count * 3 / 4 + 1]);
+  par.open(parFile);
+  ok = !par.bulkLoadParallel(keys.data(), values.data(), count, 100, 4) &&
+       par.getRecordCount() == 0 && !par.readData(keys[0]);
+  std::swap(keys[count * 3 / 4], keys[count * 3 / 4 + 1]);
+  ok = ok && par.bulkLoadParallel(keys.data(), values.data(), count / 2) &&
+       par.getRecordCount() == uint32_t(count / 2);
+  par.close();
+  std::remove(parFile.c_str());
+  if (!ok) {
+    log.log("FAIL: Parallel bulk load accepted unsorted keys");
+    return false;
+  }
+
+  log.log("PASS: Parallel bulk load matches the sequential loader");
+  return true;
+}
+
+// Contents equal to key -> fillData seed, in key order
+static bool holds(BPlusTree &tree, const std::map<int32_t, int32_t> &expected) {
+  uint32_t n = 0;
+  std::vector<uint8_t *> got = tree.readRangeData(INT32_MIN, INT32_MAX, n);
+  if (n != expected.size() || tree.getRecordCount() != n)
+    return false;
+  uint8_t data[DATA_SIZE];
+  uint32_t i = 0;
+  for (const auto &kv : expected) {
+    fillData(data, kv.second);
+    if (std::memcmp(got[i++], data, DATA_SIZE) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool testApplySorted(Logger &log) {
+  log.log("--- Testing Sorted Batch Apply ---");
+  const std::string file = "apply.idx";
+  std::remove(file.c_str());
+  std::mt19937 gen(94);
+  std::map<int32_t, int32_t> expected;
+  uint8_t data[DATA_SIZE];
+
+  BPlusTree tree;
+  tree.open(file);
+  bool ok = true;
+  // A batch far larger than the tree is merge-joined, a small one goes leaf
+  // by leaf; both mix puts, overwrites and deletes of present and absent keys
+  for (int size : {20000, 3000, 3000}) {
+    std::map<int32_t, int32_t> batch; // key -> seed, -1 = delete
+    while (batch.size() < size_t(size)) {
+      int32_t key = int32_t(gen() % 60000);
+      batch[key] = gen() % 4 == 0 ? -1 : int32_t(gen() % 1000000);
+    }
+    std::vector<int32_t> keys;
+    std::vector<uint8_t> values(batch.size() * DATA_SIZE);
+    std::vector<const uint8_t *> sources;
+    for (const auto &kv : batch) {
+      uint8_t *v = &values[keys.size() * DATA_SIZE];
+      keys.push_back(kv.first);
+      fillData(v, kv.second);
+      sources.push_back(kv.second < 0 ? nullptr : v);
+      if (kv.second < 0)
+        expected.erase(kv.first);
+      else
+        expected[kv.first] = kv.second;
+    }
+    ok = ok && tree.applySorted(keys.data(), sources.data(), nullptr,
+                                keys.size()) &&
+         holds(tree, expected);
+  }
+  int32_t unsorted[2] = {5, 5};
+  const uint8_t *twice[2] = {data, data};
+  ok = ok && !tree.applySorted(unsorted, twice, nullptr, 2) &&
+       holds(tree, expected);
+  tree.close();
+  std::remove(file.c_str());
+  if (!ok) {
+    log.log("FAIL: Sorted batch apply differs from applying one by one");
+    return false;
+  }
+  log.log("PASS: Sorted batches apply by merge join and leaf by leaf");
+  return true;
+}
+
+bool testMerge(Logger &log) {
+  log.log("--- Testing Merge ---");
+  const std::string liveFile = "merge_live.idx", partFile = "merge_part.idx";
+  auto cleanup = [&]() {
+    std::remove(liveFile.c_str());
+    std::remove(partFile.c_str());
+  };
+  cleanup();
+  uint8_t data[DATA_SIZE];
+  std::map<int32_t, int32_t> expected;
+  auto put = [&](BPlusTree &t, int32_t key, int32_t seed) {
+    fillData(data, seed);
+    t.writeData(key, data);
+  };
+  auto fencesOk = [&](const std::string &file) {
+    PageManager pm;
+    return pm.open(file, OpenMode::READ_ONLY) &&
+           fencesMatch(pm, pm.getMetadata()->rootPageId, INT32_MIN, INT32_MAX);
+  };
+
+  // Disjoint ranges: the partition's leaves are spliced on, this tree's
+  // leaves stay where they are
+  BPlusTree live, part;
+  live.open(liveFile);
+  part.setLazyDelete(true);
+  part.open(partFile);
+  for (int i = 0; i < 60000; i++) {
+    int32_t key = (i * 7919) % 60000;
+    put(live, key, key);
+    expected[key] = key;
+  }
+  for (int i = 0; i < 40000; i++) {
+    int32_t key = 100000 + (i * 7919) % 40000;
+    put(part, key, -key);
+    expected[key] = -key;
+  }
+  for (int i = 100000; i < 140000; i += 7) {
+    part.deleteData(i); // Tombstones travel hidden
+    expected.erase(i);
+  }
+  const uint32_t livePages = live.getPageCount();
+  const uint32_t partPages = part.getPageCount();
+  // Grows by the partition's leaves and a new set of internal nodes only
+  bool ok = live.merge(part) == int64_t(expected.size()) &&
+            holds(live, expected) &&
+            live.getPageCount() < livePages + partPages + 16 &&
+            live.merge(live) < 0;
+  live.close();
+  ok = ok && fencesOk(liveFile);
+  live.open(liveFile);
+  ok = ok && holds(live, expected);
+  part.close();
+  std::remove(partFile.c_str());
+  if (!ok) {
+    log.log("FAIL: Splicing merge of disjoint ranges");
+    cleanup();
+    return false;
+  }
+
+  // A partition below the live range is spliced on the left
+  part.open(partFile);
+  for (int32_t key = -50000; key < -1000; key += 3) {
+    put(part, key, key * 2);
+    expected[key] = key * 2;
+  }
+  ok = live.merge(part) == int64_t(expected.size()) && holds(live, expected);
+  part.close();
+  std::remove(partFile.c_str());
+
+  // Overlapping ranges: merge join; the partition wins on equal keys and
+  // leaves of another format are decoded rather than copied
+  part.setSlottedValues(true);
+  part.open(partFile);
+  for (int32_t key = -2000; key < 200000; key += 5) {
+    put(part, key, key + 1);
+    expected[key] = key + 1;
+  }
+  ok = ok && live.merge(part, 90) == int64_t(expected.size()) &&
+       holds(live, expected);
+  put(live, 7, 7); // Still writable
+  expected[7] = 7;
+  ok = ok && holds(live, expected);
+  part.close();
+  live.close();
+  ok = ok && fencesOk(liveFile);
+
+  // A join that fails part way, on an expiry this tree's leaves cannot
+  // hold, leaves the tree as it was and frees the pages it built
+  std::remove(partFile.c_str());
+  part.setSlottedValues(false);
+  part.setTtlLeaves(true);
+  part.open(partFile);
+  for (int32_t key = 0; key < 50000; key += 2) {
+    fillData(data, key);
+    part.writeData(key, data, key < 40000 ? 0 : UINT32_MAX - 1);
+  }
+  live.open(liveFile);
+  const uint32_t inUse = live.getPageCount() - live.getFreePageCount();
+  ok = ok && live.merge(part) < 0 && holds(live, expected) &&
+       live.getPageCount() - live.getFreePageCount() == inUse;
+  part.close();
+  live.close();
+  part.setTtlLeaves(false);
+  ok = ok && fencesOk(liveFile);
+
+  // Merging into an empty tree splices; an empty partition is a no-op
+  std::remove(partFile.c_str());
+  part.open(partFile);
+  BPlusTree empty;
+  std::remove("merge_empty.idx");
+  empty.open("merge_empty.idx");
+  ok = ok && empty.merge(part) == 0;
+  live.open(liveFile, OpenMode::READ_ONLY);
+  ok = ok && empty.merge(live) == int64_t(expected.size()) &&
+       holds(empty, expected);
+  empty.close();
+  live.close();
+  part.close();
+  ok = ok && fencesOk("merge_empty.idx");
+  std::remove("merge_empty.idx");
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Merge join of overlapping ranges");
+    return false;
+  }
+
+  log.log("PASS: Merge splices disjoint trees and joins overlapping ones");
+  return true;
+}
+
+bool testSplitAt(Logger &log) {
+  log.log("--- Testing Split ---");
+  const std::string lowFile = "split_low.idx", highFile = "split_high.idx";
+  auto cleanup = [&]() {
+    std::remove(lowFile.c_str());
+    std::remove(highFile.c_str());
+  };
+  cleanup();
+  uint8_t data[DATA_SIZE];
+  auto fencesOk = [&](const std::string &file) {
+    PageManager pm;
+    return pm.open(file, OpenMode::READ_ONLY) &&
+           (pm.getMetadata()->rootPageId == INVALID_PAGE ||
+            fencesMatch(pm, pm.getMetadata()->rootPageId, INT32_MIN,
+                        INT32_MAX));
+  };
+
+  // Random inserts with tombstones and unsorted tails on both sides
+  std::map<int32_t, int32_t> all;
+  BPlusTree low, high;
+  low.setLazyDelete(true);
+  low.setUnsortedTail(8);
+  low.open(lowFile);
+  for (int i = 0; i < 80000; i++) {
+    int32_t key = (i * 7919) % 80000 * 3;
+    fillData(data, key);
+    low.writeData(key, data);
+    all[key] = key;
+  }
+  for (int32_t key = 0; key < 240000; key += 33) {
+    low.deleteData(key);
+    all.erase(key);
+  }
+
+  const int32_t cutKey = 120001;
+  std::map<int32_t, int32_t> below(all.begin(), all.lower_bound(cutKey));
+  std::map<int32_t, int32_t> above(all.lower_bound(cutKey), all.end());
+  high.open(highFile);
+  bool ok = low.splitAt(cutKey, high) == int64_t(above.size()) &&
+            holds(low, below) && holds(high, above) &&
+            !low.readData(above.begin()->first);
+  fillData(data, 5);
+  ok = ok && high.writeData(cutKey, data) && low.writeData(cutKey - 2, data);
+  high.deleteData(cutKey);
+  low.deleteData(cutKey - 2);
+  low.close();
+  high.close();
+  ok = ok && fencesOk(lowFile) && fencesOk(highFile);
+  low.open(lowFile);
+  high.open(highFile);
+  ok = ok && holds(low, below) && holds(high, above);
+
+  // Merging the halves back restores the original by splicing
+  ok = ok && low.merge(high) == int64_t(all.size()) && holds(low, all);
+  high.close();
+  std::remove(highFile.c_str());
+  if (!ok) {
+    low.close();
+    cleanup();
+    log.log("FAIL: Split in the middle of the key range");
+    return false;
+  }
+
+  // Cuts past either end move nothing or everything
+  high.open(highFile);
+  ok = low.splitAt(INT32_MAX, high) == 0 && high.getRecordCount() == 0 &&
+       holds(low, all) && low.splitAt(INT32_MIN, high) == int64_t(all.size()) &&
+       low.getRecordCount() == 0 && !low.readData(3) && holds(high, all) &&
+       low.splitAt(0, high) < 0; // The upper tree must be empty
+  fillData(data, 9);
+  ok = ok && low.writeData(9, data) && low.readData(9);
+  low.close();
+  high.close();
+  ok = ok && fencesOk(lowFile) && fencesOk(highFile);
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Split at the ends of the key range");
+    return false;
+  }
+
+#ifndef _WIN32
+  // A split that runs out of pages after the upper side is built: the lower
+  // file is filled to its mapped size, and the file size limit stops it
+  // growing for the lower levels. Both files keep the pages they had in use.
+  low.setSplitPolicy(SplitPolicy::FILL_FACTOR, 100);
+  low.open(lowFile);
+  high.open(highFile);
+  const uint32_t capacity = static_cast<uint32_t>(
+      std::ifstream(lowFile, std::ios::binary | std::ios::ate).tellg() /
+      PAGE_SIZE);
+  std::map<int32_t, int32_t> filled;
+  for (int32_t key = 0; low.getPageCount() < capacity; key++) {
+    fillData(data, key);
+    low.writeData(key, data);
+    filled[key] = key;
+  }
+  ok = low.getPageCount() == capacity && low.getFreePageCount() == 0;
+  const uint32_t highInUse = high.getPageCount() - high.getFreePageCount();
+
+  struct rlimit saved;
+  getrlimit(RLIMIT_FSIZE, &saved);
+  struct rlimit capped = saved;
+  capped.rlim_cur = static_cast<rlim_t>(capacity) * PAGE_SIZE;
+  void (*oldHandler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+  setrlimit(RLIMIT_FSIZE, &capped);
+  ok = ok && low.splitAt(static_cast<int32_t>(filled.size() / 2), high) < 0;
+  setrlimit(RLIMIT_FSIZE, &saved);
+  std::signal(SIGXFSZ, oldHandler);
+
+  ok = ok && holds(low, filled) && high.getRecordCount() == 0 &&
+       low.getPageCount() - low.getFreePageCount() == capacity &&
+       high.getPageCount() - high.getFreePageCount() == highInUse;
+  // Nothing was left half done: the same split now goes through
+  ok = ok && low.splitAt(static_cast<int32_t>(filled.size() / 2), high) ==
+                 int64_t(filled.size() - filled.size() / 2);
+  low.close();
+  high.close();
+  ok = ok && fencesOk(lowFile) && fencesOk(highFile);
+  cleanup();
+  if (!ok) {
+    log.log("FAIL: Failed split leaves both files as they were");
+    return false;
+  }
+#endif
+
+  log.log("PASS: Split cuts an index into two consistent files");
+  return true;
+}
+
+// Overwrite bytes of a closed single-file index in place
+static void patchFile(const std::string &file, size_t offset, const void *src,
+                      size_t len) {
+  std::fstream f(file, std::ios::in | std::ios::out | std::ios::binary);
+  f.seekp(static_cast<std::streamoff>(offset));
+  f.write(static_cast<const char *>(src), static_cast<std::streamsize>(len));
+}
+
+static uint32_t readRootPageId(const std::string &file) {
+  std::ifstream f(file, std::ios::binary);
+  MetadataPage meta;
+  f.read(reinterpret_cast<char *>(&meta), sizeof(meta));
+  return meta.rootPageId;
+}
+
+bool testStartupValidation(Logger &log) {
+  log.log("--- Testing Startup Validation & Recovery ---");
+#ifdef _WIN32
+  log.log("SKIP: Crash simulation uses fork()");
+  return true;
+#else
+  const std::string file = "recover.idx";
+  std::remove(file.c_str());
+  const int count = 30000;
+  bool ok = true;
+
+  {
+    BPlusTree tree;
+    tree.open(file);
+    uint8_t data[DATA_SIZE];
+    for (int i = 0; i < count; i++) {
+      fillData(data, i);
+      tree.writeData(i, data);
+    }
+    tree.close();
+  }
+
+  {
+    BPlusTree tree;
+    tree.open(file);
+    if (tree.lastRecovery().performed) {
+      log.log("FAIL: Cleanly closed index went through recovery");
+      ok = false;
+    }
+    tree.close();
+  }
+
+  // Crash a writer after unsynced modifications, then wreck the root so
+  // only the leaf chain can be trusted
+  pid_t child = fork();
+  if (child == 0) {
+    BPlusTree tree;
+    tree.open(file);
+    uint8_t data[DATA_SIZE];
+    for (int i = count; i < count + 500; i++) {
+      fillData(data, i);
+      tree.writeData(i, data);
+    }
+    _exit(0); // No close(): cleanShutdown stays 0
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+
+  std::vector<uint8_t> garbage(PAGE_SIZE, 0xA5);
+  patchFile(file, static_cast<size_t>(readRootPageId(file)) * PAGE_SIZE,
+            garbage.data(), garbage.size());
+
+  {
+    BPlusTree tree;
+    if (!tree.open(file) || !tree.lastRecovery().performed) {
+      log.log("FAIL: Unclean index was not recovered");
+      ok = false;
+    } else {
+      for (int i = 0; i < count + 500 && ok; i++) {
+        const uint8_t *result = tree.readData(i);
+        if (!result || !verifyData(result, i)) {
+          log.log("FAIL: Key " + std::to_string(i) + " lost in recovery");
+          ok = false;
+        }
+      }
+      if (ok && tree.getRecordCount() != static_cast<uint32_t>(count + 500)) {
+        log.log("FAIL: Record count not rebuilt");
+        ok = false;
+      }
+      // The rebuilt tree must keep accepting splits
+      uint8_t data[DATA_SIZE];
+      for (int i = count + 500; i < count + 5000 && ok; i++) {
+        fillData(data, i);
+        ok = tree.writeData(i, data);
+      }
+      if (ok)
+        log.log("PASS: Recovered " +
+                std::to_string(tree.lastRecovery().records) + " records from " +
+                std::to_string(tree.lastRecovery().leaves) + " leaves");
+    }
+    tree.close();
+  }
+
+  // Mismatched tuple size must be refused, not misread
+  uint16_t badDataSize = DATA_SIZE + 1;
+  patchFile(file, offsetof(MetadataPage, dataSize), &badDataSize,
+            sizeof(badDataSize));
+  {
+    BPlusTree tree;
+    if (tree.open(file)) {
+      log.log("FAIL: Opened index with a different tuple size");
+      ok = false;
+    }
+  }
+
+  std::remove(file.c_str());
+  if (ok)
+    log.log("PASS: Header validation and clean-shutdown fast path");
+  return ok;
+#endif
+}
+
+bool testResidentBudget(Logger &log) {
+  log.log("--- Testing Resident Memory Budget ---");
+
+  const std::string file = "budget.idx";
+  std::remove(file.c_str());
+  const size_t budget = 4 * 1024 * 1024;
+  const int count = 80000; // ~8MB of leaves, twice the budget
+
+  BPlusTree tree;
+  tree.open(file);
+  tree.setResidentBudget(budget);
+
+  bool ok = true;
+  uint8_t data[DATA_SIZE];
+  for (int i = 0; i < count && ok; i++) {
+    fillData(data, i);
+    ok = tree.writeData(i, data);
+  }
+
+  // Eviction must never lose data
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<> dis(0, count - 1);
+  for (int r = 0; r < 5000 && ok; r++) {
+    int key = dis(gen);
+    const uint8_t *result = tree.readData(key);
+    if (!result || !verifyData(result, key)) {
+      log.log("FAIL: Key " + std::to_string(key) + " corrupted by eviction");
+      ok = false;
+    }
+  }
+
+  // sync() also drops the chunks evicted while dirty from the page cache
+  tree.trimToBudget();
+  tree.sync();
+  ResidentStats st = tree.residentStats();
+  if (ok && (st.evictedChunks == 0 || st.trackedBytes > st.budgetBytes)) {
+    log.log("FAIL: Budget not enforced (tracked " +
+            std::to_string(st.trackedBytes) + " bytes, " +
+            std::to_string(st.evictedChunks) + " evictions)");
+    ok = false;
+  }
+
+  tree.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Tracked " + std::to_string(st.trackedBytes >> 10) +
+            " KB of " + std::to_string(budget >> 10) + " KB budget (" +
+            std::to_string(st.residentBytes >> 10) + " KB resident, " +
+            std::to_string(st.evictedChunks) + " chunk evictions)");
+  return ok;
+}
+
+bool testRpcServer(Logger &log) {
+  log.log("--- Testing RPC Server ---");
+#ifndef __linux__
+  log.log("SKIP: The epoll server is Linux-only");
+  return true;
+#else
+  const std::string file = "rpc.idx";
+  const std::string sock = "rpc.sock";
+  std::remove(file.c_str());
+
+  BPlusTree tree;
+  tree.open(file);
+  RpcServer<BPlusTree> server(tree);
+  if (!server.listen(sock)) {
+    log.log("FAIL: Server could not listen on " + sock);
+    return false;
+  }
+  std::thread loop([&] { server.run(); });
+
+  bool ok = true;
+  RpcClient client;
+  ok = client.connect(sock);
+  uint8_t data[DATA_SIZE];
+  Frame f;
+
+  // 2000 pipelined PUTs (even keys), then 3000 pipelined GETs
+  const int count = 2000;
+  for (int i = 0; i < count; i++) {
+    fillData(data, i * 2);
+    encodePut(client.out(), i * 2, data);
+  }
+  ok = ok && client.flush();
+  for (int i = 0; i < count && ok; i++)
+    ok = client.readResponse(f) && f.code == uint8_t(Status::OK);
+  for (int k = 0; k < 3000; k++)
+    encodeGet(client.out(), k);
+  ok = ok && client.flush();
+  for (int k = 0; k < 3000 && ok; k++) {
+    ok = client.readResponse(f);
+    if (ok && k % 2 == 0)
+      ok = f.code == uint8_t(Status::OK) && verifyData(f.body, k);
+    else if (ok)
+      ok = f.code == uint8_t(Status::NOT_FOUND) && f.bodyLen == 0;
+  }
+  if (!ok)
+    log.log("FAIL: Pipelined PUT / GET");
+
+  // MPUT odd keys, MGET across both, RANGE, DEL
+  std::vector<int32_t> keys;
+  std::vector<uint8_t> values;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(i * 2 + 1);
+    fillData(data, i * 2 + 1);
+    values.insert(values.end(), data, data + DATA_SIZE);
+  }
+  encodeMultiPut(client.out(), keys.data(), values.data(), 100);
+  keys = {1, 2, 3, 100001, 4};
+  encodeMultiGet(client.out(), keys.data(), 5);
+  encodeRange(client.out(), 10, 29);
+  encodeDelete(client.out(), 10);
+  encodeDelete(client.out(), 10);
+  encodeGet(client.out(), 10);
+  bool multi = client.flush() && client.readResponse(f) &&
+               f.code == uint8_t(Status::OK) && readU32(f.body) == 100;
+  multi = multi && client.readResponse(f) && f.code == uint8_t(Status::OK) &&
+          readU32(f.body) == 5 &&
+          std::memcmp(f.body + 4, "\1\1\1\0\1", 5) == 0 &&
+          f.bodyLen == 4 + 5 + 4 * DATA_SIZE &&
+          verifyData(f.body + 9 + 3 * DATA_SIZE, 4);
+  multi = multi && client.readResponse(f) && f.code == uint8_t(Status::OK) &&
+          readU32(f.body) == 20 && verifyData(f.body + 4, 10);
+  multi = multi && client.readResponse(f) && f.code == uint8_t(Status::OK);
+  multi = multi && client.readResponse(f) &&
+          f.code == uint8_t(Status::NOT_FOUND);
+  multi = multi && client.readResponse(f) &&
+          f.code == uint8_t(Status::NOT_FOUND);
+  if (!multi) {
+    log.log("FAIL: MPUT / MGET / RANGE / DEL");
+    ok = false;
+  }
+
+  // A malformed frame closes only that connection
+  RpcClient bad;
+  uint8_t zero[FRAME_HEADER_SIZE] = {};
+  if (bad.connect(sock)) {
+    appendBytes(bad.out(), zero, sizeof(zero));
+    if (bad.flush() && bad.readResponse(f)) {
+      log.log("FAIL: Malformed frame was answered");
+      ok = false;
+    }
+  }
+  if (client.get(0, data) != Status::OK || !verifyData(data, 0)) {
+    log.log("FAIL: Good connection affected by a bad one");
+    ok = false;
+  }
+
+  client.close();
+  server.stop();
+  loop.join();
+  const ServerStats &st = server.statistics();
+  if (ok && st.batchedKeys < 5000 + 105) {
+    log.log("FAIL: Only " + std::to_string(st.batchedKeys) +
+            " keys went through batch calls");
+    ok = false;
+  }
+  if (ok)
+    log.log("Server: " + std::to_string(st.requests) + " requests, " +
+            std::to_string(st.batchedKeys) + " keys in " +
+            std::to_string(st.batches) + " batch calls");
+  server.close();
+  tree.close();
+  std::remove(file.c_str());
+
+  if (ok)
+    log.log("PASS: Pipelined requests over the Unix socket server");
+  return ok;
+#endif
+}
+
+bool testShardedServer(Logger &log) {
+  log.log("--- Testing Sharded Server ---");
+#ifndef __linux__
+  log.log("SKIP: The sharded server is Linux-only");
+  return true;
+#else
+  const std::string base = "shard.idx", sockBase = "shard.sock";
+  ShardMap map;
+  map.lo = 0;
+  map.hi = 39999;
+  map.shards = 4;
+  for (uint32_t i = 0; i < map.shards; i++)
+    std::remove((base + "." + std::to_string(i)).c_str());
+
+  bool ok = true;
+  {
+    ShardedServer<BPlusTree> server(map);
+    if (!server.open(base, sockBase)) {
+      log.log("FAIL: Could not open shards");
+      return false;
+    }
+    server.start(false);
+
+    // Everything goes through shard 0, which forwards by key
+    RpcClient client;
+    ok = client.connect(ShardMap::socketFor(sockBase, 0));
+    uint8_t data[DATA_SIZE];
+    Frame f;
+    for (int k = 0; k < 40000; k += 10) {
+      fillData(data, k);
+      encodePut(client.out(), k, data);
+    }
+    ok = ok && client.flush();
+    for (int k = 0; k < 40000 && ok; k += 10)
+      ok = client.readResponse(f) && f.code == uint8_t(Status::OK);
+    for (int k = 0; k < 40000; k += 5)
+      encodeGet(client.out(), k);
+    ok = ok && client.flush();
+    for (int k = 0; k < 40000 && ok; k += 5) {
+      ok = client.readResponse(f);
+      if (ok && k % 10 == 0)
+        ok = f.code == uint8_t(Status::OK) && verifyData(f.body, k);
+      else if (ok)
+        ok = f.code == uint8_t(Status::NOT_FOUND);
+    }
+    if (!ok)
+      log.log("FAIL: Pipelined PUT / GET across shards");
+
+    // Multi-key and range requests spanning shard boundaries
+    std::vector<int32_t> keys = {39990, 5, 10000, 19990, 20000, 0};
+    encodeMultiGet(client.out(), keys.data(), 6);
+    encodeRange(client.out(), 9950, 30049);
+    encodeDelete(client.out(), 20000);
+    encodeGet(client.out(), 20000);
+    bool multi = client.flush() && client.readResponse(f) &&
+                 f.code == uint8_t(Status::OK) && readU32(f.body) == 6 &&
+                 std::memcmp(f.body + 4, "\1\0\1\1\1\1", 6) == 0 &&
+                 verifyData(f.body + 10, 39990) &&
+                 verifyData(f.body + 10 + 4 * DATA_SIZE, 0);
+    bool sorted = multi && client.readResponse(f) &&
+                  f.code == uint8_t(Status::OK) && readU32(f.body) == 2010;
+    for (uint32_t i = 0; sorted && i < 2010; i++)
+      sorted = verifyData(f.body + 4 + i * DATA_SIZE, 9950 + int(i) * 10);
+    multi = sorted && client.readResponse(f) &&
+            f.code == uint8_t(Status::OK) && client.readResponse(f) &&
+            f.code == uint8_t(Status::NOT_FOUND);
+    if (!multi) {
+      log.log("FAIL: MGET / RANGE / DEL across shards");
+      ok = false;
+    }
+
+    // A client routing by key reaches the owner directly
+    RpcClient direct;
+    if (!direct.connect(ShardMap::socketFor(sockBase, map.shardOf(30000))) ||
+        direct.get(30000, data) != Status::OK || !verifyData(data, 30000)) {
+      log.log("FAIL: Direct request to the owning shard");
+      ok = false;
+    }
+
+    client.close();
+    direct.close();
+    server.stop();
+    server.wait();
+
+    for (uint32_t i = 0; i < map.shards && ok; i++) {
+      uint32_t expect = i == 2 ? 999 : 1000; // Key 20000 was deleted
+      if (server.tree(i).getRecordCount() != expect) {
+        log.log("FAIL: Shard " + std::to_string(i) + " holds " +
+                std::to_string(server.tree(i).getRecordCount()) + " records");
+        ok = false;
+      }
+    }
+    ShardStats st = server.totals();
+    if (ok && st.forwarded == 0) {
+      log.log("FAIL: Nothing was forwarded between shards");
+      ok = false;
+    }
+    if (ok)
+      log.log("Shards: " + std::to_string(st.requests) + " requests, " +
+              std::to_string(st.forwarded) + " forwarded messages");
+    server.close();
+  }
+
+  // The files remember the layout: the same one reopens, any other count
+  // or key range is refused
+  if (ok) {
+    ShardedServer<BPlusTree> same(map);
+    ok = same.open(base, sockBase) && same.tree(2).getRecordCount() == 999;
+    same.close();
+    ShardMap fewer = map, more = map, wider = map;
+    fewer.shards = 2;
+    more.shards = 8;
+    wider.hi = 79999;
+    for (const ShardMap &m : {fewer, more, wider}) {
+      ShardedServer<BPlusTree> other(m);
+      ok = ok && !other.open(base, sockBase);
+    }
+    if (!ok)
+      log.log("FAIL: Shard files reopened with another shard layout");
+  }
+  for (uint32_t i = 0; i < 8; i++)
+    std::remove((base + "." + std::to_string(i)).c_str());
+
+  if (ok)
+    log.log("PASS: Key-range shards answer and forward in order");
+  return ok;
+#endif
+}
+
+void runBenchmark(BPlusTree &tree, Logger &log) {
+  log.log("=== PERFORMANCE BENCHMARK ===");
+
+  const int SIZES[] = {1000, 10000, 100000};
+
+  for (int size : SIZES) {
+    log.log("\n--- Benchmark: " + std::to_string(size) + " records ---");
+
+    tree.close();
+    std::remove("benchmark.idx");
+    tree.open("benchmark.idx");
+
+    uint8_t data[DATA_SIZE];
+
     // Insert benchmark
     auto start = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < size; i++) {
@@ -308,6 +3064,406 @@ void runBenchmark(BPlusTree &tree, Logger &log) {
   }
 }
 
+// Page usage and ingest speed of each split policy, plus bulk loading
+void runSplitPolicyBenchmark(Logger &log) {
+  log.log("\n--- Benchmark: split policies (100000 records) ---");
+
+  struct Config {
+    const char *name;
+    SplitPolicy policy;
+    uint32_t pct;
+  };
+  const Config configs[] = {{"midpoint", SplitPolicy::MIDPOINT, 50},
+                            {"append-aware", SplitPolicy::APPEND_AWARE, 50},
+                            {"fill-70%", SplitPolicy::FILL_FACTOR, 70},
+                            {"adaptive-70%", SplitPolicy::ADAPTIVE, 70}};
+  const int size = 100000;
+
+  std::vector<int32_t> sequential(size);
+  for (int i = 0; i < size; i++)
+    sequential[i] = i;
+  std::vector<int32_t> shuffled = sequential;
+  std::mt19937 gen(1);
+  std::shuffle(shuffled.begin(), shuffled.end(), gen);
+
+  uint8_t data[DATA_SIZE];
+  for (const Config &c : configs) {
+    for (int pass = 0; pass < 2; pass++) {
+      const std::vector<int32_t> &keys = pass == 0 ? sequential : shuffled;
+      std::remove("benchmark.idx");
+      BPlusTree tree;
+      tree.open("benchmark.idx");
+      tree.setSplitPolicy(c.policy, c.pct);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int32_t k : keys) {
+        fillData(data, k);
+        tree.writeData(k, data);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                      start)
+                    .count();
+      double ops = (size * 1000000.0) / std::max(1LL, static_cast<long long>(us));
+
+      log.log(std::string(c.name) + (pass == 0 ? " sequential: " : " random:     ") +
+              std::to_string(tree.getPageCount()) + " pages, " +
+              formatOps(ops) + " ops/sec");
+      tree.close();
+    }
+  }
+
+  std::vector<uint8_t> values(static_cast<size_t>(size) * DATA_SIZE);
+  for (int i = 0; i < size; i++)
+    fillData(&values[static_cast<size_t>(i) * DATA_SIZE], i);
+  for (uint32_t pct : {100u, 70u}) {
+    std::remove("benchmark.idx");
+    BPlusTree tree;
+    tree.open("benchmark.idx");
+    auto start = std::chrono::high_resolution_clock::now();
+    tree.bulkLoad(sequential.data(), values.data(), size, pct);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto us =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count();
+    double ops = (size * 1000000.0) / std::max(1LL, static_cast<long long>(us));
+    log.log("bulk-load " + std::to_string(pct) +
+            "%:    " + std::to_string(tree.getPageCount()) + " pages, " +
+            formatOps(ops) + " ops/sec");
+    tree.close();
+  }
+  std::remove("benchmark.idx");
+}
+
+void runLeafFormatBenchmark(Logger &log) {
+  log.log("\n--- Benchmark: leaf formats, random keys (100000 records) ---");
+
+  struct Config {
+    const char *name;
+    uint32_t tailSlots;
+    bool slotted;
+  };
+  const Config configs[] = {{"sorted      ", 0, false},
+                            {"tail-8      ", 8, false},
+                            {"tail-16     ", 16, false},
+                            {"slotted     ", 0, true},
+                            {"slotted+t8  ", 8, true}};
+  const int size = 100000;
+
+  std::vector<int32_t> keys(size);
+  for (int i = 0; i < size; i++)
+    keys[i] = i;
+  std::mt19937 gen(3);
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  uint8_t data[DATA_SIZE];
+  for (const Config &c : configs) {
+    std::remove("benchmark.idx");
+    BPlusTree tree;
+    tree.open("benchmark.idx");
+    tree.setUnsortedTail(c.tailSlots);
+    tree.setSlottedValues(c.slotted);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int32_t k : keys) {
+      fillData(data, k);
+      tree.writeData(k, data);
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    uint32_t found = 0;
+    for (int32_t k : keys)
+      found += tree.readData(k) != nullptr;
+    auto end = std::chrono::high_resolution_clock::now();
+
+    auto insertUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(mid - start)
+            .count();
+    auto readUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - mid)
+            .count();
+    double insertOps =
+        (size * 1000000.0) / std::max(1LL, static_cast<long long>(insertUs));
+    double readOps =
+        (found * 1000000.0) / std::max(1LL, static_cast<long long>(readUs));
+    log.log(std::string(c.name) + "insert " + formatOps(insertOps) +
+            " ops/sec, read " + formatOps(readOps) + " ops/sec, " +
+            std::to_string(tree.getPageCount()) + " pages");
+    tree.close();
+  }
+  std::remove("benchmark.idx");
+}
+
+void runDescentBenchmark(Logger &log) {
+  const int size = 1000000;
+  log.log("\n--- Benchmark: point lookups, out-of-cache tree (" +
+          std::to_string(size) + " records) ---");
+
+  std::remove("benchmark.idx");
+  BPlusTree tree;
+  tree.open("benchmark.idx");
+  {
+    uint8_t data[DATA_SIZE];
+    BPlusTree::BulkLoader loader(tree, 100);
+    for (int i = 0; i < size; i++) {
+      fillData(data, i * 2);
+      loader.append(i * 2, data);
+    }
+    loader.finish();
+  }
+
+  const size_t lookups = 2000000;
+  std::vector<int32_t> keys(lookups);
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int32_t> dist(0, size - 1);
+  for (int32_t &k : keys)
+    k = dist(gen) * 2;
+  std::vector<const uint8_t *> out(lookups);
+
+  // Touch the value so lookups cannot be optimised into descents alone
+  auto sum = [&](const uint8_t *v) { return v ? v[DATA_SIZE - 1] : 0; };
+  uint64_t check = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < lookups; i++)
+    check += sum(tree.readData(keys[i]));
+  auto mid = std::chrono::high_resolution_clock::now();
+  tree.readBatch(keys.data(), lookups, out.data());
+  for (size_t i = 0; i < lookups; i++)
+    check -= sum(out[i]);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  auto singleNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count();
+  auto batchNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count();
+  log.log("file " + std::to_string(tree.getPageCount() * PAGE_SIZE >> 20) +
+          " MB, " + std::to_string(lookups) + " random lookups" +
+          (check ? " (MISMATCH)" : ""));
+  log.log("readData:  " + std::to_string(singleNs / lookups) + " ns/lookup");
+  log.log("readBatch: " + std::to_string(batchNs / lookups) + " ns/lookup");
+  tree.close();
+  std::remove("benchmark.idx");
+}
+
+// Same workload on each policy combination; Tree is the variant under test
+template <typename Tree> void benchVariant(const char *name, Logger &log) {
+  const int size = 500000;
+  std::remove("benchmark.idx");
+  Tree tree;
+  tree.open("benchmark.idx");
+
+  std::vector<int32_t> keys(size);
+  for (int i = 0; i < size; i++)
+    keys[i] = i * 2;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(5));
+
+  uint8_t data[DATA_SIZE];
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int32_t k : keys) {
+    fillData(data, k);
+    tree.writeData(k, data);
+  }
+  auto mid = std::chrono::high_resolution_clock::now();
+  size_t found = 0;
+  for (int round = 0; round < 4; round++) {
+    for (int32_t k : keys)
+      found += tree.readData(k) != nullptr;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  auto insertNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count();
+  auto readNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count();
+  std::ostringstream line;
+  line << std::left << std::setw(28) << name << " insert "
+       << insertNs / size << " ns, read " << readNs / (4 * size)
+       << " ns, pages " << tree.getPageCount()
+       << (found == keys.size() * 4 ? "" : " (MISSING)");
+  log.log(line.str());
+  tree.close();
+  std::remove("benchmark.idx");
+}
+
+void runExternalSortBenchmark(Logger &log) {
+  const int n = 2000000;
+  log.log("\n--- Benchmark: loading " + std::to_string(n) +
+          " unsorted records ---");
+  std::mt19937 gen(42);
+  std::vector<int32_t> keys(n);
+  for (int i = 0; i < n; i++)
+    keys[i] = static_cast<int32_t>(gen());
+  uint8_t data[DATA_SIZE];
+  fillData(data, 7);
+
+  std::remove("benchmark.idx");
+  BPlusTree tree;
+  tree.open("benchmark.idx");
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int32_t k : keys)
+    tree.writeData(k, data);
+  auto end = std::chrono::high_resolution_clock::now();
+  double insertMs = std::chrono::duration<double, std::milli>(end - start).count();
+  tree.close();
+  std::remove("benchmark.idx");
+
+  tree.open("benchmark.idx");
+  start = std::chrono::high_resolution_clock::now();
+  ExternalSorter sorter(64 << 20);
+  for (int32_t k : keys)
+    sorter.add(k, data);
+  bool ok = bulkLoadUnsorted(tree, sorter);
+  end = std::chrono::high_resolution_clock::now();
+  double sortMs = std::chrono::duration<double, std::milli>(end - start).count();
+  const ExternalSorter::Stats &st = sorter.statistics();
+  tree.close();
+  std::remove("benchmark.idx");
+
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1) << "Random inserts: " << insertMs
+      << " ms; external sort + bulk load (64 MB): " << sortMs << " ms ("
+      << st.runs << " runs, run generation " << st.runSeconds * 1000
+      << " ms, merge " << st.mergeSeconds * 1000 << " ms)"
+      << (ok ? "" : " FAILED");
+  log.log(msg.str());
+}
+
+void runParallelBulkLoadBenchmark(Logger &log) {
+  const int n = 4000000;
+  log.log("\n--- Benchmark: bulk loading " + std::to_string(n) +
+          " sorted records ---");
+  std::vector<int32_t> keys(n);
+  std::vector<uint8_t> values(static_cast<size_t>(n) * DATA_SIZE);
+  for (int i = 0; i < n; i++) {
+    keys[i] = i * 2;
+    fillData(&values[static_cast<size_t>(i) * DATA_SIZE], keys[i]);
+  }
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1);
+  for (unsigned threads : {0u, 1u, std::max(1u, std::thread::hardware_concurrency())}) {
+    std::remove("benchmark.idx");
+    BPlusTree tree;
+    tree.open("benchmark.idx");
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ok = threads == 0
+                  ? tree.bulkLoad(keys.data(), values.data(), n)
+                  : tree.bulkLoadParallel(keys.data(), values.data(), n, 100,
+                                          threads);
+    auto end = std::chrono::high_resolution_clock::now();
+    tree.close();
+    msg << (threads == 0 ? "bulkLoad: "
+                         : "; parallel, " + std::to_string(threads) +
+                               " threads: ")
+        << std::chrono::duration<double, std::milli>(end - start).count()
+        << " ms" << (ok ? "" : " FAILED");
+  }
+  std::remove("benchmark.idx");
+  log.log(msg.str());
+}
+
+void runMergeBenchmark(Logger &log) {
+  const int live = 1000000, part = 250000;
+  log.log("\n--- Benchmark: merging a " + std::to_string(part) +
+          "-record partition into " + std::to_string(live) + " records ---");
+  std::vector<int32_t> keys(live);
+  std::vector<uint8_t> values(static_cast<size_t>(live) * DATA_SIZE);
+  for (int i = 0; i < live; i++) {
+    keys[i] = i * 4;
+    fillData(&values[static_cast<size_t>(i) * DATA_SIZE], keys[i]);
+  }
+  uint8_t data[DATA_SIZE];
+  fillData(data, 1);
+
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1);
+  // Partition keys after the live range, interleaved with it, and the
+  // same interleaved records reinserted one by one
+  for (int mode = 0; mode < 3; mode++) {
+    std::remove("benchmark.idx");
+    std::remove("benchmark_part.idx");
+    BPlusTree tree, partition;
+    tree.open("benchmark.idx");
+    tree.bulkLoad(keys.data(), values.data(), live);
+    partition.open("benchmark_part.idx");
+    BPlusTree::BulkLoader loader(partition);
+    for (int i = 0; i < part; i++)
+      loader.append(mode == 0 ? live * 4 + i : i * 16 + 1, data);
+    loader.finish();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (mode < 2) {
+      tree.merge(partition);
+    } else {
+      for (int i = 0; i < part; i++)
+        tree.writeData(i * 16 + 1, data);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    static const char *names[] = {"splice (disjoint): ",
+                                  "; merge join (overlapping): ",
+                                  "; writeData reinsert: "};
+    msg << names[mode]
+        << std::chrono::duration<double, std::milli>(end - start).count()
+        << " ms";
+  }
+  std::remove("benchmark.idx");
+  std::remove("benchmark_part.idx");
+  log.log(msg.str());
+}
+
+void runSplitBenchmark(Logger &log) {
+  const int n = 1000000;
+  log.log("\n--- Benchmark: splitting " + std::to_string(n) +
+          " records in half ---");
+  std::vector<int32_t> keys(n);
+  std::vector<uint8_t> values(static_cast<size_t>(n) * DATA_SIZE);
+  for (int i = 0; i < n; i++) {
+    keys[i] = i;
+    fillData(&values[static_cast<size_t>(i) * DATA_SIZE], keys[i]);
+  }
+  std::ostringstream msg;
+  msg << std::fixed << std::setprecision(1);
+  for (int mode = 0; mode < 2; mode++) {
+    std::remove("benchmark.idx");
+    std::remove("benchmark_part.idx");
+    BPlusTree tree, upper;
+    tree.open("benchmark.idx");
+    tree.bulkLoad(keys.data(), values.data(), n);
+    upper.open("benchmark_part.idx");
+    auto start = std::chrono::high_resolution_clock::now();
+    if (mode == 0) {
+      tree.splitAt(n / 2, upper);
+    } else {
+      for (int i = n / 2; i < n; i++) {
+        upper.writeData(i, tree.readData(i));
+        tree.deleteData(i);
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    msg << (mode == 0 ? "splitAt: " : "; reinsert and delete: ")
+        << std::chrono::duration<double, std::milli>(end - start).count()
+        << " ms";
+  }
+  std::remove("benchmark.idx");
+  std::remove("benchmark_part.idx");
+  log.log(msg.str());
+}
+
+void runPolicyBenchmark(Logger &log) {
+  log.log("\n--- Benchmark: policy variants (500000 random records) ---");
+  benchVariant<BPlusTree>("default", log);
+  benchVariant<BasicBPlusTree<SimdSearch>>("SimdSearch", log);
+  benchVariant<BasicBPlusTree<ScalarSearch>>("ScalarSearch", log);
+  benchVariant<BasicBPlusTree<DefaultSearch, HugePageStorage>>(
+      "HugePageStorage", log);
+  benchVariant<BasicBPlusTree<DefaultSearch, MlockStorage>>("MlockStorage",
+                                                            log);
+  benchVariant<BasicBPlusTree<DefaultSearch, MmapStorage, SharedMutexLocking>>(
+      "SharedMutexLocking", log);
+  benchVariant<BasicBPlusTree<DefaultSearch, MmapStorage, NoLocking,
+                              FixedSplit<SplitPolicy::FILL_FACTOR, 70>>>(
+      "FixedSplit<FILL_FACTOR, 70>", log);
+}
+
 int main(int argc, char *argv[]) {
   Logger log("logs/bptree_test.log");
   log.log("B+ Tree Index - Driver Program");
@@ -321,6 +3477,14 @@ int main(int argc, char *argv[]) {
     tree.open("benchmark.idx");
     runBenchmark(tree, log);
     tree.close();
+    runSplitPolicyBenchmark(log);
+    runLeafFormatBenchmark(log);
+    runDescentBenchmark(log);
+    runPolicyBenchmark(log);
+    runExternalSortBenchmark(log);
+    runParallelBulkLoadBenchmark(log);
+    runMergeBenchmark(log);
+    runSplitBenchmark(log);
     std::remove("benchmark.idx");
     return 0;
   }
@@ -343,9 +3507,36 @@ int main(int argc, char *argv[]) {
   allPassed &= testBulkInsert(tree, log, 10000);
   allPassed &= testRandomReads(tree, log, 1000, 10000);
   allPassed &= testRangeQuery(tree, log, 100, 500);
+  allPassed &= testRandomInsert(log, 200000);
+  allPassed &= testSplitPolicies(log);
+  allPassed &= testLazyDelete(log);
+  allPassed &= testUnsortedTail(log);
+  allPassed &= testSlottedValues(log);
+  allPassed &= testFenceKeys(log);
+  allPassed &= testSeparators(log);
+  allPassed &= testReadBatch(log);
+  allPassed &= testTtl(log);
+  allPassed &= testExportImport(log);
+  allPassed &= testExternalSort(log);
+  allPassed &= testParallelBulkLoad(log);
+  allPassed &= testApplySorted(log);
+  allPassed &= testMerge(log);
+  allPassed &= testSplitAt(log);
+  allPassed &= testPolicyVariants(log);
 
   tree.close();
   allPassed &= testPersistence(log, indexFile);
+  allPassed &= testStriping(log);
+  allPassed &= testReadOnlyMode(log);
+  allPassed &= testSharedReaders(log);
+  allPassed &= testDeadWriter(log);
+  allPassed &= testChangeStream(log);
+  allPassed &= testReplica(log);
+  allPassed &= testReplicaTtl(log);
+  allPassed &= testStartupValidation(log);
+  allPassed &= testResidentBudget(log);
+  allPassed &= testRpcServer(log);
+  allPassed &= testShardedServer(log);
 
   log.log("\n=== TEST SUMMARY ===");
   if (allPassed) {
@@ -0,0 +1,415 @@
+#ifndef EXTERNAL_SORT_HPP
+#define EXTERNAL_SORT_HPP
+
+#include "interchange.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define BPTREE_GETPID _getpid
+#else
+#include <unistd.h>
+#define BPTREE_GETPID getpid
+#endif
+
+// =============================================================================
+// EXTERNAL MERGE SORT for bulk loading unsorted input
+// =============================================================================
+//
+// add() fills a memory-bounded buffer; a full buffer is handed to a worker
+// thread that sorts it and writes it as a sorted run (interchange format,
+// so runs are compressed and read back sequentially) while the caller keeps
+// filling the next one. finish() merges the runs with a loser tree and
+// hands the records to a sink in strictly ascending key order, ready for
+// BulkLoader::append. Input that fits in one buffer never touches disk.
+//
+// Duplicate keys keep the value added last: within a buffer the sort is
+// stable and only the last copy is written, and across runs the tie goes
+// to the later run. More runs than the merge can hold open at once are
+// first merged in consecutive groups, which preserves that order.
+
+class ExternalSorter {
+public:
+  struct Stats {
+    uint64_t records = 0;    // Records added
+    uint64_t duplicates = 0; // Dropped in favour of a later value
+    uint32_t runs = 0;       // Sorted runs written by run generation
+    uint32_t mergePasses = 0;
+    double runSeconds = 0;   // add() and run generation
+    double mergeSeconds = 0;
+  };
+
+  static constexpr size_t RECORD_BYTES = sizeof(int32_t) + DATA_SIZE;
+  // Rough memory held per open run during the merge: stdio buffer plus
+  // one decoded block
+  static constexpr size_t MERGE_BYTES_PER_RUN =
+      (1u << 20) + size_t(EXPORT_BLOCK_RECORDS) * (2 * DATA_SIZE + 8);
+
+private:
+  struct Buffer {
+    std::vector<int32_t> keys;
+    std::vector<uint8_t> values;
+    std::vector<uint64_t> order;
+  };
+
+  struct Job {
+    Buffer *buffer;
+    uint32_t run;
+  };
+
+  size_t bufferRecords;
+  size_t fanIn;
+  std::string tempDir;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  Buffer *current = nullptr;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable jobReady;
+  std::condition_variable bufferFree;
+  std::deque<Job> jobs;
+  std::vector<Buffer *> freeBuffers;
+  bool stopping = false;
+  std::atomic<bool> failed{false};
+
+  std::vector<std::string> runs; // In input order
+  uint32_t nextTemp = 0;
+  Stats stats;
+  std::chrono::steady_clock::time_point started;
+  bool finished = false;
+
+public:
+  // memoryBytes bounds the record buffers (threads + 1 of them); the merge
+  // opens up to memoryBytes / MERGE_BYTES_PER_RUN runs at a time.
+  explicit ExternalSorter(size_t memoryBytes = size_t(256) << 20,
+                          unsigned threads = std::thread::hardware_concurrency(),
+                          const std::string &dir = ".")
+      : tempDir(dir.empty() ? "." : dir) {
+    threads = std::max(1u, threads);
+    bufferRecords = std::max<size_t>(
+        memoryBytes / (threads + 1) / (RECORD_BYTES + sizeof(uint64_t)), 1024);
+    fanIn = std::max<size_t>(memoryBytes / MERGE_BYTES_PER_RUN, 2);
+    for (unsigned i = 0; i <= threads; i++) {
+      buffers.emplace_back(new Buffer());
+      freeBuffers.push_back(buffers.back().get());
+    }
+    for (unsigned i = 0; i < threads; i++)
+      workers.emplace_back([this] { work(); });
+    started = std::chrono::steady_clock::now();
+  }
+
+  ~ExternalSorter() {
+    stopWorkers();
+    removeRuns();
+  }
+
+  ExternalSorter(const ExternalSorter &) = delete;
+  ExternalSorter &operator=(const ExternalSorter &) = delete;
+
+  bool add(int32_t key, const uint8_t *value) {
+    if (finished || failed.load(std::memory_order_relaxed))
+      return false;
+    if (!current && !(current = takeBuffer()))
+      return false;
+    current->keys.push_back(key);
+    current->values.insert(current->values.end(), value, value + DATA_SIZE);
+    stats.records++;
+    if (current->keys.size() >= bufferRecords)
+      submit();
+    return true;
+  }
+
+  // Emit every record, ascending and unique by key, to sink(key, value),
+  // which returns false to abort. One-shot.
+  template <typename Sink> bool finish(Sink &&sink) {
+    if (finished)
+      return false;
+    finished = true;
+
+    // Everything fit in memory: sort in place, no runs
+    if (runs.empty() && !failed.load()) {
+      stopWorkers();
+      stats.runSeconds = secondsSince(started);
+      auto t0 = std::chrono::steady_clock::now();
+      bool ok = true;
+      if (current) {
+        stats.duplicates += sortBuffer(*current);
+        for (size_t i = 0; ok && i < current->order.size(); i++) {
+          const uint32_t pos = static_cast<uint32_t>(current->order[i]);
+          ok = sink(current->keys[pos],
+                    current->values.data() + size_t(pos) * DATA_SIZE);
+        }
+      }
+      stats.mergeSeconds = secondsSince(t0);
+      return ok;
+    }
+
+    if (current && !current->keys.empty())
+      submit();
+    stopWorkers();
+    stats.runSeconds = secondsSince(started);
+    stats.runs = static_cast<uint32_t>(runs.size());
+    buffers.clear(); // The merge needs the memory
+    if (failed.load())
+      return false;
+
+    auto t0 = std::chrono::steady_clock::now();
+    while (runs.size() > fanIn) {
+      std::vector<std::string> merged;
+      // On failure the files still on disk are this pass's outputs so far
+      // (the failed one included) and the unmerged inputs from i on; keep
+      // them in runs so that removeRuns() deletes them
+      auto abandon = [&](size_t i) {
+        merged.insert(merged.end(), runs.begin() + i, runs.end());
+        runs.swap(merged);
+        return false;
+      };
+      for (size_t i = 0; i < runs.size(); i += fanIn) {
+        const size_t end = std::min(runs.size(), i + fanIn);
+        if (end - i == 1) {
+          merged.push_back(runs[i]);
+          continue;
+        }
+        ExportWriter writer;
+        std::string path = tempPath();
+        merged.push_back(path);
+        if (!writer.open(path))
+          return abandon(i);
+        bool ok = mergeRuns(i, end, [&](int32_t k, const uint8_t *v) {
+          return writer.add(k, v);
+        });
+        if (!ok || !writer.finish())
+          return abandon(i); // writer closes the partial file
+        for (size_t r = i; r < end; r++)
+          std::remove(runs[r].c_str());
+      }
+      runs.swap(merged);
+      stats.mergePasses++;
+    }
+    bool ok = mergeRuns(0, runs.size(), sink);
+    stats.mergePasses++;
+    stats.mergeSeconds = secondsSince(t0);
+    removeRuns();
+    return ok;
+  }
+
+  const Stats &statistics() const { return stats; }
+
+private:
+  static double secondsSince(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t)
+        .count();
+  }
+
+  std::string tempPath() {
+    return tempDir + "/bptree-sort-" + std::to_string(BPTREE_GETPID()) + "-" +
+           std::to_string(reinterpret_cast<uintptr_t>(this) & 0xFFFFFF) + "-" +
+           std::to_string(nextTemp++) + ".run";
+  }
+
+  Buffer *takeBuffer() {
+    std::unique_lock<std::mutex> lock(mutex);
+    bufferFree.wait(lock, [this] { return !freeBuffers.empty() || failed; });
+    if (failed)
+      return nullptr;
+    Buffer *b = freeBuffers.back();
+    freeBuffers.pop_back();
+    b->keys.clear();
+    b->values.clear();
+    b->keys.reserve(bufferRecords);
+    b->values.reserve(bufferRecords * DATA_SIZE);
+    return b;
+  }
+
+  void submit() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back({current, static_cast<uint32_t>(runs.size())});
+      runs.push_back(tempPath());
+    }
+    jobReady.notify_one();
+    current = nullptr;
+  }
+
+  void stopWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread &t : workers)
+      t.join();
+    workers.clear();
+  }
+
+  void removeRuns() {
+    for (const std::string &r : runs)
+      std::remove(r.c_str());
+    runs.clear();
+  }
+
+  void work() {
+    while (true) {
+      Job job;
+      std::string path;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+          return;
+        job = jobs.front();
+        jobs.pop_front();
+        path = runs[job.run];
+      }
+      const uint64_t dups = sortBuffer(*job.buffer);
+      if (!writeRun(*job.buffer, path))
+        failed = true;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.duplicates += dups;
+        freeBuffers.push_back(job.buffer);
+      }
+      bufferFree.notify_one();
+    }
+  }
+
+  // order = positions in ascending key order, keeping the last position of
+  // each key. Keys are biased to unsigned and packed above the position,
+  // so one integer sort is both by key and stable. Returns dropped copies.
+  static uint64_t sortBuffer(Buffer &b) {
+    const size_t n = b.keys.size();
+    b.order.resize(n);
+    for (size_t i = 0; i < n; i++)
+      b.order[i] = (uint64_t(static_cast<uint32_t>(b.keys[i]) ^ 0x80000000u)
+                    << 32) |
+                   i;
+    std::sort(b.order.begin(), b.order.end());
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (i + 1 < n && (b.order[i] >> 32) == (b.order[i + 1] >> 32))
+        continue; // A later copy follows
+      b.order[out++] = b.order[i];
+    }
+    b.order.resize(out);
+    return n - out;
+  }
+
+  static bool writeRun(const Buffer &b, const std::string &path) {
+    ExportWriter writer;
+    if (!writer.open(path))
+      return false;
+    for (uint64_t o : b.order) {
+      const uint32_t pos = static_cast<uint32_t>(o);
+      if (!writer.add(b.keys[pos], b.values.data() + size_t(pos) * DATA_SIZE))
+        return false;
+    }
+    return writer.finish();
+  }
+
+  // One run being merged, positioned on its current record
+  struct Cursor {
+    ImportReader reader;
+    size_t count = 0;
+    size_t pos = 0;
+    bool done = false;
+
+    bool advance() {
+      if (++pos < count)
+        return true;
+      pos = 0;
+      if (!reader.next(count))
+        return false;
+      done = count == 0;
+      return true;
+    }
+    int32_t key() const { return reader.keys()[pos]; }
+    const uint8_t *value() const { return reader.values() + pos * DATA_SIZE; }
+  };
+
+  // K-way merge of runs [first, last) through a loser tree: tree[0] holds
+  // the winner, tree[1..k) the loser of each internal match, so replacing
+  // the winner replays only the log2(k) matches on its path. Ties go to
+  // the later run, whose value is the newer one, and the earlier copies
+  // are dropped.
+  template <typename Sink>
+  bool mergeRuns(size_t first, size_t last, Sink &&sink) {
+    const size_t k = last - first;
+    std::vector<Cursor> in(k);
+    for (size_t i = 0; i < k; i++) {
+      Cursor &c = in[i];
+      if (!c.reader.open(runs[first + i]) || !c.reader.next(c.count))
+        return false;
+      c.done = c.count == 0;
+    }
+
+    // a beats b: smaller key, or same key from a later run; finished runs
+    // lose to everything
+    auto beats = [&](size_t a, size_t b) {
+      if (in[a].done || in[b].done)
+        return !in[a].done;
+      const int32_t ka = in[a].key(), kb = in[b].key();
+      return ka < kb || (ka == kb && a > b);
+    };
+
+    std::vector<size_t> tree(k, k); // k = empty slot during the build
+    for (size_t i = 0; i < k; i++) {
+      size_t winner = i;
+      for (size_t node = (i + k) / 2; node > 0; node /= 2) {
+        if (tree[node] == k) {
+          tree[node] = winner;
+          winner = k;
+          break;
+        }
+        if (beats(tree[node], winner))
+          std::swap(tree[node], winner);
+      }
+      if (winner != k)
+        tree[0] = winner;
+    }
+
+    bool havePrev = false;
+    int32_t prev = 0;
+    while (!in[tree[0]].done) {
+      size_t w = tree[0];
+      const int32_t key = in[w].key();
+      if (!havePrev || key != prev) {
+        if (!sink(key, in[w].value()))
+          return false;
+        prev = key;
+        havePrev = true;
+      } else {
+        stats.duplicates++;
+      }
+      if (!in[w].advance())
+        return false;
+      for (size_t node = (w + k) / 2; node > 0; node /= 2) {
+        if (beats(tree[node], w))
+          std::swap(tree[node], w);
+      }
+      tree[0] = w;
+    }
+    return true;
+  }
+};
+
+// Sort unsorted input with `sorter` straight into an empty tree
+template <typename Tree>
+bool bulkLoadUnsorted(Tree &tree, ExternalSorter &sorter,
+                      uint32_t fillPercent = 100) {
+  typename Tree::BulkLoader loader(tree, fillPercent);
+  return sorter.finish([&](int32_t key, const uint8_t *value) {
+    return loader.append(key, value);
+  }) && (loader.appended() == 0 || loader.finish());
+}
+
+#endif // EXTERNAL_SORT_HPP
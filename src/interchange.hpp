@@ -0,0 +1,400 @@
+#ifndef INTERCHANGE_HPP
+#define INTERCHANGE_HPP
+
+#include "page.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// SORTED-RUN INTERCHANGE FORMAT (exportTo / importFrom)
+// =============================================================================
+//
+// A file is a header, a sequence of blocks of up to blockRecords records in
+// strictly ascending key order, and an end marker:
+//
+//   header  u32 magic, u32 version, u32 dataSize, u32 blockRecords
+//   block   u32 count, u32 flags, u32 keyBytes, u32 expiryBytes,
+//           u32 valueBytes, u32 checksum (FNV-1a of the payload), payload
+//   end     u32 0, u64 total records
+//
+// The payload stores each column on its own:
+//   keys     first key zigzag-varint, then (gap - 1) varints
+//   expiries only with BLOCK_FLAG_EXPIRY: zigzag-varint deltas, 0 = never
+//   values   byte j of every record, j = 0 .. dataSize-1, each as the
+//            difference from the previous record's byte j, PackBits-coded
+//
+// Neighbouring records tend to share most value bytes, so the transposed
+// deltas are long runs of zeros (or of one step) and PackBits removes them.
+// Incompressible data grows by one byte per 128. Everything is written and
+// read strictly sequentially.
+
+constexpr uint32_t EXPORT_MAGIC = 0x58545042; // "BPTX"
+constexpr uint32_t EXPORT_VERSION = 1;
+constexpr uint32_t EXPORT_BLOCK_RECORDS = 4096;
+constexpr uint32_t EXPORT_MAX_BLOCK_RECORDS = 1u << 20;
+constexpr uint32_t BLOCK_FLAG_EXPIRY = 0x01;
+
+namespace interchange {
+
+inline void putU32(std::vector<uint8_t> &out, uint32_t v) {
+  const uint8_t *b = reinterpret_cast<const uint8_t *>(&v);
+  out.insert(out.end(), b, b + sizeof(v));
+}
+
+inline void putVarint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (uint32_t shift = 0; p < end && shift < 64; shift += 7) {
+    const uint8_t b = *p++;
+    v |= uint64_t(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+inline uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+inline int64_t unzigzag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline uint32_t fnv1a(const uint8_t *p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+// PackBits: control c < 128 copies c + 1 literal bytes, c >= 128 repeats
+// the next byte c - 126 times (runs of 2 .. 129)
+inline void packBits(const uint8_t *in, size_t n, std::vector<uint8_t> &out) {
+  size_t i = 0;
+  while (i < n) {
+    size_t run = 1;
+    while (i + run < n && run < 129 && in[i + run] == in[i])
+      run++;
+    if (run >= 2) {
+      out.push_back(static_cast<uint8_t>(run + 126));
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+    // Literals up to the next run of two or more
+    size_t lit = 1;
+    while (i + lit < n && lit < 128 &&
+           !(i + lit + 1 < n && in[i + lit] == in[i + lit + 1]))
+      lit++;
+    out.push_back(static_cast<uint8_t>(lit - 1));
+    out.insert(out.end(), in + i, in + i + lit);
+    i += lit;
+  }
+}
+
+inline bool unpackBits(const uint8_t *p, const uint8_t *end, uint8_t *out,
+                       size_t n) {
+  size_t o = 0;
+  while (o < n) {
+    if (p >= end)
+      return false;
+    const uint8_t c = *p++;
+    if (c < 128) {
+      const size_t lit = size_t(c) + 1;
+      if (size_t(end - p) < lit || n - o < lit)
+        return false;
+      std::memcpy(out + o, p, lit);
+      p += lit;
+      o += lit;
+    } else {
+      const size_t run = size_t(c) - 126;
+      if (p >= end || n - o < run)
+        return false;
+      std::memset(out + o, *p++, run);
+      o += run;
+    }
+  }
+  return p == end;
+}
+
+} // namespace interchange
+
+// Streams records (ascending keys) into an interchange file
+class ExportWriter {
+  std::FILE *file = nullptr;
+  uint32_t blockRecords = EXPORT_BLOCK_RECORDS;
+  std::vector<int32_t> keys;
+  std::vector<uint32_t> expiries;
+  std::vector<uint8_t> values;
+  std::vector<uint8_t> columns;
+  std::vector<uint8_t> block;
+  bool anyExpiry = false;
+  bool ok = false;
+  uint64_t total = 0;
+  uint64_t bytes = 0;
+
+public:
+  ExportWriter() = default;
+  ~ExportWriter() { abandon(); }
+  ExportWriter(const ExportWriter &) = delete;
+  ExportWriter &operator=(const ExportWriter &) = delete;
+
+  bool open(const std::string &path,
+            uint32_t recordsPerBlock = EXPORT_BLOCK_RECORDS) {
+    abandon();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+      return false;
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    blockRecords = std::min(std::max<uint32_t>(recordsPerBlock, 1),
+                            EXPORT_MAX_BLOCK_RECORDS);
+    std::vector<uint8_t> header;
+    interchange::putU32(header, EXPORT_MAGIC);
+    interchange::putU32(header, EXPORT_VERSION);
+    interchange::putU32(header, DATA_SIZE);
+    interchange::putU32(header, blockRecords);
+    ok = write(header);
+    total = 0;
+    return ok;
+  }
+
+  bool add(int32_t key, const uint8_t *value, uint32_t expiry = 0) {
+    if (!ok || (!keys.empty() && key <= keys.back()))
+      return ok = false;
+    keys.push_back(key);
+    expiries.push_back(expiry);
+    anyExpiry |= expiry != 0;
+    values.insert(values.end(), value, value + DATA_SIZE);
+    if (keys.size() == blockRecords)
+      flushBlock();
+    return ok;
+  }
+
+  // Flush the last block and the end marker; false if anything failed
+  bool finish() {
+    if (!ok)
+      return false;
+    if (!keys.empty() && !flushBlock())
+      return false;
+    std::vector<uint8_t> end;
+    interchange::putU32(end, 0);
+    const uint8_t *t = reinterpret_cast<const uint8_t *>(&total);
+    end.insert(end.end(), t, t + sizeof(total));
+    ok = write(end) && std::fclose(file) == 0;
+    file = nullptr;
+    return ok;
+  }
+
+  uint64_t records() const { return total; }
+  uint64_t bytesWritten() const { return bytes; }
+
+private:
+  void abandon() {
+    if (file)
+      std::fclose(file);
+    file = nullptr;
+    ok = false;
+    keys.clear();
+    expiries.clear();
+    values.clear();
+    anyExpiry = false;
+  }
+
+  bool write(const std::vector<uint8_t> &buf) {
+    bytes += buf.size();
+    return std::fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+  }
+
+  bool flushBlock() {
+    using namespace interchange;
+    const size_t n = keys.size();
+    block.clear();
+    block.resize(6 * sizeof(uint32_t)); // Header, patched below
+
+    putVarint(block, zigzag(keys[0]));
+    for (size_t i = 1; i < n; i++)
+      putVarint(block, uint64_t(int64_t(keys[i]) - keys[i - 1] - 1));
+    const size_t keyBytes = block.size() - 6 * sizeof(uint32_t);
+
+    if (anyExpiry) {
+      for (size_t i = 0; i < n; i++)
+        putVarint(block, zigzag(int64_t(expiries[i]) -
+                                (i ? int64_t(expiries[i - 1]) : 0)));
+    }
+    const size_t expiryBytes =
+        block.size() - 6 * sizeof(uint32_t) - keyBytes;
+
+    columns.resize(n * DATA_SIZE);
+    for (size_t j = 0; j < DATA_SIZE; j++) {
+      uint8_t *col = columns.data() + j * n;
+      uint8_t prev = 0;
+      for (size_t i = 0; i < n; i++) {
+        const uint8_t b = values[i * DATA_SIZE + j];
+        col[i] = static_cast<uint8_t>(b - prev);
+        prev = b;
+      }
+    }
+    packBits(columns.data(), columns.size(), block);
+    const size_t payload = block.size() - 6 * sizeof(uint32_t);
+
+    const uint32_t head[6] = {
+        static_cast<uint32_t>(n),
+        anyExpiry ? BLOCK_FLAG_EXPIRY : 0u,
+        static_cast<uint32_t>(keyBytes),
+        static_cast<uint32_t>(expiryBytes),
+        static_cast<uint32_t>(payload - keyBytes - expiryBytes),
+        fnv1a(block.data() + sizeof(head), payload)};
+    std::memcpy(block.data(), head, sizeof(head));
+
+    total += n;
+    keys.clear();
+    expiries.clear();
+    values.clear();
+    anyExpiry = false;
+    return ok = write(block);
+  }
+};
+
+// Reads an interchange file block by block
+class ImportReader {
+  std::FILE *file = nullptr;
+  uint32_t blockRecords = 0;
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> columns;
+  std::vector<int32_t> blockKeys;
+  std::vector<uint32_t> blockExpiries;
+  std::vector<uint8_t> blockValues;
+  uint64_t total = 0;
+  bool done = false;
+
+public:
+  ImportReader() = default;
+  ~ImportReader() { close(); }
+  ImportReader(const ImportReader &) = delete;
+  ImportReader &operator=(const ImportReader &) = delete;
+
+  bool open(const std::string &path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+      return false;
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    uint32_t header[4];
+    if (std::fread(header, sizeof(header), 1, file) != 1 ||
+        header[0] != EXPORT_MAGIC || header[1] != EXPORT_VERSION ||
+        header[2] != DATA_SIZE || header[3] == 0 ||
+        header[3] > EXPORT_MAX_BLOCK_RECORDS) {
+      close();
+      return false;
+    }
+    blockRecords = header[3];
+    return true;
+  }
+
+  void close() {
+    if (file)
+      std::fclose(file);
+    file = nullptr;
+    total = 0;
+    done = false;
+  }
+
+  // Decode the next block into keys()/values()/expiries(). count is 0 at
+  // the end marker. False on a truncated, corrupt or inconsistent file.
+  bool next(size_t &count) {
+    using namespace interchange;
+    count = 0;
+    if (!file || done)
+      return false;
+    uint32_t n;
+    if (std::fread(&n, sizeof(n), 1, file) != 1)
+      return false;
+    if (n == 0) { // End marker: the total must match what was read
+      uint64_t expected;
+      done = true;
+      return std::fread(&expected, sizeof(expected), 1, file) == 1 &&
+             expected == total;
+    }
+
+    uint32_t head[5];
+    if (n > blockRecords || std::fread(head, sizeof(head), 1, file) != 1)
+      return false;
+    const uint32_t flags = head[0];
+    const size_t keyBytes = head[1], expiryBytes = head[2];
+    const size_t valueBytes = head[3];
+    const size_t size = keyBytes + expiryBytes + valueBytes;
+    if (size > size_t(n) * (DATA_SIZE * 2 + 20) ||
+        (!(flags & BLOCK_FLAG_EXPIRY) && expiryBytes))
+      return false;
+    payload.resize(size);
+    if (std::fread(payload.data(), 1, size, file) != size ||
+        fnv1a(payload.data(), size) != head[4])
+      return false;
+
+    const uint8_t *p = payload.data();
+    const uint8_t *end = p + keyBytes;
+    blockKeys.resize(n);
+    uint64_t v;
+    if (!getVarint(p, end, v))
+      return false;
+    int64_t key = unzigzag(v);
+    for (uint32_t i = 0; i < n; i++) {
+      if (i > 0) {
+        if (!getVarint(p, end, v))
+          return false;
+        key += int64_t(v) + 1;
+      }
+      if (key < INT32_MIN || key > INT32_MAX)
+        return false;
+      blockKeys[i] = static_cast<int32_t>(key);
+    }
+    if (p != end)
+      return false;
+
+    blockExpiries.assign(n, 0);
+    end = p + expiryBytes;
+    int64_t expiry = 0;
+    for (uint32_t i = 0; (flags & BLOCK_FLAG_EXPIRY) && i < n; i++) {
+      if (!getVarint(p, end, v))
+        return false;
+      expiry += unzigzag(v);
+      if (expiry < 0 || expiry > UINT32_MAX)
+        return false;
+      blockExpiries[i] = static_cast<uint32_t>(expiry);
+    }
+    if (p != end)
+      return false;
+
+    columns.resize(size_t(n) * DATA_SIZE);
+    if (!unpackBits(p, p + valueBytes, columns.data(), columns.size()))
+      return false;
+    blockValues.resize(size_t(n) * DATA_SIZE);
+    for (size_t j = 0; j < DATA_SIZE; j++) {
+      const uint8_t *col = columns.data() + j * n;
+      uint8_t prev = 0;
+      for (size_t i = 0; i < n; i++) {
+        prev = static_cast<uint8_t>(prev + col[i]);
+        blockValues[i * DATA_SIZE + j] = prev;
+      }
+    }
+
+    total += n;
+    count = n;
+    return true;
+  }
+
+  const int32_t *keys() const { return blockKeys.data(); }
+  const uint8_t *values() const { return blockValues.data(); }
+  const uint32_t *expiries() const { return blockExpiries.data(); }
+  uint64_t records() const { return total; }
+};
+
+#endif // INTERCHANGE_HPP
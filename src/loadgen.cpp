@@ -0,0 +1,229 @@
+/**
+ * B+ Tree Load Generator
+ * Drives bptree_server with pipelined random reads and writes
+ */
+
+#include "protocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+struct LoadConfig {
+  std::string socketPath = "/tmp/bptree.sock";
+  uint32_t connections = 4;
+  uint32_t depth = 32;       // Requests in flight per connection
+  uint64_t opsPerConn = 200000;
+  int32_t keySpace = 1000000;
+  uint32_t readPercent = 90;
+  bool preload = false;      // MPUT every key first
+  bool sharded = false;      // Route by key to <socket>.<shard>
+  ShardMap map;
+};
+
+struct ConnResult {
+  uint64_t ops = 0;
+  uint64_t hits = 0;
+  uint64_t errors = 0;
+  std::vector<uint32_t> windowUs; // Round trip of each pipelined window
+};
+
+static void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "Usage: %s [options]\n"
+               "  --socket PATH   server socket (default /tmp/bptree.sock)\n"
+               "  --conns N       connections, one thread each (4)\n"
+               "  --depth N       pipelined requests per round trip (32)\n"
+               "  --ops N         requests per connection (200000)\n"
+               "  --keys N        key space [0, N) (1000000)\n"
+               "  --reads P       percentage of GETs, rest PUTs (90)\n"
+               "  --preload       write every key with MPUT first\n"
+               "  --shards N      sharded server: one connection per shard "
+               "per thread,\n"
+               "                  requests routed to the owning shard\n"
+               "  --key-range L:H key range the sharded server was started "
+               "with\n",
+               argv0);
+}
+
+static void fillValue(uint8_t *v, int32_t key) {
+  std::memcpy(v, &key, sizeof(key));
+  for (size_t i = 4; i < DATA_SIZE; i++)
+    v[i] = static_cast<uint8_t>((key + i) % 256);
+}
+
+static std::string socketOf(const LoadConfig &cfg, uint32_t shard) {
+  return cfg.sharded ? ShardMap::socketFor(cfg.socketPath, shard)
+                     : cfg.socketPath;
+}
+
+// Any shard accepts MPUT and forwards what it does not own
+static bool preload(const LoadConfig &cfg) {
+  RpcClient client;
+  if (!client.connect(socketOf(cfg, 0)))
+    return false;
+  const uint32_t chunk = 4096;
+  std::vector<int32_t> keys(chunk);
+  std::vector<uint8_t> values(size_t(chunk) * DATA_SIZE);
+  for (int32_t base = 0; base < cfg.keySpace; base += chunk) {
+    uint32_t n = static_cast<uint32_t>(std::min<int64_t>(
+        chunk, int64_t(cfg.keySpace) - base));
+    for (uint32_t i = 0; i < n; i++) {
+      keys[i] = base + static_cast<int32_t>(i);
+      fillValue(values.data() + size_t(i) * DATA_SIZE, keys[i]);
+    }
+    encodeMultiPut(client.out(), keys.data(), values.data(), n);
+    Frame f;
+    if (!client.flush() || !client.readResponse(f) ||
+        f.code != static_cast<uint8_t>(Status::OK))
+      return false;
+  }
+  return true;
+}
+
+static void runConnection(const LoadConfig &cfg, uint32_t id, ConnResult &res) {
+  const uint32_t n = cfg.sharded ? cfg.map.shards : 1;
+  std::vector<RpcClient> clients(n);
+  for (uint32_t s = 0; s < n; s++) {
+    if (!clients[s].connect(socketOf(cfg, s))) {
+      res.errors++;
+      return;
+    }
+  }
+  std::vector<uint32_t> route(cfg.depth);
+  std::mt19937 gen(1234 + id);
+  std::uniform_int_distribution<int32_t> keyDist(0, cfg.keySpace - 1);
+  std::uniform_int_distribution<uint32_t> mixDist(0, 99);
+  uint8_t value[DATA_SIZE];
+
+  res.windowUs.reserve(cfg.opsPerConn / cfg.depth + 1);
+  while (res.ops < cfg.opsPerConn) {
+    const uint32_t window = static_cast<uint32_t>(
+        std::min<uint64_t>(cfg.depth, cfg.opsPerConn - res.ops));
+    for (uint32_t i = 0; i < window; i++) {
+      int32_t key = keyDist(gen);
+      route[i] = cfg.sharded ? cfg.map.shardOf(key) : 0;
+      std::vector<uint8_t> &out = clients[route[i]].out();
+      if (mixDist(gen) < cfg.readPercent) {
+        encodeGet(out, key);
+      } else {
+        fillValue(value, key);
+        encodePut(out, key, value);
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (RpcClient &client : clients) {
+      if (!client.flush()) {
+        res.errors++;
+        return;
+      }
+    }
+    // Each connection answers in its own request order
+    for (uint32_t i = 0; i < window; i++) {
+      Frame f;
+      if (!clients[route[i]].readResponse(f)) {
+        res.errors++;
+        return;
+      }
+      if (f.code == static_cast<uint8_t>(Status::OK))
+        res.hits++;
+      else if (f.code == static_cast<uint8_t>(Status::ERROR))
+        res.errors++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    res.windowUs.push_back(static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count()));
+    res.ops += window;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  LoadConfig cfg;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--socket" && hasValue)
+      cfg.socketPath = argv[++i];
+    else if (arg == "--conns" && hasValue)
+      cfg.connections = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--depth" && hasValue)
+      cfg.depth = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--ops" && hasValue)
+      cfg.opsPerConn = std::max(1LL, std::atoll(argv[++i]));
+    else if (arg == "--keys" && hasValue)
+      cfg.keySpace = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--reads" && hasValue)
+      cfg.readPercent = std::min(100, std::max(0, std::atoi(argv[++i])));
+    else if (arg == "--preload")
+      cfg.preload = true;
+    else if (arg == "--shards" && hasValue) {
+      cfg.sharded = true;
+      cfg.map.shards = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--key-range" && hasValue &&
+             std::sscanf(argv[++i], "%d:%d", &cfg.map.lo, &cfg.map.hi) == 2 &&
+             cfg.map.lo < cfg.map.hi)
+      continue;
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (cfg.preload) {
+    auto start = std::chrono::steady_clock::now();
+    if (!preload(cfg)) {
+      std::fprintf(stderr, "Preload failed\n");
+      return 1;
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count();
+    std::printf("preload: %d keys in %.2f s\n", cfg.keySpace, s);
+  }
+
+  std::vector<ConnResult> results(cfg.connections);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t c = 0; c < cfg.connections; c++)
+    threads.emplace_back(runConnection, std::cref(cfg), c,
+                         std::ref(results[c]));
+  for (std::thread &t : threads)
+    t.join();
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  ConnResult total;
+  for (ConnResult &r : results) {
+    total.ops += r.ops;
+    total.hits += r.hits;
+    total.errors += r.errors;
+    total.windowUs.insert(total.windowUs.end(), r.windowUs.begin(),
+                          r.windowUs.end());
+  }
+  std::sort(total.windowUs.begin(), total.windowUs.end());
+  auto pct = [&](double p) -> uint32_t {
+    if (total.windowUs.empty())
+      return 0;
+    return total.windowUs[static_cast<size_t>(p * (total.windowUs.size() - 1))];
+  };
+
+  std::printf("%u conns x depth %u, %d%% reads, %d keys", cfg.connections,
+              cfg.depth, cfg.readPercent, cfg.keySpace);
+  if (cfg.sharded)
+    std::printf(", routed over %u shards", cfg.map.shards);
+  std::printf("\n");
+  std::printf("ops %llu in %.2f s: %.0f ops/sec, %llu OK, %llu errors\n",
+              static_cast<unsigned long long>(total.ops), seconds,
+              total.ops / seconds,
+              static_cast<unsigned long long>(total.hits),
+              static_cast<unsigned long long>(total.errors));
+  std::printf("window round trip: p50 %u us, p99 %u us, max %u us\n",
+              pct(0.50), pct(0.99), pct(1.0));
+  return total.errors ? 1 : 0;
+}
@@ -42,6 +42,17 @@
 #define FORCE_INLINE inline
 #endif
 
+#if defined(__GNUC__) || defined(__clang__)
+#define POPCOUNT64(x) __builtin_popcountll(x)
+#else
+inline int POPCOUNT64(uint64_t x) {
+  int n = 0;
+  for (; x; x &= x - 1)
+    n++;
+  return n;
+}
+#endif
+
 // =============================================================================
 // CONSTANTS
 // =============================================================================
@@ -52,6 +63,10 @@ constexpr uint32_t DATA_SIZE = 100;
 constexpr uint32_t INVALID_PAGE = 0xFFFFFFFF;
 constexpr uint32_t CACHE_LINE_SIZE = 64;
 
+// On-disk format: bump when the page layout changes incompatibly
+constexpr uint32_t METADATA_MAGIC = 0xB7EEDB7E;
+constexpr uint32_t FORMAT_VERSION = 1;
+
 // Page types
 enum class PageType : uint8_t { METADATA = 0, INTERNAL = 1, LEAF = 2 };
 
@@ -62,18 +77,87 @@ struct alignas(CACHE_LINE_SIZE) MetadataPage {
   uint32_t numPages;     // Total pages allocated
   uint32_t freeListHead; // Head of free page list
   uint32_t numRecords;   // Total records in tree
-  uint8_t reserved[PAGE_SIZE - 20];
+  uint32_t numStripes;   // Files the page space is striped over (0 = 1)
+  uint64_t epoch;        // Bumped by the writer on root changes and syncs
+
+  // Versioned header (format 1+). Files from before this are all zero here.
+  uint32_t formatVersion; // FORMAT_VERSION the file was written with
+  uint32_t pageSize;      // PAGE_SIZE
+  uint16_t keySize;       // KEY_SIZE
+  uint16_t dataSize;      // DATA_SIZE
+  uint32_t cleanShutdown; // 1 only after a complete close()
+  uint64_t lsn;           // Incremented by every modification
+  uint64_t checkpointLsn; // lsn covered by the last completed sync()
+  uint64_t replicaSeq;    // Change stream position applied (replicas only)
+  // Sharded servers: this file is shard shardIndex of shardCount over
+  // [shardLo, shardHi]. Zero (older files too) until a server binds it.
+  uint32_t shardIndex;
+  uint32_t shardCount;
+  int32_t shardLo;
+  int32_t shardHi;
+  uint8_t reserved[PAGE_SIZE - 88];
 
   void init() {
-    magic = 0xB7EEDB7E;
+    magic = METADATA_MAGIC;
     rootPageId = INVALID_PAGE;
     numPages = 1;
     freeListHead = INVALID_PAGE;
     numRecords = 0;
+    numStripes = 1;
+    epoch = 0;
+    initHeader();
+    cleanShutdown = 0;
+    lsn = 0;
+    checkpointLsn = 0;
+    replicaSeq = 0;
+    shardIndex = 0;
+    shardCount = 0;
+    shardLo = 0;
+    shardHi = 0;
     std::memset(reserved, 0, sizeof(reserved));
   }
 
-  FORCE_INLINE bool isValid() const { return magic == 0xB7EEDB7E; }
+  void initHeader() {
+    formatVersion = FORMAT_VERSION;
+    pageSize = PAGE_SIZE;
+    keySize = KEY_SIZE;
+    dataSize = DATA_SIZE;
+  }
+
+  FORCE_INLINE bool isValid() const { return magic == METADATA_MAGIC; }
+
+  // Format 0 files predate the versioned header and carry no sizes
+  FORCE_INLINE bool isLegacy() const { return formatVersion == 0; }
+
+  // Can this build read the file at all?
+  bool isCompatible() const {
+    if (!isValid() || formatVersion > FORMAT_VERSION)
+      return false;
+    return isLegacy() || (pageSize == PAGE_SIZE && keySize == KEY_SIZE &&
+                          dataSize == DATA_SIZE);
+  }
+
+  // Files created before striping leave this field zeroed
+  FORCE_INLINE uint32_t stripeCount() const {
+    return numStripes == 0 ? 1 : numStripes;
+  }
+
+  // The epoch is read by other processes through a shared mapping
+  FORCE_INLINE uint64_t loadEpoch() const {
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(&epoch, __ATOMIC_ACQUIRE);
+#else
+    return *static_cast<const volatile uint64_t *>(&epoch);
+#endif
+  }
+
+  FORCE_INLINE void bumpEpoch() {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(&epoch, epoch + 1, __ATOMIC_RELEASE);
+#else
+    *static_cast<volatile uint64_t *>(&epoch) = epoch + 1;
+#endif
+  }
 };
 
 // Leaf capacity calculation
@@ -82,9 +166,84 @@ constexpr uint32_t LEAF_ENTRY_SIZE = KEY_SIZE + DATA_SIZE;
 constexpr uint32_t LEAF_MAX_KEYS =
     (PAGE_SIZE - LEAF_HEADER_SIZE) / LEAF_ENTRY_SIZE;
 
-// Internal node capacity
+// Bytes left over after the key and value arrays hold per-leaf extras:
+// [0, 8)  tombstone bitmap, one bit per slot
+// [8, 16) low and high fence keys
+constexpr uint32_t LEAF_TRAILER_OFFSET = LEAF_MAX_KEYS * LEAF_ENTRY_SIZE;
+constexpr uint32_t LEAF_TRAILER_SIZE =
+    PAGE_SIZE - LEAF_HEADER_SIZE - LEAF_TRAILER_OFFSET;
+constexpr uint32_t LEAF_FENCE_OFFSET = LEAF_TRAILER_OFFSET + sizeof(uint64_t);
+static_assert(LEAF_MAX_KEYS <= 64, "tombstone bitmap is a uint64_t");
+static_assert(LEAF_TRAILER_SIZE >= sizeof(uint64_t) + 2 * sizeof(int32_t),
+              "leaf trailer must fit the tombstone bitmap and fences");
+
+// Most entries a leaf may hold in its unsorted append area
+constexpr uint32_t LEAF_TAIL_MAX = 16;
+
+// Leaf format bits (LeafNode::flags)
+constexpr uint8_t LEAF_FLAG_SLOTTED = 0x01; // values referenced via slot map
+constexpr uint8_t LEAF_FLAG_FENCED = 0x02;  // fence keys are maintained
+constexpr uint8_t LEAF_FLAG_TTL = 0x04;     // per-entry expiry array
+
+// A slotted leaf gives its last value slot to the slot map: one byte per
+// entry naming the value slot that holds its data
+constexpr uint32_t LEAF_SLOTTED_MAX_KEYS = LEAF_MAX_KEYS - 1;
+static_assert(LEAF_SLOTTED_MAX_KEYS <= DATA_SIZE,
+              "slot map must fit in one value slot");
+
+// A TTL leaf gives two value slots (below the slot map's) to a uint32_t
+// expiry per entry, in seconds since the Unix epoch, 0 meaning never
+constexpr uint32_t LEAF_TTL_MAX_KEYS = LEAF_MAX_KEYS - 3;
+static_assert(LEAF_TTL_MAX_KEYS * sizeof(uint32_t) <= 2 * DATA_SIZE,
+              "expiry array must fit in two value slots");
+
+// Internal node capacity. The page has room for INTERNAL_KEY_SLOTS keys;
+// the last slot pair is given to the fence keys, so nodes written by this
+// version stop at INTERNAL_MAX_KEYS. Older files may still hold full nodes.
 constexpr uint32_t INTERNAL_HEADER_SIZE = 12;
-constexpr uint32_t INTERNAL_MAX_KEYS = 510;
+constexpr uint32_t INTERNAL_KEY_SLOTS = 510;
+constexpr uint32_t INTERNAL_MAX_KEYS = INTERNAL_KEY_SLOTS - 1;
+constexpr uint32_t INTERNAL_FENCE_OFFSET =
+    (INTERNAL_MAX_KEYS * 2 + 1) * sizeof(uint32_t);
+static_assert(INTERNAL_FENCE_OFFSET + 2 * sizeof(int32_t) <=
+                  PAGE_SIZE - INTERNAL_HEADER_SIZE,
+              "internal node must fit its fence keys");
+
+// Internal node flags (InternalNode::flags)
+constexpr uint8_t INTERNAL_FLAG_FENCED = 0x01; // fence keys are maintained
+
+// =============================================================================
+// SEPARATORS - suffix truncation
+// =============================================================================
+// Any value in (last key of the left node, first key of the right node]
+// routes correctly. Picking the "shortest" one keeps separators compact
+// when keys are wide and leaves the most room on both sides for later
+// inserts.
+
+// Integer keys: the value in (left, right] with the most trailing zero
+// bits, i.e. right with every bit below the highest differing bit cleared.
+FORCE_INLINE int32_t shortestSeparator(int32_t left, int32_t right) {
+  // Order-preserving unsigned view
+  const uint32_t l = static_cast<uint32_t>(left) ^ 0x80000000u;
+  const uint32_t r = static_cast<uint32_t>(right) ^ 0x80000000u;
+  uint32_t diff = l ^ r;
+  diff |= diff >> 1;
+  diff |= diff >> 2;
+  diff |= diff >> 4;
+  diff |= diff >> 8;
+  diff |= diff >> 16;
+  return static_cast<int32_t>((r & ~(diff >> 1)) ^ 0x80000000u);
+}
+
+// Byte-string (composite) keys in memcmp order: length of the shortest
+// prefix of right that still sorts after left
+inline size_t shortestSeparatorLength(const uint8_t *left, size_t leftLen,
+                                      const uint8_t *right, size_t rightLen) {
+  size_t i = 0;
+  while (i < leftLen && i < rightLen && left[i] == right[i])
+    i++;
+  return std::min(i + 1, rightLen);
+}
 
 #pragma pack(push, 1)
 
@@ -93,7 +252,9 @@ constexpr uint32_t INTERNAL_MAX_KEYS = 510;
 // =============================================================================
 struct LeafNode {
   PageType type;       // 1 byte
-  uint8_t padding1[3]; // 3 bytes padding
+  uint8_t tailCount;   // 1 byte - unsorted entries at the end of the slots
+  uint8_t flags;       // 1 byte - LEAF_FLAG_* format bits
+  uint8_t padding1;    // 1 byte padding
   uint32_t numKeys;    // 4 bytes
   uint32_t prevLeaf;   // 4 bytes - for range queries
   uint32_t nextLeaf;   // 4 bytes - for range queries
@@ -102,9 +263,11 @@ struct LeafNode {
   // Keys array followed by data array
   uint8_t data[PAGE_SIZE - LEAF_HEADER_SIZE];
 
-  void init() {
+  void init(uint8_t leafFlags = 0) {
     type = PageType::LEAF;
-    padding1[0] = padding1[1] = padding1[2] = 0;
+    tailCount = 0;
+    flags = leafFlags;
+    padding1 = 0;
     numKeys = 0;
     prevLeaf = INVALID_PAGE;
     nextLeaf = INVALID_PAGE;
@@ -121,18 +284,94 @@ struct LeafNode {
     return data + LEAF_MAX_KEYS * KEY_SIZE;
   }
 
+  // ---------------------------------------------------------------------------
+  // SLOTTED VALUES: keys stay sorted, but each value lives in whichever slot
+  // was free when it arrived. Shifting an entry moves its key and a one-byte
+  // slot reference instead of 100 bytes of data.
+  // ---------------------------------------------------------------------------
+  FORCE_INLINE bool isSlotted() const { return flags & LEAF_FLAG_SLOTTED; }
+
+  static constexpr uint32_t capacityFor(uint8_t leafFlags) {
+    return (leafFlags & LEAF_FLAG_TTL)       ? LEAF_TTL_MAX_KEYS
+           : (leafFlags & LEAF_FLAG_SLOTTED) ? LEAF_SLOTTED_MAX_KEYS
+                                             : LEAF_MAX_KEYS;
+  }
+  FORCE_INLINE uint32_t capacity() const { return capacityFor(flags); }
+
+  FORCE_INLINE uint8_t *slotMap() {
+    return values() + LEAF_SLOTTED_MAX_KEYS * DATA_SIZE;
+  }
+  FORCE_INLINE const uint8_t *slotMap() const {
+    return values() + LEAF_SLOTTED_MAX_KEYS * DATA_SIZE;
+  }
+
+  FORCE_INLINE uint32_t valueSlot(uint32_t idx) const {
+    return isSlotted() ? slotMap()[idx] : idx;
+  }
+
   FORCE_INLINE uint8_t *getValue(uint32_t idx) {
-    return values() + idx * DATA_SIZE;
+    return values() + valueSlot(idx) * DATA_SIZE;
   }
   FORCE_INLINE const uint8_t *getValue(uint32_t idx) const {
-    return values() + idx * DATA_SIZE;
+    return values() + valueSlot(idx) * DATA_SIZE;
+  }
+
+  // Lowest value slot no entry references (slotted leaves, not full)
+  FORCE_INLINE uint32_t freeSlot() const {
+    const uint8_t *m = slotMap();
+    uint64_t used = 0;
+    for (uint32_t i = 0; i < numKeys; i++)
+      used |= 1ULL << m[i];
+    return static_cast<uint32_t>(POPCOUNT64((~used & (used + 1)) - 1));
+  }
+
+  // ---------------------------------------------------------------------------
+  // EXPIRY: TTL leaves keep one expiry per entry, index-aligned with the
+  // keys and moved with them. An expired entry stays in place, hidden from
+  // lookups and scans, until the sweeper removes it.
+  // ---------------------------------------------------------------------------
+  FORCE_INLINE bool hasExpiry() const { return flags & LEAF_FLAG_TTL; }
+
+  FORCE_INLINE uint32_t *expiries() {
+    return reinterpret_cast<uint32_t *>(values() +
+                                        LEAF_TTL_MAX_KEYS * DATA_SIZE);
+  }
+  FORCE_INLINE const uint32_t *expiries() const {
+    return reinterpret_cast<const uint32_t *>(values() +
+                                              LEAF_TTL_MAX_KEYS * DATA_SIZE);
+  }
+
+  FORCE_INLINE uint32_t expiryAt(uint32_t idx) const {
+    return hasExpiry() ? expiries()[idx] : 0;
+  }
+
+  FORCE_INLINE bool isExpired(uint32_t idx, uint32_t now) const {
+    const uint32_t e = expiryAt(idx);
+    return e != 0 && e <= now;
+  }
+
+  // Bit i set for every expired entry
+  uint64_t expiredMask(uint32_t now) const {
+    if (!hasExpiry())
+      return 0;
+    const uint32_t *e = expiries();
+    const uint32_t n = std::min<uint32_t>(numKeys, LEAF_TTL_MAX_KEYS);
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < n; i++)
+      mask |= uint64_t(e[i] != 0 && e[i] <= now) << i;
+    return mask;
+  }
+
+  // Entries [0, sortedCount()) are in key order; the rest are the tail
+  FORCE_INLINE uint32_t sortedCount() const {
+    return numKeys - std::min<uint32_t>(tailCount, numKeys);
   }
 
   // SIMD-OPTIMIZED: AVX2 search for 39 leaf keys
-  // Compare 8 int32_t keys per instruction
+  // Compare 8 int32_t keys per instruction. Searches the sorted prefix only.
   FORCE_INLINE uint32_t findPosition(int32_t key) const {
     const int32_t *k = keys();
-    const uint32_t n = numKeys;
+    const uint32_t n = sortedCount();
 
     if (UNLIKELY(n == 0))
       return 0;
@@ -176,39 +415,323 @@ struct LeafNode {
 #endif
   }
 
-  // Insert at position with memmove optimization
-  void insertAt(uint32_t pos, int32_t key, const uint8_t *value) {
+  // ---------------------------------------------------------------------------
+  // UNSORTED TAIL: the last tailCount slots hold appended entries in arrival
+  // order, so an insert is a single append instead of a shift of every
+  // larger key and value. The tail is probed with a SIMD equality compare
+  // and folded into the sorted prefix by mergeTail() when it fills or the
+  // leaf must split. Scans that need order merge it on the fly.
+  // ---------------------------------------------------------------------------
+
+  // Tail slot holding key, or numKeys
+  FORCE_INLINE uint32_t findInTail(int32_t key) const {
+    const int32_t *k = keys();
+    const uint32_t n = numKeys;
+    uint32_t i = sortedCount();
+
+#ifdef HAVE_AVX2
+    __m256i target = _mm256_set1_epi32(key);
+    for (; i + 8 <= n; i += 8) {
+      __m256i eq = _mm256_cmpeq_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k + i)),
+          target);
+      int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+      if (mask != 0)
+        return i + __builtin_ctz(mask);
+    }
+#elif defined(HAVE_SSE2)
+    __m128i target = _mm_set1_epi32(key);
+    for (; i + 4 <= n; i += 4) {
+      __m128i eq = _mm_cmpeq_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(k + i)), target);
+      int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+      if (mask != 0)
+        return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < n; ++i) {
+      if (k[i] == key)
+        return i;
+    }
+    return n;
+  }
+
+  // Slot holding key in either region, or numKeys if absent
+  FORCE_INLINE uint32_t findKey(int32_t key) const {
+    uint32_t pos = findPosition(key);
+    if (pos < sortedCount() && keys()[pos] == key)
+      return pos;
+    return tailCount ? findInTail(key) : numKeys;
+  }
+
+  // Caller checks !isFull() and its tail limit, and that key is absent
+  FORCE_INLINE void appendToTail(int32_t key, const uint8_t *value,
+                                  uint32_t expiry = 0) {
+    insertAt(numKeys, key, value, expiry);
+    tailCount++;
+  }
+
+  // Fold the tail into the sorted prefix. Tombstones are compacted first so
+  // their bits never need permuting. The tail is sorted in a stack buffer
+  // and merged from the back, so each prefix run moves exactly once.
+  void mergeTail() {
+    compact();
+    const uint32_t t = tailCount;
+    if (t == 0)
+      return;
+
     int32_t *k = keys();
     uint8_t *v = values();
+    uint8_t *m = slotMap();
+    const bool slotted = isSlotted();
+    const uint32_t s = numKeys - t;
+
+    uint8_t order[LEAF_TAIL_MAX];
+    sortTail(order, s, t);
+    int32_t tailKeys[LEAF_TAIL_MAX];
+    uint8_t tailRefs[LEAF_TAIL_MAX];
+    uint32_t tailExpiry[LEAF_TAIL_MAX];
+    uint8_t tailValues[LEAF_TAIL_MAX * DATA_SIZE];
+    for (uint32_t j = 0; j < t; j++) {
+      tailKeys[j] = k[order[j]];
+      tailExpiry[j] = expiryAt(order[j]);
+      if (slotted)
+        tailRefs[j] = m[order[j]];
+      else
+        std::memcpy(tailValues + j * DATA_SIZE, v + order[j] * DATA_SIZE,
+                    DATA_SIZE);
+    }
+
+    // Prefix entries above tailKeys[j] end up j + 1 slots higher
+    uint32_t hi = s;
+    for (uint32_t j = t; j-- > 0;) {
+      uint32_t lo =
+          static_cast<uint32_t>(std::upper_bound(k, k + hi, tailKeys[j]) - k);
+      if (lo < hi) {
+        std::memmove(k + lo + j + 1, k + lo, (hi - lo) * sizeof(int32_t));
+        movePayload(lo + j + 1, lo, hi - lo);
+      }
+      k[lo + j] = tailKeys[j];
+      if (hasExpiry())
+        expiries()[lo + j] = tailExpiry[j];
+      if (slotted)
+        m[lo + j] = tailRefs[j];
+      else
+        std::memcpy(v + (lo + j) * DATA_SIZE, tailValues + j * DATA_SIZE,
+                    DATA_SIZE);
+      hi = lo;
+    }
+    tailCount = 0;
+  }
+
+  // Slot indices in key order without modifying the page (scans, readers).
+  // out must hold LEAF_MAX_KEYS entries; returns how many were written. The
+  // header is read once and clamped, so a torn page cannot overrun out.
+  uint32_t orderedSlots(uint8_t *out) const {
+    const int32_t *k = keys();
+    const uint32_t n = std::min<uint32_t>(numKeys, LEAF_MAX_KEYS);
+    const uint32_t t = std::min<uint32_t>(std::min<uint32_t>(tailCount, n),
+                                          LEAF_TAIL_MAX);
+    const uint32_t s = n - t;
+    uint8_t tail[LEAF_TAIL_MAX];
+    sortTail(tail, s, t);
+
+    uint32_t i = 0, j = 0, o = 0;
+    while (i < s && j < t)
+      out[o++] = static_cast<uint8_t>(k[i] < k[tail[j]] ? i++ : tail[j++]);
+    while (i < s)
+      out[o++] = static_cast<uint8_t>(i++);
+    while (j < t)
+      out[o++] = tail[j++];
+    return o;
+  }
+
+  // ---------------------------------------------------------------------------
+  // TOMBSTONES: lazily deleted slots stay in place (keys remain sorted) and
+  // are skipped by lookups and scans until compact() removes them in bulk.
+  // Pages that never used lazy deletion have an all-zero bitmap.
+  // ---------------------------------------------------------------------------
+  FORCE_INLINE uint64_t &tombstones() {
+    return *reinterpret_cast<uint64_t *>(data + LEAF_TRAILER_OFFSET);
+  }
+  FORCE_INLINE uint64_t tombstones() const {
+    return *reinterpret_cast<const uint64_t *>(data + LEAF_TRAILER_OFFSET);
+  }
+
+  // ---------------------------------------------------------------------------
+  // FENCE KEYS: the inclusive key range [lowFence, highFence] this leaf is
+  // responsible for, taken from the separators around it (INT32_MIN and
+  // INT32_MAX at the edges). Lets scans stop without touching the next leaf
+  // and lets optimistic readers check they landed in the right place.
+  // ---------------------------------------------------------------------------
+  FORCE_INLINE bool hasFences() const { return flags & LEAF_FLAG_FENCED; }
+  FORCE_INLINE int32_t lowFence() const {
+    return *reinterpret_cast<const int32_t *>(data + LEAF_FENCE_OFFSET);
+  }
+  FORCE_INLINE int32_t highFence() const {
+    return *reinterpret_cast<const int32_t *>(data + LEAF_FENCE_OFFSET + 4);
+  }
+  FORCE_INLINE void setFences(int32_t low, int32_t high) {
+    *reinterpret_cast<int32_t *>(data + LEAF_FENCE_OFFSET) = low;
+    *reinterpret_cast<int32_t *>(data + LEAF_FENCE_OFFSET + 4) = high;
+    flags |= LEAF_FLAG_FENCED;
+  }
+  // True when key is in range, or when this leaf does not track fences
+  FORCE_INLINE bool covers(int32_t key) const {
+    return !hasFences() || (key >= lowFence() && key <= highFence());
+  }
+  // After a split at separator sep moved [sep, ...] into dst
+  void splitFencesWith(LeafNode *dst, int32_t sep) {
+    if (!hasFences())
+      return;
+    dst->setFences(sep, highFence());
+    setFences(lowFence(), sep - 1);
+  }
+
+  FORCE_INLINE bool isDead(uint32_t idx) const {
+    return (tombstones() >> idx) & 1;
+  }
+  FORCE_INLINE void markDead(uint32_t idx) { tombstones() |= 1ULL << idx; }
+  FORCE_INLINE void clearDead(uint32_t idx) {
+    tombstones() &= ~(1ULL << idx);
+  }
+  FORCE_INLINE uint32_t deadCount() const {
+    return static_cast<uint32_t>(POPCOUNT64(tombstones()));
+  }
+  FORCE_INLINE uint32_t liveCount() const { return numKeys - deadCount(); }
+
+  // Drop every tombstoned slot, moving each run of live entries once
+  void compact() {
+    uint64_t dead = tombstones();
+    if (!dead)
+      return;
+
+    int32_t *k = keys();
+    uint32_t out = 0;
+    uint32_t i = 0;
+    while (i < numKeys) {
+      if ((dead >> i) & 1) {
+        i++;
+        continue;
+      }
+      uint32_t runEnd = i + 1;
+      while (runEnd < numKeys && !((dead >> runEnd) & 1))
+        runEnd++;
+      if (out != i) {
+        std::memmove(k + out, k + i, (runEnd - i) * sizeof(int32_t));
+        movePayload(out, i, runEnd - i);
+      }
+      out += runEnd - i;
+      i = runEnd;
+    }
+    if (tailCount)
+      tailCount -= static_cast<uint8_t>(POPCOUNT64(dead >> sortedCount()));
+    numKeys = out;
+    tombstones() = 0;
+  }
+
+  // Insert at position with memmove optimization. expiry is ignored by
+  // leaves without an expiry array.
+  void insertAt(uint32_t pos, int32_t key, const uint8_t *value,
+                uint32_t expiry = 0) {
+    int32_t *k = keys();
+    const uint32_t slot = isSlotted() ? freeSlot() : pos;
 
     // Use memmove for bulk shifting (faster than loop)
     if (pos < numKeys) {
       std::memmove(k + pos + 1, k + pos, (numKeys - pos) * sizeof(int32_t));
-      std::memmove(v + (pos + 1) * DATA_SIZE, v + pos * DATA_SIZE,
-                   (numKeys - pos) * DATA_SIZE);
+      movePayload(pos + 1, pos, numKeys - pos);
+      if (uint64_t dead = tombstones()) {
+        uint64_t low = dead & ((1ULL << pos) - 1);
+        tombstones() = low | ((dead >> pos) << (pos + 1));
+      }
     }
 
     k[pos] = key;
-    std::memcpy(v + pos * DATA_SIZE, value, DATA_SIZE);
+    if (hasExpiry())
+      expiries()[pos] = expiry;
+    if (isSlotted())
+      slotMap()[pos] = static_cast<uint8_t>(slot);
+    std::memcpy(values() + slot * DATA_SIZE, value, DATA_SIZE);
     numKeys++;
   }
 
   // Remove at position with memmove optimization
   void removeAt(uint32_t pos) {
     int32_t *k = keys();
-    uint8_t *v = values();
 
     if (pos < numKeys - 1) {
       std::memmove(k + pos, k + pos + 1, (numKeys - pos - 1) * sizeof(int32_t));
-      std::memmove(v + pos * DATA_SIZE, v + (pos + 1) * DATA_SIZE,
-                   (numKeys - pos - 1) * DATA_SIZE);
+      movePayload(pos, pos + 1, numKeys - pos - 1);
     }
+    if (uint64_t dead = tombstones()) {
+      uint64_t low = dead & ((1ULL << pos) - 1);
+      tombstones() = low | ((dead >> (pos + 1)) << pos);
+    }
+    if (pos >= sortedCount())
+      tailCount--;
     numKeys--;
   }
 
-  FORCE_INLINE bool isFull() const { return numKeys >= LEAF_MAX_KEYS; }
+  // Move entries [from, numKeys) to the front of an empty leaf: one memcpy
+  // for the keys and one for the values, no per-entry work. The leaf must
+  // have no tail (see mergeTail). The new leaf inherits this one's format;
+  // a slotted leaf gathers the moved values into the new leaf's first slots.
+  // Fences are divided by the caller (splitFencesWith).
+  void moveTailTo(LeafNode *dst, uint32_t from) {
+    const uint32_t count = numKeys - from;
+    dst->flags = flags & ~LEAF_FLAG_FENCED;
+    std::memcpy(dst->keys(), keys() + from, count * sizeof(int32_t));
+    if (isSlotted()) {
+      for (uint32_t j = 0; j < count; j++) {
+        std::memcpy(dst->values() + j * DATA_SIZE, getValue(from + j),
+                    DATA_SIZE);
+        dst->slotMap()[j] = static_cast<uint8_t>(j);
+      }
+    } else {
+      std::memcpy(dst->values(), getValue(from), count * DATA_SIZE);
+    }
+    if (hasExpiry())
+      std::memcpy(dst->expiries(), expiries() + from,
+                  count * sizeof(uint32_t));
+    dst->numKeys = count;
+    numKeys = from;
+    if (uint64_t dead = tombstones()) {
+      dst->tombstones() = dead >> from;
+      tombstones() = dead & ((1ULL << from) - 1);
+    }
+  }
+
+  FORCE_INLINE bool isFull() const { return numKeys >= capacity(); }
   FORCE_INLINE bool isHalfFull() const {
-    return numKeys >= (LEAF_MAX_KEYS + 1) / 2;
+    return numKeys >= (capacity() + 1) / 2;
+  }
+
+private:
+  // Shift the per-entry payload of [src, src + count) to dst: the values
+  // themselves, or only their one-byte slot references in a slotted leaf,
+  // plus the expiries of a TTL leaf
+  FORCE_INLINE void movePayload(uint32_t dst, uint32_t src, uint32_t count) {
+    if (hasExpiry())
+      std::memmove(expiries() + dst, expiries() + src,
+                   count * sizeof(uint32_t));
+    if (isSlotted())
+      std::memmove(slotMap() + dst, slotMap() + src, count);
+    else
+      std::memmove(values() + dst * DATA_SIZE, values() + src * DATA_SIZE,
+                   count * DATA_SIZE);
+  }
+
+  // Tail slot indices ordered by key; the tail is small, so insertion sort
+  void sortTail(uint8_t *order, uint32_t s, uint32_t t) const {
+    const int32_t *k = keys();
+    for (uint32_t i = 0; i < t; i++) {
+      const uint8_t slot = static_cast<uint8_t>(s + i);
+      uint32_t j = i;
+      for (; j > 0 && k[order[j - 1]] > k[slot]; j--)
+        order[j] = order[j - 1];
+      order[j] = slot;
+    }
   }
 };
 
@@ -217,7 +740,8 @@ struct LeafNode {
 // =============================================================================
 struct InternalNode {
   PageType type;       // 1 byte
-  uint8_t padding1[3]; // 3 bytes padding
+  uint8_t flags;       // 1 byte - INTERNAL_FLAG_* bits
+  uint8_t padding1[2]; // 2 bytes padding
   uint32_t numKeys;    // 4 bytes
   uint32_t parent;     // 4 bytes
   // Total header: 12 bytes
@@ -227,7 +751,8 @@ struct InternalNode {
 
   void init() {
     type = PageType::INTERNAL;
-    padding1[0] = padding1[1] = padding1[2] = 0;
+    flags = 0;
+    padding1[0] = padding1[1] = 0;
     numKeys = 0;
     parent = INVALID_PAGE;
     std::memset(data, 0, sizeof(data));
@@ -263,6 +788,30 @@ struct InternalNode {
     reinterpret_cast<int32_t *>(data)[idx * 2 + 1] = key;
   }
 
+  // Inclusive key range of this subtree, as for LeafNode
+  FORCE_INLINE bool hasFences() const { return flags & INTERNAL_FLAG_FENCED; }
+  FORCE_INLINE int32_t lowFence() const {
+    return *reinterpret_cast<const int32_t *>(data + INTERNAL_FENCE_OFFSET);
+  }
+  FORCE_INLINE int32_t highFence() const {
+    return *reinterpret_cast<const int32_t *>(data + INTERNAL_FENCE_OFFSET +
+                                              4);
+  }
+  FORCE_INLINE void setFences(int32_t low, int32_t high) {
+    *reinterpret_cast<int32_t *>(data + INTERNAL_FENCE_OFFSET) = low;
+    *reinterpret_cast<int32_t *>(data + INTERNAL_FENCE_OFFSET + 4) = high;
+    flags |= INTERNAL_FLAG_FENCED;
+  }
+  FORCE_INLINE bool covers(int32_t key) const {
+    return !hasFences() || (key >= lowFence() && key <= highFence());
+  }
+  void splitFencesWith(InternalNode *dst, int32_t sep) {
+    if (!hasFences())
+      return;
+    dst->setFences(sep, highFence());
+    setFences(lowFence(), sep - 1);
+  }
+
   // OPTIMIZED: Binary search for child index
   // Much faster than linear search for 510 keys: O(log n) ≈ 9 comparisons
   FORCE_INLINE uint32_t findChildIndex(int32_t key) const {
@@ -283,6 +832,44 @@ struct InternalNode {
     return lo;
   }
 
+  // Binary search for where a new separator goes: first key >= key
+  FORCE_INLINE uint32_t findInsertPosition(int32_t key) const {
+    uint32_t lo = 0, hi = numKeys;
+    while (lo < hi) {
+      uint32_t mid = lo + ((hi - lo) >> 1);
+      if (getKey(mid) < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  // Insert separator key at pos with its right child. In the interleaved
+  // layout each (key[i], child[i+1]) pair is adjacent, so one memmove of
+  // 8 bytes per pair opens the gap.
+  void insertAt(uint32_t pos, int32_t key, uint32_t rightChild) {
+    uint32_t *words = reinterpret_cast<uint32_t *>(data);
+    if (pos < numKeys) {
+      std::memmove(words + pos * 2 + 3, words + pos * 2 + 1,
+                   (numKeys - pos) * 2 * sizeof(uint32_t));
+    }
+    setKey(pos, key);
+    setChild(pos + 1, rightChild);
+    numKeys++;
+  }
+
+  // Move keys [from, numKeys) and children [from, numKeys] to the front of
+  // an empty node with a single memcpy. Leaves this node with `from` keys;
+  // the caller adjusts if key[from - 1] is being pushed up.
+  void moveTailTo(InternalNode *dst, uint32_t from) {
+    const uint32_t count = numKeys - from;
+    std::memcpy(dst->data, data + from * 2 * sizeof(uint32_t),
+                (count * 2 + 1) * sizeof(uint32_t));
+    dst->numKeys = count;
+    numKeys = from;
+  }
+
   FORCE_INLINE bool isFull() const { return numKeys >= INTERNAL_MAX_KEYS; }
   FORCE_INLINE bool isHalfFull() const {
     return numKeys >= (INTERNAL_MAX_KEYS + 1) / 2;
@@ -291,6 +878,24 @@ struct InternalNode {
 
 #pragma pack(pop)
 
+// Prefetch the cache lines a search of `page` will touch first, issued as
+// soon as the page id is known so the fetches overlap instead of arriving
+// one dependent miss per probe. Covers the header and a leaf's whole key
+// block, plus an internal node's first two binary-search levels for a node
+// of about estKeys keys (its own count is not loaded yet; the parent's is a
+// good estimate since siblings fill alike).
+FORCE_INLINE void prefetchNodeSearch(const void *page, uint32_t estKeys) {
+  const uint8_t *p = static_cast<const uint8_t *>(page);
+  PREFETCH_READ(p);
+  PREFETCH_READ(p + CACHE_LINE_SIZE);
+  PREFETCH_READ(p + 2 * CACHE_LINE_SIZE);
+  const uint8_t *keys = p + INTERNAL_HEADER_SIZE + sizeof(uint32_t);
+  const uint32_t n = std::min(estKeys, INTERNAL_MAX_KEYS);
+  PREFETCH_READ(keys + (n / 4) * 2 * sizeof(uint32_t));
+  PREFETCH_READ(keys + (n / 2) * 2 * sizeof(uint32_t));
+  PREFETCH_READ(keys + (3 * n / 4) * 2 * sizeof(uint32_t));
+}
+
 static_assert(sizeof(MetadataPage) == PAGE_SIZE,
               "MetadataPage must be PAGE_SIZE bytes");
 static_assert(sizeof(LeafNode) == PAGE_SIZE,
@@ -2,8 +2,12 @@
 #define PAGE_MANAGER_HPP
 
 #include "page.hpp"
+#include "policies.hpp"
+#include <atomic>
 #include <cstdio>
 #include <string>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -16,175 +20,341 @@
 
 #endif
 
-class PageManager {
-private:
+// READ_ONLY maps the files O_RDONLY / PROT_READ / MAP_SHARED, so any number of
+// reader processes share the writer's page cache with no private copies.
+enum class OpenMode : uint8_t { READ_WRITE = 0, READ_ONLY = 1 };
+
+// Resident-set tracking works on 2MB chunks of each mapping
+constexpr uint32_t RESIDENT_CHUNK_SHIFT = 21;
+constexpr size_t RESIDENT_CHUNK_SIZE = size_t(1) << RESIDENT_CHUNK_SHIFT;
+
+struct ResidentStats {
+  size_t budgetBytes = 0;   // Configured cap, 0 = unlimited
+  size_t trackedBytes = 0;  // Chunks touched since they were last evicted
+  size_t residentBytes = 0; // Pages actually in memory (mincore)
+  uint64_t evictedChunks = 0;
+};
+
+// One backing file of the index. A single-file index has exactly one stripe;
+// a striped index spreads page ids round-robin over several of them.
+struct Stripe {
   std::string filename;
-  uint8_t *mappedData;
-  size_t mappedSize;
-  size_t fileCapacity;
+  uint8_t *mappedData = nullptr;
+  size_t mappedSize = 0;
+  size_t fileCapacity = 0;
 
 #ifdef _WIN32
-  HANDLE hFile;
-  HANDLE hMapping;
+  HANDLE hFile = INVALID_HANDLE_VALUE;
+  HANDLE hMapping = nullptr;
 #else
-  int fd;
+  int fd = -1;
 #endif
 
+  // Coarse last-access tick per chunk, 0 = not resident as far as we know.
+  // Only maintained while a resident budget is set.
+  std::vector<std::atomic<uint32_t>> chunkTick;
+};
+
+// Storage is one of the storage policies in policies.hpp; it is told about
+// every mapping this manager creates and is given it back before unmapping.
+template <typename Storage = MmapStorage> class BasicPageManager {
+private:
+  std::vector<Stripe> stripes;
+  uint32_t numStripes;
+  bool readOnly;
+  bool recoveryNeeded; // Writer opened an unclean or pre-versioned file
+  uint64_t seenEpoch;  // Last writer epoch observed by refresh()
+  // Readers: remap inside getPage when a page lies past the mapping. Off
+  // when threads share the manager, as a remap moves pages they may hold;
+  // getPage then returns nullptr and flags mappingShort for refresh().
+  bool remapOnDemand;
+  std::atomic<bool> mappingShort;
+
+  // Resident-set budget (0 = unlimited)
+  size_t budgetChunks;
+  bool releaseOnEvict; // DONTNEED + drop page cache, else MADV_COLD
+  std::atomic<uint64_t> accessCount;
+  std::atomic<uint64_t> evictedChunks;
+  uint32_t allocsSinceCheck; // Writer only
+
+  struct EvictCandidate {
+    uint32_t tick;
+    uint32_t stripe;
+    size_t chunk;
+  };
+  std::vector<EvictCandidate> evictScratch; // Reused by enforceBudget
+  // Chunks evicted while dirty; sync() drops them from the page cache once
+  // they are written back
+  std::vector<EvictCandidate> pendingRelease;
+
   static constexpr size_t INITIAL_PAGES = 8192; // Start with 8192 pages (32MB)
   static constexpr size_t GROWTH_FACTOR = 2;
+  // Page allocations per budget check: one chunk's worth
+  static constexpr uint32_t ENFORCE_INTERVAL = RESIDENT_CHUNK_SIZE / PAGE_SIZE;
 
 public:
-  PageManager()
-      : mappedData(nullptr), mappedSize(0), fileCapacity(0)
-#ifdef _WIN32
-        ,
-        hFile(INVALID_HANDLE_VALUE), hMapping(nullptr)
-#else
-        ,
-        fd(-1)
-#endif
-  {
-  }
-
-  ~PageManager() { close(); }
-
-  bool open(const std::string &fname) {
-    filename = fname;
-    bool isNew = false;
+  BasicPageManager()
+      : numStripes(0), readOnly(false), recoveryNeeded(false), seenEpoch(0),
+        remapOnDemand(true), mappingShort(false), budgetChunks(0), releaseOnEvict(true), accessCount(0),
+        evictedChunks(0), allocsSinceCheck(0) {}
 
-#ifdef _WIN32
-    // Check if file exists
-    DWORD attrs = GetFileAttributesA(fname.c_str());
-    isNew = (attrs == INVALID_FILE_ATTRIBUTES);
+  ~BasicPageManager() { close(); }
 
-    // Open or create file
-    hFile = CreateFileA(fname.c_str(), GENERIC_READ | GENERIC_WRITE,
-                        FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
-                        FILE_ATTRIBUTE_NORMAL, nullptr);
+  bool open(const std::string &fname,
+            OpenMode mode = OpenMode::READ_WRITE) {
+    return open(std::vector<std::string>{fname}, mode);
+  }
 
-    if (hFile == INVALID_HANDLE_VALUE)
+  // STRIPING: page id P lives in file (P % N) at local page (P / N).
+  // Consecutive pages land on different devices, so leaf-chain scans and
+  // random faults are spread across all of them. Each file grows on its own.
+  bool open(const std::vector<std::string> &fnames,
+            OpenMode mode = OpenMode::READ_WRITE) {
+    if (fnames.empty() || numStripes != 0)
       return false;
 
-    // Get file size
-    LARGE_INTEGER size;
-    GetFileSizeEx(hFile, &size);
-
-    if (size.QuadPart == 0) {
-      isNew = true;
-      fileCapacity = INITIAL_PAGES * PAGE_SIZE;
-
-      // Extend file
-      LARGE_INTEGER newSize;
-      newSize.QuadPart = fileCapacity;
-      SetFilePointerEx(hFile, newSize, nullptr, FILE_BEGIN);
-      SetEndOfFile(hFile);
-    } else {
-      fileCapacity = size.QuadPart;
+    readOnly = (mode == OpenMode::READ_ONLY);
+    mappingShort.store(false, std::memory_order_relaxed);
+
+    const size_t n = fnames.size();
+    const size_t initialPages = std::max<size_t>(INITIAL_PAGES / n, 64);
+
+    stripes.resize(n);
+    std::vector<bool> stripeNew(n, false);
+    size_t created = 0;
+    // Any failure removes the files created here again, so a retry does
+    // not find a set that is partly new
+    auto abandon = [&]() {
+      closeStripes();
+      for (size_t i = 0; i < n; i++) {
+        if (stripeNew[i])
+          std::remove(fnames[i].c_str());
+      }
+      return false;
+    };
+    for (size_t i = 0; i < n; i++) {
+      bool fresh = false;
+      stripes[i].filename = fnames[i];
+      const bool opened = openStripe(stripes[i], initialPages, readOnly, fresh);
+      stripeNew[i] = fresh;
+      if (!opened)
+        return abandon();
+      created += fresh ? 1 : 0;
+    }
+    // A missing stripe next to existing ones (an absent mount, a deleted
+    // file) must not be filled with zeros, nor a new stripe 0 initialised
+    // over live data: all stripes are new or none is.
+    if (created != 0 && created != n)
+      return abandon();
+    const bool isNew = created == n;
+    numStripes = static_cast<uint32_t>(n);
+    if (budgetChunks != 0) {
+      for (Stripe &s : stripes)
+        resizeChunkTicks(s);
     }
 
-    mappedSize = fileCapacity;
-
-    // Create mapping
-    hMapping =
-        CreateFileMappingA(hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr);
-    if (!hMapping) {
-      CloseHandle(hFile);
+    // Initialize metadata if new file
+    MetadataPage *meta = getMetadata();
+    recoveryNeeded = false;
+    if (isNew) {
+      meta->init();
+      meta->numStripes = numStripes;
+    } else if (!meta || !meta->isCompatible() ||
+               meta->stripeCount() != numStripes) {
+      // Foreign format, or a different file set than the index was created
+      // with. Nothing has been written yet, so just drop the mappings.
+      closeStripes();
       return false;
+    } else if (!readOnly) {
+      // Constant-time startup: a clean file is trusted as-is. An unclean
+      // one only needs recovery if it was modified after its last sync.
+      bool dirty = !meta->cleanShutdown && meta->lsn != meta->checkpointLsn;
+      recoveryNeeded = meta->isLegacy() || dirty;
+      if (meta->isLegacy())
+        meta->initHeader();
     }
 
-    // Map view
-    mappedData = static_cast<uint8_t *>(
-        MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
-    if (!mappedData) {
-      CloseHandle(hMapping);
-      CloseHandle(hFile);
-      return false;
+    if (!readOnly) {
+      // Stays 0 on disk until close() completes
+      meta->cleanShutdown = 0;
+      flushMetadata();
     }
-#else
-    struct stat st;
-    isNew = (stat(fname.c_str(), &st) != 0);
 
-    fd = ::open(fname.c_str(), O_RDWR | O_CREAT, 0644);
-    if (fd < 0)
+    seenEpoch = meta->loadEpoch();
+    return true;
+  }
+
+  bool isReadOnly() const { return readOnly; }
+
+  // Threads sharing a read-only manager turn this off and call refresh()
+  // under an exclusive lock whenever mappingIsShort() after a read.
+  void setRemapOnDemand(bool on) { remapOnDemand = on; }
+  bool mappingIsShort() const {
+    return mappingShort.load(std::memory_order_relaxed);
+  }
+
+  // Set after open() when the file was not cleanly closed since its last
+  // modification (or predates the versioned header). The caller should
+  // repair the structure before trusting the root.
+  bool needsRecovery() const { return recoveryNeeded; }
+  void clearRecoveryNeeded() { recoveryNeeded = false; }
+
+  // Cheap check for readers: returns true if the writer published a new
+  // version (root change or sync) since the last call. Stripes that the
+  // writer has grown are remapped to their current file size, so no other
+  // thread may be using the manager meanwhile.
+  bool refresh() {
+    MetadataPage *meta = getMetadata();
+    if (!meta)
       return false;
 
-    if (isNew || st.st_size == 0) {
-      fileCapacity = INITIAL_PAGES * PAGE_SIZE;
-      if (ftruncate(fd, fileCapacity) != 0) {
-        ::close(fd);
-        return false;
+    uint64_t epoch = meta->loadEpoch();
+    const bool wasShort =
+        mappingShort.exchange(false, std::memory_order_relaxed);
+    if (epoch == seenEpoch && !wasShort)
+      return false;
+    const bool changed = epoch != seenEpoch;
+    seenEpoch = epoch;
+
+    if (readOnly) {
+      for (Stripe &s : stripes) {
+        remapToFileSize(s, 0);
+        if (budgetChunks != 0)
+          resizeChunkTicks(s);
       }
-    } else {
-      fileCapacity = st.st_size;
     }
+    return changed;
+  }
 
-    mappedSize = fileCapacity;
+  void close() {
+    if (!readOnly && numStripes != 0) {
+      sync();
+      getMetadata()->cleanShutdown = 1;
+      flushMetadata();
+    }
+    closeStripes();
+  }
 
-    mappedData = static_cast<uint8_t *>(
-        mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  // Flush every stripe; with several devices the flushes run in parallel
+  void sync() {
+    if (readOnly)
+      return;
 
-    if (mappedData == MAP_FAILED) {
-      mappedData = nullptr;
-      ::close(fd);
-      return false;
-    }
+    MetadataPage *meta = getMetadata();
+    if (!meta)
+      return;
 
-    // PERFORMANCE: Give kernel hints about our access pattern
-    madvise(mappedData, mappedSize, MADV_RANDOM);
-    madvise(mappedData, PAGE_SIZE * 4, MADV_WILLNEED);
-#endif
+    // Publish a new version to readers in other processes
+    meta->bumpEpoch();
+    const uint64_t lsn = meta->lsn;
 
-    // Initialize metadata if new file
-    if (isNew) {
-      MetadataPage *meta = getMetadata();
-      meta->init();
+    if (numStripes == 1) {
+      syncStripe(stripes[0]);
+    } else {
+      std::vector<std::thread> workers;
+      workers.reserve(numStripes - 1);
+      for (uint32_t i = 1; i < numStripes; i++) {
+        Stripe *s = &stripes[i];
+        workers.emplace_back([s] { syncStripe(*s); });
+      }
+      syncStripe(stripes[0]);
+      for (auto &w : workers)
+        w.join();
     }
-
-    return true;
+    // Written back just now, so evicted chunks can leave the page cache
+    trimToBudget();
+    releaseWrittenBack();
+
+    // Everything up to lsn is on disk; record that only after the flush
+    meta = getMetadata();
+    meta->checkpointLsn = lsn;
+    flushMetadata();
   }
 
-  void close() {
-    if (mappedData) {
-#ifdef _WIN32
-      FlushViewOfFile(mappedData, 0);
-      UnmapViewOfFile(mappedData);
-      if (hMapping)
-        CloseHandle(hMapping);
-      if (hFile != INVALID_HANDLE_VALUE)
-        CloseHandle(hFile);
-      hFile = INVALID_HANDLE_VALUE;
-      hMapping = nullptr;
-#else
-      msync(mappedData, mappedSize, MS_SYNC);
-      munmap(mappedData, mappedSize);
-      if (fd >= 0)
-        ::close(fd);
-      fd = -1;
-#endif
-      mappedData = nullptr;
+  uint32_t getStripeCount() const { return numStripes; }
+
+  // MEMORY BUDGET: cap the part of the mapping this process keeps resident.
+  // Accesses only stamp a per-2MB-chunk tick. The coldest chunks beyond the
+  // budget are evicted by the writer, every ENFORCE_INTERVAL page
+  // allocations and on sync(), and by trimToBudget(), which read-only
+  // processes call themselves. Internal nodes are touched on every
+  // descent, so in practice cold leaf ranges go first.
+  //   release = true : start write-back, MADV_DONTNEED and drop from cache
+  //   release = false: MADV_COLD, the kernel reclaims them first under
+  //                    pressure (falls back to release where unsupported)
+  // Pass 0 to disable.
+  void setResidentBudget(size_t bytes, bool release = true) {
+    budgetChunks = (bytes + RESIDENT_CHUNK_SIZE - 1) / RESIDENT_CHUNK_SIZE;
+    if (bytes != 0 && budgetChunks < 2)
+      budgetChunks = 2; // Metadata chunk plus at least one working chunk
+    releaseOnEvict = release;
+    for (Stripe &s : stripes) {
+      if (budgetChunks == 0)
+        s.chunkTick.clear();
+      else
+        resizeChunkTicks(s);
     }
   }
 
-  void sync() {
-    if (mappedData) {
-#ifdef _WIN32
-      FlushViewOfFile(mappedData, 0);
-#else
-      msync(mappedData, mappedSize, MS_SYNC);
+  // Evict down to the budget now
+  void trimToBudget() {
+    if (budgetChunks != 0)
+      enforceBudget();
+  }
+
+  ResidentStats residentStats() const {
+    ResidentStats st;
+    st.budgetBytes = budgetChunks * RESIDENT_CHUNK_SIZE;
+    st.evictedChunks = evictedChunks.load(std::memory_order_relaxed);
+    for (const Stripe &s : stripes) {
+      for (const auto &t : s.chunkTick) {
+        if (t.load(std::memory_order_relaxed) != 0)
+          st.trackedBytes += RESIDENT_CHUNK_SIZE;
+      }
+#ifndef _WIN32
+      if (s.mappedData) {
+        std::vector<unsigned char> vec((s.mappedSize + PAGE_SIZE - 1) /
+                                       PAGE_SIZE);
+        if (mincore(s.mappedData, s.mappedSize, vec.data()) == 0) {
+          for (unsigned char v : vec)
+            st.residentBytes += (v & 1) ? PAGE_SIZE : 0;
+        }
+      }
 #endif
     }
+    return st;
   }
 
   // Get page by ID (0 = metadata, 1+ = tree nodes)
   void *getPage(uint32_t pageId) {
-    if (!mappedData)
+    if (UNLIKELY(numStripes == 0))
       return nullptr;
-    size_t offset = static_cast<size_t>(pageId) * PAGE_SIZE;
-    if (offset >= mappedSize) {
-      if (!grow(pageId + 1))
+
+    Stripe *s;
+    size_t offset;
+    if (LIKELY(numStripes == 1)) {
+      s = &stripes[0];
+      offset = static_cast<size_t>(pageId) * PAGE_SIZE;
+    } else {
+      s = &stripes[pageId % numStripes];
+      offset = static_cast<size_t>(pageId / numStripes) * PAGE_SIZE;
+    }
+
+    if (offset >= s->mappedSize) {
+      size_t required = offset / PAGE_SIZE + 1;
+      if (readOnly && !remapOnDemand) {
+        mappingShort.store(true, std::memory_order_relaxed);
+        return nullptr;
+      }
+      if (readOnly ? !remapToFileSize(*s, required) : !grow(*s, required))
         return nullptr;
+      if (budgetChunks != 0)
+        resizeChunkTicks(*s);
     }
-    return mappedData + offset;
+
+    if (UNLIKELY(budgetChunks != 0))
+      noteAccess(*s, offset);
+    return s->mappedData + offset;
   }
 
   MetadataPage *getMetadata() {
@@ -202,7 +372,7 @@ public:
   // Allocate a new page
   uint32_t allocatePage() {
     MetadataPage *meta = getMetadata();
-    if (!meta)
+    if (!meta || readOnly)
       return INVALID_PAGE;
 
     uint32_t newPageId;
@@ -215,25 +385,44 @@ public:
       meta->freeListHead = *nextFree;
     } else {
       newPageId = meta->numPages;
-      meta->numPages++;
 
-      // Ensure file is large enough
-      size_t requiredSize = static_cast<size_t>(meta->numPages) * PAGE_SIZE;
-      if (requiredSize > mappedSize) {
-        if (!grow(meta->numPages)) {
-          meta->numPages--;
-          return INVALID_PAGE;
-        }
-      }
+      // Ensure the owning stripe is large enough; only that file grows
+      if (!getPage(newPageId))
+        return INVALID_PAGE;
+      meta = getMetadata(); // stripe 0 may have been remapped
+      meta->numPages++;
     }
 
+    noteAllocations(1);
     return newPageId;
   }
 
+  // Allocate `count` consecutive never-used pages at the end of the file,
+  // growing each stripe once up front; the free list is not consulted.
+  // Returns the first page id, or INVALID_PAGE.
+  uint32_t allocateRange(uint32_t count) {
+    MetadataPage *meta = getMetadata();
+    if (!meta || readOnly || count == 0)
+      return INVALID_PAGE;
+    const uint32_t first = meta->numPages;
+    if (uint64_t(first) + count >= INVALID_PAGE)
+      return INVALID_PAGE;
+
+    // The last page of the range in each stripe it spans
+    for (uint32_t i = 0; i < std::min(count, numStripes); i++) {
+      if (!getPage(first + count - 1 - i))
+        return INVALID_PAGE;
+    }
+    meta = getMetadata(); // stripe 0 may have been remapped
+    meta->numPages += count;
+    noteAllocations(count);
+    return first;
+  }
+
   // Free a page
   void freePage(uint32_t pageId) {
     MetadataPage *meta = getMetadata();
-    if (!meta || pageId == 0)
+    if (!meta || readOnly || pageId == 0)
       return;
 
     // Add to free list
@@ -242,62 +431,400 @@ public:
     meta->freeListHead = pageId;
   }
 
+  // Length of the free list; walks it, so meant for checks and tests
+  uint32_t freePageCount() {
+    MetadataPage *meta = getMetadata();
+    if (!meta)
+      return 0;
+    uint32_t n = 0;
+    for (uint32_t id = meta->freeListHead;
+         id != INVALID_PAGE && n < meta->numPages; n++)
+      id = *static_cast<const uint32_t *>(getPage(id));
+    return n;
+  }
+
 private:
-  bool grow(uint32_t requiredPages) {
-    size_t newSize = fileCapacity;
-    while (newSize < static_cast<size_t>(requiredPages) * PAGE_SIZE) {
+  FORCE_INLINE void noteAccess(Stripe &s, size_t offset) {
+    uint64_t n = accessCount.fetch_add(1, std::memory_order_relaxed);
+    uint32_t tick = static_cast<uint32_t>(n >> 6) | 1; // never 0
+    size_t chunk = offset >> RESIDENT_CHUNK_SHIFT;
+    if (LIKELY(chunk < s.chunkTick.size()))
+      s.chunkTick[chunk].store(tick, std::memory_order_relaxed);
+  }
+
+  FORCE_INLINE void noteAllocations(uint32_t count) {
+    if (LIKELY(budgetChunks == 0))
+      return;
+    allocsSinceCheck += count;
+    if (allocsSinceCheck >= ENFORCE_INTERVAL) {
+      allocsSinceCheck = 0;
+      enforceBudget();
+    }
+  }
+
+  static void resizeChunkTicks(Stripe &s) {
+    size_t n = (s.mappedSize + RESIDENT_CHUNK_SIZE - 1) / RESIDENT_CHUNK_SIZE;
+    if (s.chunkTick.size() == n)
+      return;
+    std::vector<std::atomic<uint32_t>> fresh(n);
+    for (size_t i = 0; i < n; i++) {
+      uint32_t t = i < s.chunkTick.size()
+                       ? s.chunkTick[i].load(std::memory_order_relaxed)
+                       : 0;
+      fresh[i].store(t, std::memory_order_relaxed);
+    }
+    s.chunkTick.swap(fresh);
+  }
+
+  void enforceBudget() {
+    std::vector<EvictCandidate> &resident = evictScratch;
+    resident.clear();
+    for (uint32_t si = 0; si < numStripes; si++) {
+      Stripe &s = stripes[si];
+      for (size_t c = 0; c < s.chunkTick.size(); c++) {
+        uint32_t t = s.chunkTick[c].load(std::memory_order_relaxed);
+        if (t != 0 && !(si == 0 && c == 0)) // Metadata chunk stays
+          resident.push_back({t, si, c});
+      }
+    }
+
+    // One slot of the budget is the metadata chunk
+    if (resident.size() + 1 <= budgetChunks)
+      return;
+    size_t excess = resident.size() + 1 - budgetChunks;
+    std::nth_element(resident.begin(), resident.begin() + (excess - 1),
+                     resident.end(),
+                     [](const EvictCandidate &a, const EvictCandidate &b) {
+                       return a.tick < b.tick;
+                     });
+    for (size_t i = 0; i < excess; i++)
+      evictChunk(stripes[resident[i].stripe], resident[i].chunk);
+  }
+
+  void evictChunk(Stripe &s, size_t chunk) {
+    size_t offset = chunk << RESIDENT_CHUNK_SHIFT;
+    if (offset >= s.mappedSize)
+      return;
+    size_t len = std::min(RESIDENT_CHUNK_SIZE, s.mappedSize - offset);
+    s.chunkTick[chunk].store(0, std::memory_order_relaxed);
+    evictedChunks.fetch_add(1, std::memory_order_relaxed);
+
+#ifndef _WIN32
+    uint8_t *addr = s.mappedData + offset;
+#ifdef MADV_COLD
+    if (!releaseOnEvict && madvise(addr, len, MADV_COLD) == 0)
+      return;
+#endif
+    // Dropping a shared mapping keeps its dirty pages in the page cache;
+    // start their write-back so the fadvise below, or the one sync() repeats
+    // after flushing, can release them. Durability is still sync()'s job.
+    if (!readOnly) {
+      msync(addr, len, MS_ASYNC);
+      pendingRelease.push_back({0, static_cast<uint32_t>(&s - stripes.data()),
+                                chunk});
+    }
+    madvise(addr, len, MADV_DONTNEED);
+    posix_fadvise(s.fd, static_cast<off_t>(offset), static_cast<off_t>(len),
+                  POSIX_FADV_DONTNEED);
+#else
+    (void)len;
+#endif
+  }
+
+  // Drop chunks evicted since the last sync from the page cache, now that
+  // their pages are clean; ones touched again since are left alone
+  void releaseWrittenBack() {
+#ifndef _WIN32
+    for (const EvictCandidate &c : pendingRelease) {
+      Stripe &s = stripes[c.stripe];
+      size_t offset = c.chunk << RESIDENT_CHUNK_SHIFT;
+      if (c.chunk >= s.chunkTick.size() || offset >= s.mappedSize ||
+          s.chunkTick[c.chunk].load(std::memory_order_relaxed) != 0)
+        continue;
+      size_t len = std::min(RESIDENT_CHUNK_SIZE, s.mappedSize - offset);
+      posix_fadvise(s.fd, static_cast<off_t>(offset), static_cast<off_t>(len),
+                    POSIX_FADV_DONTNEED);
+    }
+#endif
+    pendingRelease.clear();
+  }
+
+  // Write just page 0 through to disk
+  void flushMetadata() {
+    if (numStripes == 0)
+      return;
+#ifdef _WIN32
+    FlushViewOfFile(stripes[0].mappedData, PAGE_SIZE);
+#else
+    msync(stripes[0].mappedData, PAGE_SIZE, MS_SYNC);
+#endif
+  }
+
+  static bool openStripe(Stripe &s, size_t initialPages, bool readOnly,
+                         bool &isNew) {
+    const std::string &fname = s.filename;
+
+#ifdef _WIN32
+    // Check if file exists
+    DWORD attrs = GetFileAttributesA(fname.c_str());
+    isNew = (attrs == INVALID_FILE_ATTRIBUTES);
+    if (readOnly && isNew)
+      return false;
+
+    // Open or create file
+    if (readOnly) {
+      s.hFile = CreateFileA(fname.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    } else {
+      s.hFile = CreateFileA(fname.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+
+    if (s.hFile == INVALID_HANDLE_VALUE)
+      return false;
+
+    // Get file size
+    LARGE_INTEGER size;
+    GetFileSizeEx(s.hFile, &size);
+
+    if (size.QuadPart == 0) {
+      if (readOnly) {
+        CloseHandle(s.hFile);
+        s.hFile = INVALID_HANDLE_VALUE;
+        return false;
+      }
+      isNew = true;
+      s.fileCapacity = initialPages * PAGE_SIZE;
+
+      // Extend file
+      LARGE_INTEGER newSize;
+      newSize.QuadPart = s.fileCapacity;
+      SetFilePointerEx(s.hFile, newSize, nullptr, FILE_BEGIN);
+      SetEndOfFile(s.hFile);
+    } else {
+      s.fileCapacity = size.QuadPart;
+    }
+
+    s.mappedSize = s.fileCapacity;
+
+    // Create mapping
+    s.hMapping = CreateFileMappingA(s.hFile, nullptr,
+                                    readOnly ? PAGE_READONLY : PAGE_READWRITE,
+                                    0, 0, nullptr);
+    if (!s.hMapping) {
+      CloseHandle(s.hFile);
+      s.hFile = INVALID_HANDLE_VALUE;
+      return false;
+    }
+
+    // Map view
+    s.mappedData = static_cast<uint8_t *>(MapViewOfFile(
+        s.hMapping, readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (!s.mappedData) {
+      CloseHandle(s.hMapping);
+      CloseHandle(s.hFile);
+      s.hMapping = nullptr;
+      s.hFile = INVALID_HANDLE_VALUE;
+      return false;
+    }
+    Storage::onMap(s.mappedData, s.mappedSize);
+#else
+    struct stat st;
+    isNew = (stat(fname.c_str(), &st) != 0);
+    if (readOnly && (isNew || st.st_size == 0))
+      return false;
+
+    s.fd = readOnly ? ::open(fname.c_str(), O_RDONLY)
+                    : ::open(fname.c_str(), O_RDWR | O_CREAT, 0644);
+    if (s.fd < 0)
+      return false;
+
+    if (isNew || st.st_size == 0) {
+      isNew = true;
+      s.fileCapacity = initialPages * PAGE_SIZE;
+      if (ftruncate(s.fd, s.fileCapacity) != 0) {
+        ::close(s.fd);
+        s.fd = -1;
+        return false;
+      }
+    } else {
+      s.fileCapacity = st.st_size;
+    }
+
+    s.mappedSize = s.fileCapacity;
+
+    const int prot = readOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    s.mappedData = static_cast<uint8_t *>(
+        mmap(nullptr, s.mappedSize, prot, MAP_SHARED, s.fd, 0));
+
+    if (s.mappedData == MAP_FAILED) {
+      s.mappedData = nullptr;
+      ::close(s.fd);
+      s.fd = -1;
+      return false;
+    }
+
+    // PERFORMANCE: Give kernel hints about our access pattern
+    madvise(s.mappedData, s.mappedSize, MADV_RANDOM);
+    madvise(s.mappedData, PAGE_SIZE * 4, MADV_WILLNEED);
+    Storage::onMap(s.mappedData, s.mappedSize);
+#endif
+
+    return true;
+  }
+
+  void closeStripes() {
+    pendingRelease.clear();
+    for (Stripe &s : stripes) {
+      if (s.mappedData) {
+        Storage::onUnmap(s.mappedData, s.mappedSize);
+#ifdef _WIN32
+        if (!readOnly)
+          FlushViewOfFile(s.mappedData, 0);
+        UnmapViewOfFile(s.mappedData);
+#else
+        if (!readOnly)
+          msync(s.mappedData, s.mappedSize, MS_SYNC);
+        munmap(s.mappedData, s.mappedSize);
+#endif
+        s.mappedData = nullptr;
+      }
+#ifdef _WIN32
+      if (s.hMapping)
+        CloseHandle(s.hMapping);
+      if (s.hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(s.hFile);
+      s.hFile = INVALID_HANDLE_VALUE;
+      s.hMapping = nullptr;
+#else
+      if (s.fd >= 0)
+        ::close(s.fd);
+      s.fd = -1;
+#endif
+    }
+    stripes.clear();
+    numStripes = 0;
+    readOnly = false;
+  }
+
+  static void syncStripe(Stripe &s) {
+    if (s.mappedData) {
+#ifdef _WIN32
+      FlushViewOfFile(s.mappedData, 0);
+#else
+      msync(s.mappedData, s.mappedSize, MS_SYNC);
+#endif
+    }
+  }
+
+  // Readers never extend files; they follow the writer's growth instead.
+  // Returns true if the stripe now covers at least requiredPages.
+  static bool remapToFileSize(Stripe &s, size_t requiredPages) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(s.hFile, &size))
+      return false;
+    size_t fileSize = static_cast<size_t>(size.QuadPart);
+#else
+    struct stat st;
+    if (fstat(s.fd, &st) != 0)
+      return false;
+    size_t fileSize = static_cast<size_t>(st.st_size);
+#endif
+    if (fileSize <= s.mappedSize)
+      return s.mappedSize >= requiredPages * PAGE_SIZE;
+
+    Storage::onUnmap(s.mappedData, s.mappedSize);
+#ifdef _WIN32
+    UnmapViewOfFile(s.mappedData);
+    CloseHandle(s.hMapping);
+    s.hMapping =
+        CreateFileMappingA(s.hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!s.hMapping)
+      return false;
+    s.mappedData = static_cast<uint8_t *>(
+        MapViewOfFile(s.hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!s.mappedData) {
+      CloseHandle(s.hMapping);
+      s.hMapping = nullptr;
+      return false;
+    }
+#else
+    void *newMap = mremap(s.mappedData, s.mappedSize, fileSize, MREMAP_MAYMOVE);
+    if (newMap == MAP_FAILED)
+      return false;
+    s.mappedData = static_cast<uint8_t *>(newMap);
+    madvise(s.mappedData, fileSize, MADV_RANDOM);
+#endif
+
+    s.fileCapacity = fileSize;
+    s.mappedSize = fileSize;
+    Storage::onMap(s.mappedData, s.mappedSize);
+    return s.mappedSize >= requiredPages * PAGE_SIZE;
+  }
+
+  static bool grow(Stripe &s, size_t requiredPages) {
+    size_t newSize = s.fileCapacity;
+    while (newSize < requiredPages * PAGE_SIZE) {
       newSize *= GROWTH_FACTOR;
     }
 
+    Storage::onUnmap(s.mappedData, s.mappedSize);
 #ifdef _WIN32
     // Unmap and remap with new size
-    FlushViewOfFile(mappedData, 0);
-    UnmapViewOfFile(mappedData);
-    CloseHandle(hMapping);
+    FlushViewOfFile(s.mappedData, 0);
+    UnmapViewOfFile(s.mappedData);
+    CloseHandle(s.hMapping);
 
     // Extend file
     LARGE_INTEGER liNewSize;
     liNewSize.QuadPart = newSize;
-    SetFilePointerEx(hFile, liNewSize, nullptr, FILE_BEGIN);
-    SetEndOfFile(hFile);
+    SetFilePointerEx(s.hFile, liNewSize, nullptr, FILE_BEGIN);
+    SetEndOfFile(s.hFile);
 
     // Remap
-    hMapping =
-        CreateFileMappingA(hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr);
-    if (!hMapping)
+    s.hMapping =
+        CreateFileMappingA(s.hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (!s.hMapping)
       return false;
 
-    mappedData = static_cast<uint8_t *>(
-        MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
-    if (!mappedData) {
-      CloseHandle(hMapping);
+    s.mappedData = static_cast<uint8_t *>(
+        MapViewOfFile(s.hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (!s.mappedData) {
+      CloseHandle(s.hMapping);
+      s.hMapping = nullptr;
       return false;
     }
 #else
     // Extend file
-    if (ftruncate(fd, newSize) != 0)
+    if (ftruncate(s.fd, newSize) != 0)
       return false;
 
     // Remap
-    void *newMap = mremap(mappedData, mappedSize, newSize, MREMAP_MAYMOVE);
+    void *newMap = mremap(s.mappedData, s.mappedSize, newSize, MREMAP_MAYMOVE);
     if (newMap == MAP_FAILED) {
       // Fallback: unmap and remap
-      munmap(mappedData, mappedSize);
-      mappedData = static_cast<uint8_t *>(
-          mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
-      if (mappedData == MAP_FAILED) {
-        mappedData = nullptr;
+      munmap(s.mappedData, s.mappedSize);
+      s.mappedData = static_cast<uint8_t *>(
+          mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0));
+      if (s.mappedData == MAP_FAILED) {
+        s.mappedData = nullptr;
         return false;
       }
     } else {
-      mappedData = static_cast<uint8_t *>(newMap);
+      s.mappedData = static_cast<uint8_t *>(newMap);
     }
 #endif
 
-    fileCapacity = newSize;
-    mappedSize = newSize;
+    s.fileCapacity = newSize;
+    s.mappedSize = newSize;
+    Storage::onMap(s.mappedData, s.mappedSize);
     return true;
   }
 };
 
+using PageManager = BasicPageManager<>;
+
 #endif // PAGE_MANAGER_HPP
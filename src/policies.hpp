@@ -0,0 +1,236 @@
+#ifndef POLICIES_HPP
+#define POLICIES_HPP
+
+#include "page.hpp"
+#include <mutex>
+#include <shared_mutex>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// =============================================================================
+// POLICY CLASSES
+// =============================================================================
+//
+// BasicBPlusTree<Search, Storage, Locking, Split> and BasicPageManager<Storage>
+// take their cross-cutting choices as template parameters, so every call is
+// resolved at compile time and unused variants cost nothing. BPlusTree is the
+// default combination. Policies are stateless apart from Locking, which the
+// tree holds by value.
+
+// -----------------------------------------------------------------------------
+// SEARCH: in-node search.
+//   childIndex(node, key) - child to follow (number of separators <= key)
+//   leafSlot(leaf, key)   - slot holding key, or leaf->numKeys
+// -----------------------------------------------------------------------------
+
+// Binary search in internal nodes, SIMD linear scan in leaves
+struct DefaultSearch {
+  static FORCE_INLINE uint32_t childIndex(const InternalNode *node,
+                                          int32_t key) {
+    return node->findChildIndex(key);
+  }
+  static FORCE_INLINE uint32_t leafSlot(const LeafNode *leaf, int32_t key) {
+    return leaf->findKey(key);
+  }
+};
+
+// Binary search down to a small window, then SIMD over the interleaved
+// [child][key] words: one compare covers 4 keys (AVX2) or 2 (SSE2), with
+// the child lanes masked off. Promoted from experimental/bptree_simd.hpp.
+struct SimdSearch {
+  static constexpr uint32_t WINDOW = 16;
+
+  static FORCE_INLINE uint32_t childIndex(const InternalNode *node,
+                                          int32_t key) {
+    uint32_t lo = 0, hi = node->numKeys;
+    while (hi - lo > WINDOW) {
+      uint32_t mid = lo + ((hi - lo) >> 1);
+      if (key < node->getKey(mid))
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+
+    // First key in [lo, hi) greater than key
+    const int32_t *words = reinterpret_cast<const int32_t *>(node->data);
+    uint32_t i = lo;
+#ifdef HAVE_AVX2
+    const __m256i target = _mm256_set1_epi32(key);
+    for (; i + 4 <= hi; i += 4) {
+      __m256i gt = _mm256_cmpgt_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + 2 * i)),
+          target);
+      int mask = _mm256_movemask_ps(_mm256_castsi256_ps(gt)) & 0xAA;
+      if (mask != 0)
+        return i + (__builtin_ctz(mask) >> 1);
+    }
+#elif defined(HAVE_SSE2)
+    const __m128i target = _mm_set1_epi32(key);
+    for (; i + 2 <= hi; i += 2) {
+      __m128i gt = _mm_cmpgt_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + 2 * i)),
+          target);
+      int mask = _mm_movemask_ps(_mm_castsi128_ps(gt)) & 0xA;
+      if (mask != 0)
+        return i + (__builtin_ctz(mask) >> 1);
+    }
+#endif
+    for (; i < hi; i++) {
+      if (key < node->getKey(i))
+        return i;
+    }
+    return hi;
+  }
+
+  static FORCE_INLINE uint32_t leafSlot(const LeafNode *leaf, int32_t key) {
+    return leaf->findKey(key);
+  }
+};
+
+// Scalar binary search everywhere: portable baseline for comparisons
+struct ScalarSearch {
+  static FORCE_INLINE uint32_t childIndex(const InternalNode *node,
+                                          int32_t key) {
+    return node->findChildIndex(key);
+  }
+  static FORCE_INLINE uint32_t leafSlot(const LeafNode *leaf, int32_t key) {
+    const int32_t *k = leaf->keys();
+    const uint32_t s = leaf->sortedCount();
+    const int32_t *p = std::lower_bound(k, k + s, key);
+    if (p != k + s && *p == key)
+      return static_cast<uint32_t>(p - k);
+    for (uint32_t i = s; i < leaf->numKeys; i++) {
+      if (k[i] == key)
+        return i;
+    }
+    return leaf->numKeys;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// STORAGE: hooks run when a stripe is mapped (open, growth, reader remap) and
+// just before it is unmapped. Nothing here is on the page access path.
+// -----------------------------------------------------------------------------
+
+// Plain shared file mapping
+struct MmapStorage {
+  static void onMap(uint8_t *, size_t) {}
+  static void onUnmap(uint8_t *, size_t) {}
+};
+
+// Transparent huge pages for the mapping: 512x fewer TLB entries on large
+// trees. Takes effect where the kernel supports THP for the file's
+// filesystem (tmpfs, or CONFIG_READ_ONLY_THP_FOR_FS); a no-op elsewhere.
+// Promoted from experimental/bptree_hugepages.hpp.
+struct HugePageStorage {
+  static void onMap(uint8_t *addr, size_t len) {
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+    madvise(addr, len, MADV_HUGEPAGE);
+#else
+    (void)addr;
+    (void)len;
+#endif
+  }
+  static void onUnmap(uint8_t *, size_t) {}
+};
+
+// Pin the whole mapping in RAM so lookups never fault. Needs a large enough
+// RLIMIT_MEMLOCK; if mlock fails the mapping simply stays unpinned. Do not
+// combine with a resident budget. Promoted from experimental/bptree_mlock.hpp.
+struct MlockStorage {
+  static void onMap(uint8_t *addr, size_t len) {
+#ifdef _WIN32
+    VirtualLock(addr, len);
+#else
+    mlock(addr, len);
+#endif
+  }
+  static void onUnmap(uint8_t *addr, size_t len) {
+#ifdef _WIN32
+    VirtualUnlock(addr, len);
+#else
+    munlock(addr, len);
+#endif
+  }
+};
+
+// -----------------------------------------------------------------------------
+// LOCKING: in-process concurrency. Public tree operations hold a ReadGuard
+// or WriteGuard for their duration. Pointers returned by readData and
+// readRangeData are only stable until the next write; threads sharing a
+// tree should use the copying readDataShared / readRangeShared.
+// -----------------------------------------------------------------------------
+
+// Single-threaded use (or external synchronisation): guards compile away
+struct NoLocking {
+  static constexpr bool concurrent = false;
+  struct ReadGuard {
+    explicit ReadGuard(NoLocking &) {}
+  };
+  struct WriteGuard {
+    explicit WriteGuard(NoLocking &) {}
+  };
+};
+
+// Many reader threads or one writer thread at a time
+class SharedMutexLocking {
+  std::shared_mutex mutex;
+
+public:
+  static constexpr bool concurrent = true;
+  class ReadGuard {
+    std::shared_lock<std::shared_mutex> lock;
+
+  public:
+    explicit ReadGuard(SharedMutexLocking &l) : lock(l.mutex) {}
+  };
+  class WriteGuard {
+    std::unique_lock<std::shared_mutex> lock;
+
+  public:
+    explicit WriteGuard(SharedMutexLocking &l) : lock(l.mutex) {}
+  };
+};
+
+// -----------------------------------------------------------------------------
+// SPLIT: how a full node chooses its split point
+//   MIDPOINT     - half and half (the classic B+ tree split)
+//   APPEND_AWARE - inserting past the last key keeps the left node full,
+//                  inserting before the first key keeps the right one full;
+//                  otherwise midpoint. Ideal for monotonic keys.
+//   FILL_FACTOR  - the left node keeps fillPercent of the entries, leaving
+//                  room for later random inserts
+//   ADAPTIVE     - APPEND_AWARE while recent inserts form an ascending or
+//                  descending run, FILL_FACTOR otherwise
+// RuntimeSplit follows setSplitPolicy(); FixedSplit bakes one in, so the
+// choice folds to constants.
+// -----------------------------------------------------------------------------
+enum class SplitPolicy : uint8_t {
+  MIDPOINT = 0,
+  APPEND_AWARE = 1,
+  FILL_FACTOR = 2,
+  ADAPTIVE = 3
+};
+
+struct RuntimeSplit {
+  static constexpr bool runtime = true;
+  static constexpr SplitPolicy policy = SplitPolicy::MIDPOINT;
+  static constexpr uint32_t fillPercent = 50;
+};
+
+template <SplitPolicy P, uint32_t FillPercent = 50> struct FixedSplit {
+  static_assert(FillPercent >= 1 && FillPercent <= 100,
+                "fill percent must be in [1, 100]");
+  static constexpr bool runtime = false;
+  static constexpr SplitPolicy policy = P;
+  static constexpr uint32_t fillPercent = FillPercent;
+};
+
+#endif // POLICIES_HPP
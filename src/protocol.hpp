@@ -0,0 +1,356 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include "page.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// =============================================================================
+// WIRE PROTOCOL for bptree_server (Unix domain sockets, so host byte order)
+// =============================================================================
+//
+// Every message is a frame: [u32 len][u8 op or status][len - 1 body bytes].
+// Clients may send any number of requests before reading; responses come
+// back in request order, one per request.
+//
+//   op     request body                  OK response body
+//   GET    i32 key                       value[DATA_SIZE]
+//   PUT    i32 key, value[DATA_SIZE]     -
+//   DEL    i32 key                       -
+//   RANGE  i32 lo, i32 hi                u32 n, n * value[DATA_SIZE]
+//   MGET   u32 n, n * i32 key            u32 n, n * u8 found,
+//                                        value[DATA_SIZE] per found key
+//   MPUT   u32 n, n * (i32, value)       u32 written (also sent with ERROR)
+//
+// GET and DEL answer NOT_FOUND for a missing key. ERROR means the request
+// could not be carried out (read-only index, allocation failure, result too
+// large). A malformed frame closes the connection.
+
+enum class Op : uint8_t {
+  GET = 1,
+  PUT = 2,
+  DEL = 3,
+  RANGE = 4,
+  MGET = 5,
+  MPUT = 6
+};
+
+enum class Status : uint8_t { OK = 0, NOT_FOUND = 1, ERROR = 2 };
+
+constexpr uint32_t FRAME_HEADER_SIZE = 5;       // u32 len + u8 op/status
+constexpr uint32_t MAX_FRAME_SIZE = 64u << 20;  // Bytes after the length
+constexpr uint32_t MAX_MULTI_KEYS = 1u << 16;   // Keys per MGET / MPUT
+constexpr uint32_t MAX_RANGE_RESULTS =
+    (MAX_FRAME_SIZE - FRAME_HEADER_SIZE) / DATA_SIZE;
+
+enum class ParseResult : uint8_t { COMPLETE, INCOMPLETE, MALFORMED };
+
+// A decoded frame; body points into the caller's buffer
+struct Frame {
+  uint8_t code; // Op for requests, Status for responses
+  const uint8_t *body;
+  uint32_t bodyLen;
+};
+
+inline int32_t readI32(const uint8_t *p) {
+  int32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t readU32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Decode the frame at buf. On COMPLETE, frameSize is the number of bytes
+// it occupies. Checks the length only; see requestWellFormed for bodies.
+inline ParseResult parseFrame(const uint8_t *buf, size_t avail, Frame &f,
+                              size_t &frameSize) {
+  if (avail < FRAME_HEADER_SIZE)
+    return ParseResult::INCOMPLETE;
+  uint32_t len = readU32(buf);
+  if (len == 0 || len > MAX_FRAME_SIZE)
+    return ParseResult::MALFORMED;
+  if (avail < 4 + size_t(len))
+    return ParseResult::INCOMPLETE;
+  f.code = buf[4];
+  f.body = buf + FRAME_HEADER_SIZE;
+  f.bodyLen = len - 1;
+  frameSize = 4 + size_t(len);
+  return ParseResult::COMPLETE;
+}
+
+inline bool requestWellFormed(const Frame &f) {
+  switch (static_cast<Op>(f.code)) {
+  case Op::GET:
+  case Op::DEL:
+    return f.bodyLen == 4;
+  case Op::PUT:
+    return f.bodyLen == 4 + DATA_SIZE;
+  case Op::RANGE:
+    return f.bodyLen == 8;
+  case Op::MGET: {
+    if (f.bodyLen < 4)
+      return false;
+    uint32_t n = readU32(f.body);
+    return n <= MAX_MULTI_KEYS && f.bodyLen == 4 + size_t(n) * 4;
+  }
+  case Op::MPUT: {
+    if (f.bodyLen < 4)
+      return false;
+    uint32_t n = readU32(f.body);
+    return n <= MAX_MULTI_KEYS &&
+           f.bodyLen == 4 + size_t(n) * (4 + DATA_SIZE);
+  }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Encoding. Frames are appended to out; beginFrame returns the offset that
+// endFrame patches with the final length.
+// -----------------------------------------------------------------------------
+
+inline size_t beginFrame(std::vector<uint8_t> &out, uint8_t code) {
+  size_t at = out.size();
+  out.resize(at + FRAME_HEADER_SIZE);
+  out[at + 4] = code;
+  return at;
+}
+
+inline void endFrame(std::vector<uint8_t> &out, size_t at) {
+  uint32_t len = static_cast<uint32_t>(out.size() - at - 4);
+  std::memcpy(out.data() + at, &len, sizeof(len));
+}
+
+inline void appendBytes(std::vector<uint8_t> &out, const void *p, size_t n) {
+  const uint8_t *b = static_cast<const uint8_t *>(p);
+  out.insert(out.end(), b, b + n);
+}
+
+inline void appendI32(std::vector<uint8_t> &out, int32_t v) {
+  appendBytes(out, &v, sizeof(v));
+}
+
+inline void appendU32(std::vector<uint8_t> &out, uint32_t v) {
+  appendBytes(out, &v, sizeof(v));
+}
+
+inline void encodeGet(std::vector<uint8_t> &out, int32_t key) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::GET));
+  appendI32(out, key);
+  endFrame(out, at);
+}
+
+inline void encodePut(std::vector<uint8_t> &out, int32_t key,
+                      const uint8_t *value) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::PUT));
+  appendI32(out, key);
+  appendBytes(out, value, DATA_SIZE);
+  endFrame(out, at);
+}
+
+inline void encodeDelete(std::vector<uint8_t> &out, int32_t key) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::DEL));
+  appendI32(out, key);
+  endFrame(out, at);
+}
+
+inline void encodeRange(std::vector<uint8_t> &out, int32_t lo, int32_t hi) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::RANGE));
+  appendI32(out, lo);
+  appendI32(out, hi);
+  endFrame(out, at);
+}
+
+inline void encodeMultiGet(std::vector<uint8_t> &out, const int32_t *keys,
+                           uint32_t n) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::MGET));
+  appendU32(out, n);
+  appendBytes(out, keys, size_t(n) * 4);
+  endFrame(out, at);
+}
+
+inline void encodeMultiPut(std::vector<uint8_t> &out, const int32_t *keys,
+                           const uint8_t *values, uint32_t n) {
+  size_t at = beginFrame(out, static_cast<uint8_t>(Op::MPUT));
+  appendU32(out, n);
+  for (uint32_t i = 0; i < n; i++) {
+    appendI32(out, keys[i]);
+    appendBytes(out, values + size_t(i) * DATA_SIZE, DATA_SIZE);
+  }
+  endFrame(out, at);
+}
+
+// -----------------------------------------------------------------------------
+// Key-range partitioning for the sharded server: [lo, hi] is cut into
+// `shards` contiguous, equally wide ranges; keys below lo belong to shard 0
+// and keys above hi to the last shard. Shard i listens on "<base>.<i>".
+// Clients that route by key reach the owner directly; any shard accepts
+// any request and forwards what it does not own.
+// -----------------------------------------------------------------------------
+struct ShardMap {
+  int32_t lo = INT32_MIN;
+  int32_t hi = INT32_MAX;
+  uint32_t shards = 1;
+
+  uint64_t span() const { return uint64_t(int64_t(hi) - lo) + 1; }
+
+  uint32_t shardOf(int32_t key) const {
+    if (key <= lo)
+      return 0;
+    if (key >= hi)
+      return shards - 1;
+    return static_cast<uint32_t>(uint64_t(int64_t(key) - lo) * shards /
+                                 span());
+  }
+
+  // Smallest and largest key owned by shard i
+  int32_t firstKey(uint32_t i) const {
+    if (i == 0)
+      return INT32_MIN;
+    return static_cast<int32_t>(lo + int64_t((i * span() + shards - 1) /
+                                             shards));
+  }
+  int32_t lastKey(uint32_t i) const {
+    return i + 1 >= shards ? INT32_MAX : firstKey(i + 1) - 1;
+  }
+
+  static std::string socketFor(const std::string &base, uint32_t i) {
+    return base + "." + std::to_string(i);
+  }
+};
+
+#ifndef _WIN32
+
+// -----------------------------------------------------------------------------
+// Blocking client. Requests are queued with the encode* helpers on out(),
+// sent by flush(), and answered in order by readResponse().
+// -----------------------------------------------------------------------------
+class RpcClient {
+  int fd = -1;
+  std::vector<uint8_t> pending;
+  std::vector<uint8_t> in;
+  size_t inStart = 0;
+
+public:
+  RpcClient() = default;
+  ~RpcClient() { close(); }
+  RpcClient(const RpcClient &) = delete;
+  RpcClient &operator=(const RpcClient &) = delete;
+
+  bool connect(const std::string &socketPath) {
+    close();
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path))
+      return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+      return false;
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+    pending.clear();
+    in.clear();
+    inStart = 0;
+  }
+
+  bool isConnected() const { return fd >= 0; }
+
+  // Buffer for queued requests
+  std::vector<uint8_t> &out() { return pending; }
+
+  bool flush() {
+    size_t off = 0;
+    while (off < pending.size()) {
+      ssize_t n = ::send(fd, pending.data() + off, pending.size() - off,
+                         MSG_NOSIGNAL);
+      if (n <= 0)
+        return false;
+      off += static_cast<size_t>(n);
+    }
+    pending.clear();
+    return true;
+  }
+
+  // Next response; its body stays valid until the following call
+  bool readResponse(Frame &f) {
+    if (inStart > 0 && inStart == in.size()) {
+      in.clear();
+      inStart = 0;
+    }
+    while (true) {
+      size_t frameSize;
+      ParseResult r =
+          parseFrame(in.data() + inStart, in.size() - inStart, f, frameSize);
+      if (r == ParseResult::COMPLETE) {
+        inStart += frameSize;
+        return true;
+      }
+      if (r == ParseResult::MALFORMED)
+        return false;
+
+      if (inStart > 0) { // Keep the partial frame at the front
+        in.erase(in.begin(), in.begin() + inStart);
+        inStart = 0;
+      }
+      size_t have = in.size();
+      in.resize(have + 64 * 1024);
+      ssize_t n = ::recv(fd, in.data() + have, in.size() - have, 0);
+      in.resize(have + (n > 0 ? static_cast<size_t>(n) : 0));
+      if (n <= 0)
+        return false;
+    }
+  }
+
+  // Single round trips. get() copies the value into out[DATA_SIZE].
+  Status get(int32_t key, uint8_t *value) {
+    encodeGet(pending, key);
+    Frame f;
+    if (!flush() || !readResponse(f))
+      return Status::ERROR;
+    if (f.code == static_cast<uint8_t>(Status::OK) && f.bodyLen == DATA_SIZE)
+      std::memcpy(value, f.body, DATA_SIZE);
+    return static_cast<Status>(f.code);
+  }
+
+  Status put(int32_t key, const uint8_t *value) {
+    encodePut(pending, key, value);
+    Frame f;
+    if (!flush() || !readResponse(f))
+      return Status::ERROR;
+    return static_cast<Status>(f.code);
+  }
+
+  Status remove(int32_t key) {
+    encodeDelete(pending, key);
+    Frame f;
+    if (!flush() || !readResponse(f))
+      return Status::ERROR;
+    return static_cast<Status>(f.code);
+  }
+};
+
+#endif // _WIN32
+
+#endif // PROTOCOL_HPP
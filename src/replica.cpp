@@ -0,0 +1,109 @@
+/**
+ * B+ Tree Replica
+ * Follows a primary's change stream into a local follower index
+ */
+
+#include "replica.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+static std::atomic<bool> stopping{false};
+
+static void onSignal(int) { stopping.store(true); }
+
+static void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "Usage: %s <primary-index> <follower-index> [options]\n"
+               "  --batch N     change records applied per batch (4096)\n"
+               "  --sync-ms N   flush the follower every N ms (1000)\n"
+               "  --once        catch up, report and exit\n"
+               "The primary must run with shared access and a change stream\n"
+               "(bptree_server --changes).\n",
+               argv0);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  uint32_t batch = 4096;
+  uint32_t syncMs = 1000;
+  bool once = false;
+  for (int i = 3; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--batch" && i + 1 < argc) {
+      batch = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--sync-ms" && i + 1 < argc) {
+      syncMs = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--once") {
+      once = true;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  Replica<BPlusTree> replica(batch);
+  auto start = std::chrono::steady_clock::now();
+  if (!replica.open(argv[1], argv[2])) {
+    std::fprintf(stderr, "Could not follow %s into %s\n", argv[1], argv[2]);
+    return 1;
+  }
+  std::printf("Following %s into %s from sequence %llu (%u records)\n",
+              argv[1], argv[2],
+              static_cast<unsigned long long>(replica.appliedSeq()),
+              replica.recordCount());
+  std::fflush(stdout);
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  bool ok = true;
+  if (once) {
+    ok = replica.catchUp();
+  } else {
+    auto lastSync = std::chrono::steady_clock::now();
+    uint64_t lastApplied = 0;
+    while (!stopping.load()) {
+      if (replica.poll(100) < 0) {
+        ok = false;
+        break;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (now - lastSync >= std::chrono::milliseconds(syncMs)) {
+        replica.sync();
+        const ReplicaStats &st = replica.statistics();
+        double s = std::chrono::duration<double>(now - lastSync).count();
+        std::printf("seq %llu, lag %llu, %.0f records/s, %llu resyncs\n",
+                    static_cast<unsigned long long>(replica.appliedSeq()),
+                    static_cast<unsigned long long>(replica.lag()),
+                    (st.applied - lastApplied) / s,
+                    static_cast<unsigned long long>(st.resyncs));
+        std::fflush(stdout);
+        lastApplied = st.applied;
+        lastSync = now;
+      }
+    }
+  }
+
+  const ReplicaStats &st = replica.statistics();
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  std::printf("Stopped at sequence %llu: %llu records applied in %llu "
+              "batches (%llu superseded), %llu resyncs (%llu records "
+              "copied), %.2f s\n",
+              static_cast<unsigned long long>(replica.appliedSeq()),
+              static_cast<unsigned long long>(st.applied),
+              static_cast<unsigned long long>(st.batches),
+              static_cast<unsigned long long>(st.superseded),
+              static_cast<unsigned long long>(st.resyncs),
+              static_cast<unsigned long long>(st.snapshotRecords), seconds);
+  replica.close();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+#ifndef REPLICA_HPP
+#define REPLICA_HPP
+
+#include "bptree.hpp"
+#include "change_stream.hpp"
+#include <cstdio>
+
+// =============================================================================
+// LOG-SHIPPING REPLICA
+// =============================================================================
+//
+// Keeps a local follower index up to date with a primary on the same host.
+// The primary enables shared access and a shared change stream; the replica
+// attaches to <primary>.changes and applies the records in batches. A batch
+// is reduced to the last change of each key (a put followed by a delete is
+// just the delete), sorted, and handed to one applySorted: a batch that is
+// small next to the follower goes leaf by leaf with one descent per leaf,
+// a large one (a backlog; catchUp takes everything pending at once) is
+// merge-joined with the leaf chain in a single sequential pass.
+//
+// The position applied so far is kept in the follower's metadata page. When
+// it is no longer in the ring (the replica was away too long, or is new) or
+// the follower was not closed cleanly, the replica resynchronises: it notes
+// the stream position, copies the primary in seqlock-validated chunks into a
+// freshly bulk-loaded follower, and replays the stream from the noted
+// position. Replaying a change the snapshot already holds is harmless
+// because puts and deletes are idempotent and applied in order.
+//
+// The follower is itself opened with shared access, so other processes can
+// open it read-only and serve lookups with readDataShared / readRangeShared.
+// A resync recreates the follower file; such readers have to reopen it.
+//
+// If the primary uses TTL leaves (the stream says so) the follower does too,
+// and both snapshots and stream records carry each record's expiry, so the
+// follower hides and sweeps records at the same time as the primary.
+
+struct ReplicaStats {
+  uint64_t applied = 0;         // Change records applied
+  uint64_t batches = 0;         // applySorted calls
+  uint64_t superseded = 0;      // Changes dropped for a later one of the key
+  uint64_t resyncs = 0;         // Snapshot copies
+  uint64_t snapshotRecords = 0; // Records copied by them
+};
+
+template <typename Tree = BPlusTree> class Replica {
+  Tree primary;  // Read-only view, used for snapshots only
+  Tree follower;
+  ChangeStream stream;
+  ChangeCursor cursor{stream};
+  std::string primaryFile;
+  std::string followerFile;
+  uint32_t batchLimit;
+  ReplicaStats stats;
+
+  std::vector<ChangeEvent> events;
+  std::vector<uint64_t> order; // Key (order-preserving) << 32 | event index
+  std::vector<uint64_t> scratch;
+  std::vector<int32_t> keys;
+  std::vector<uint8_t> values;
+  std::vector<uint32_t> expiries;
+  std::vector<const uint8_t *> sources; // Per record: value, nullptr = delete
+
+  static constexpr uint32_t SNAPSHOT_CHUNK = 4096;
+  // Leaf fill of snapshots and merge-joined batches: room for the puts
+  // that follow, so they do not split every leaf they land in
+  static constexpr uint32_t FOLLOWER_FILL = 75;
+
+public:
+  explicit Replica(uint32_t batch = 4096)
+      : batchLimit(std::max<uint32_t>(batch, 1)) {}
+  ~Replica() { close(); }
+
+  Replica(const Replica &) = delete;
+  Replica &operator=(const Replica &) = delete;
+
+  // Attach to a running primary (which has called enableSharedAccess and
+  // enableChangeStream) and bring the follower file up to its stream.
+  bool open(const std::string &primaryIndex, const std::string &followerIndex) {
+    primaryFile = primaryIndex;
+    followerFile = followerIndex;
+    if (!stream.attach(primaryIndex + ".changes"))
+      return false;
+    follower.setTtlLeaves(stream.flags() & CHANGE_FLAG_TTL);
+    if (!primary.open(primaryIndex, OpenMode::READ_ONLY) ||
+        !primary.enableSharedAccess() || !openFollower())
+      return false;
+
+    const uint64_t seq = follower.appliedChangeSeq();
+    if (seq == 0 || follower.lastRecovery().performed ||
+        seq < stream.oldestSeq() || seq > stream.nextSeq())
+      return resync();
+    cursor.seek(seq);
+    return true;
+  }
+
+  void close() {
+    if (stream.isActive())
+      follower.setAppliedChangeSeq(cursor.position());
+    follower.close();
+    primary.close();
+    stream.close();
+  }
+
+  // Apply up to one batch of changes, waiting up to timeoutMs for the first
+  // one. Falls back to a resync if the stream overran us. Returns the
+  // number of records applied, or -1 if a resync failed.
+  int64_t poll(uint32_t timeoutMs = 0) {
+    return pollUpTo(batchLimit, timeoutMs);
+  }
+
+  // Apply everything published so far, as one batch however large
+  bool catchUp() {
+    while (cursor.pending() > 0) {
+      const uint64_t pending = std::min<uint64_t>(cursor.pending(),
+                                                  stream.capacity());
+      if (pollUpTo(std::max<uint32_t>(batchLimit, uint32_t(pending)), 0) < 0)
+        return false;
+    }
+    return true;
+  }
+
+  // Flush the follower, including its stream position
+  void sync() { follower.sync(); }
+
+  // Copy the primary afresh and continue from the stream position taken
+  // before the copy started
+  bool resync() {
+    while (true) {
+      const uint64_t from = stream.nextSeq();
+      if (!snapshot())
+        return false;
+      if (stream.oldestSeq() > from)
+        continue; // The ring lapped the snapshot; replaying would miss records
+      follower.setAppliedChangeSeq(from);
+      follower.sync();
+      cursor.seek(from);
+      stats.resyncs++;
+      return true;
+    }
+  }
+
+  // Read-only lookups on the follower, from the thread that applies changes.
+  // Other processes read the follower file with readDataShared instead.
+  bool read(int32_t key, uint8_t *out) {
+    const uint8_t *v = follower.readData(key);
+    if (v)
+      std::memcpy(out, v, DATA_SIZE);
+    return v != nullptr;
+  }
+
+  std::vector<uint8_t *> readRange(int32_t lowerKey, int32_t upperKey,
+                                   uint32_t &n) {
+    return follower.readRangeData(lowerKey, upperKey, n);
+  }
+
+  // The follower's clock for expiries, as BPlusTree::pinClock
+  void pinClock(uint32_t now) { follower.pinClock(now); }
+
+  uint64_t appliedSeq() const { return cursor.position(); }
+  uint64_t lag() const { return cursor.pending(); }
+  uint32_t recordCount() const { return follower.getRecordCount(); }
+  const ReplicaStats &statistics() const { return stats; }
+
+private:
+  int64_t pollUpTo(uint32_t limit, uint32_t timeoutMs) {
+    events.resize(limit);
+    size_t n = timeoutMs ? cursor.pollWait(events.data(), limit, timeoutMs)
+                         : cursor.poll(events.data(), limit);
+    if (cursor.lagged())
+      return resync() ? 0 : -1;
+    if (n == 0)
+      return 0;
+    if (!apply(n))
+      return -1;
+    follower.setAppliedChangeSeq(cursor.position());
+    return static_cast<int64_t>(n);
+  }
+
+  bool openFollower() {
+    return follower.open(followerFile) && follower.enableSharedAccess();
+  }
+
+  bool snapshot() {
+    follower.close();
+    std::remove(followerFile.c_str());
+    if (!openFollower())
+      return false;
+    primary.refresh();
+
+    typename Tree::BulkLoader loader(follower, FOLLOWER_FILL);
+    int32_t from = INT32_MIN;
+    bool more = true;
+    while (more) {
+      more = primary.scanShared(from, SNAPSHOT_CHUNK, keys, values, &expiries);
+      for (size_t i = 0; i < keys.size(); i++) {
+        if (!loader.append(keys[i], values.data() + i * DATA_SIZE,
+                           expiries[i]))
+          return false;
+      }
+      stats.snapshotRecords += keys.size();
+      if (more)
+        from = keys.back() + 1; // Cut short, so keys.back() < INT32_MAX
+    }
+    return loader.appended() == 0 || loader.finish();
+  }
+
+  // Stable LSD radix sort of order[] on its key half, three 11-bit digits;
+  // event indices start ascending, so equal keys stay in stream order
+  void sortByKey() {
+    const size_t n = order.size();
+    if (n < 256) {
+      std::sort(order.begin(), order.end());
+      return;
+    }
+    scratch.resize(n);
+    for (uint32_t shift = 32; shift < 64; shift += 11) {
+      uint32_t counts[2049] = {};
+      for (uint64_t v : order)
+        counts[((v >> shift) & 2047) + 1]++;
+      for (uint32_t d = 1; d <= 2048; d++)
+        counts[d] += counts[d - 1];
+      for (uint64_t v : order)
+        scratch[counts[(v >> shift) & 2047]++] = v;
+      order.swap(scratch);
+    }
+  }
+
+  // Keep the last change of each key and apply the result as one ascending
+  // batch. Sorting packed (key, index) words keeps the sort in cache and
+  // leaves the latest change of a key last among its equals.
+  bool apply(size_t n) {
+    order.resize(n);
+    for (size_t i = 0; i < n; i++)
+      order[i] = uint64_t(uint32_t(events[i].key) ^ 0x80000000u) << 32 | i;
+    sortByKey();
+    keys.clear();
+    sources.clear();
+    expiries.clear();
+    for (size_t j = 0; j < n; j++) {
+      if (j + 1 < n && (order[j + 1] >> 32) == (order[j] >> 32))
+        continue; // Superseded within the batch
+      const ChangeEvent &e = events[uint32_t(order[j])];
+      const bool del = e.op == ChangeOp::DELETE;
+      keys.push_back(e.key);
+      sources.push_back(del ? nullptr : e.value);
+      expiries.push_back(del ? 0 : e.expiresAt);
+    }
+    if (!follower.applySorted(keys.data(), sources.data(), expiries.data(),
+                              keys.size(), FOLLOWER_FILL))
+      return false;
+    stats.batches++;
+    stats.superseded += n - keys.size();
+    stats.applied += n;
+    return true;
+  }
+};
+
+#endif // REPLICA_HPP
@@ -0,0 +1,125 @@
+/**
+ * B+ Tree Reshard
+ * Splits an index file at a key, or merges one index file into another
+ */
+
+#include "bptree.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "Usage: %s split <index> <key> <upper-index>\n"
+               "       %s merge <index> <other-index> [--fill 1-100]\n"
+               "split moves every record with a key >= <key> into the new\n"
+               "file <upper-index>. merge folds <other-index> into <index>;\n"
+               "its records win on equal keys. Neither index may be open in\n"
+               "a server while this runs.\n",
+               argv0, argv0);
+}
+
+static bool fileExists(const char *path) {
+  std::FILE *f = std::fopen(path, "rb");
+  if (f)
+    std::fclose(f);
+  return f != nullptr;
+}
+
+// Whole-string decimal integer in [lo, hi]
+static bool parseInt(const char *s, long long lo, long long hi,
+                     long long &out) {
+  char *end = nullptr;
+  out = std::strtoll(s, &end, 10);
+  return end != s && *end == '\0' && out >= lo && out <= hi;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    usage(argv[0]);
+    return 2;
+  }
+  const std::string command = argv[1];
+  const bool split = command == "split" && argc == 5;
+  long long key = 0;
+  long long fill = 100;
+  if (split) {
+    if (!parseInt(argv[3], INT32_MIN, INT32_MAX, key)) {
+      usage(argv[0]);
+      return 2;
+    }
+  } else if (command == "merge") {
+    for (int i = 4; i < argc; i++) {
+      if (std::string(argv[i]) != "--fill" || i + 1 == argc ||
+          !parseInt(argv[++i], 1, 100, fill)) {
+        usage(argv[0]);
+        return 2;
+      }
+    }
+  } else {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // open() creates a missing file; the source index has to exist
+  BPlusTree tree, other;
+  if (!fileExists(argv[2])) {
+    std::fprintf(stderr, "%s does not exist\n", argv[2]);
+    return 1;
+  }
+  if (!tree.open(argv[2])) {
+    std::fprintf(stderr, "Could not open %s\n", argv[2]);
+    return 1;
+  }
+
+  if (split) {
+    if (fileExists(argv[4])) {
+      std::fprintf(stderr, "%s already exists\n", argv[4]);
+      return 1;
+    }
+    if (!other.open(argv[4])) {
+      std::fprintf(stderr, "Could not create %s\n", argv[4]);
+      return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int64_t moved = tree.splitAt(static_cast<int32_t>(key), other);
+    if (moved < 0) {
+      std::fprintf(stderr, "Split failed; %s is unchanged\n", argv[2]);
+      other.close();
+      std::remove(argv[4]);
+      return 1;
+    }
+    std::printf("Moved %lld records to %s, %u left in %s, %.2f s\n",
+                static_cast<long long>(moved), argv[4], tree.getRecordCount(),
+                argv[2], secondsSince(start));
+  } else {
+    if (!fileExists(argv[3])) {
+      std::fprintf(stderr, "%s does not exist\n", argv[3]);
+      return 1;
+    }
+    if (!other.open(argv[3], OpenMode::READ_ONLY)) {
+      std::fprintf(stderr, "Could not open %s\n", argv[3]);
+      return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int64_t records = tree.merge(other, static_cast<uint32_t>(fill));
+    if (records < 0) {
+      std::fprintf(stderr, "Merge failed\n");
+      return 1;
+    }
+    std::printf("Merged %u records from %s: %lld records in %s, %.2f s\n",
+                other.getRecordCount(), argv[3],
+                static_cast<long long>(records), argv[2], secondsSince(start));
+  }
+
+  other.close();
+  tree.close();
+  return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * B+ Tree Server
+ * Serves one index file over a Unix domain socket (see protocol.hpp)
+ */
+
+#include "server.hpp"
+#include "sharded_server.hpp"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+static RpcServer<BPlusTree> *activeServer = nullptr;
+static ShardedServer<BPlusTree> *activeSharded = nullptr;
+
+static void onSignal(int) {
+  if (activeServer)
+    activeServer->stop();
+  if (activeSharded)
+    activeSharded->stop();
+}
+
+// Replicas snapshot through the seqlock and follow <index>.changes
+static bool enableChanges(BPlusTree &tree) {
+  return tree.enableSharedAccess() && tree.enableChangeStream();
+}
+
+template <typename Configure>
+static int serveSharded(const std::string &indexFile,
+                        const std::string &socketPath, const ShardMap &map,
+                        bool changes, Configure configure) {
+  ShardedServer<BPlusTree> server(map);
+  for (uint32_t i = 0; i < server.shardCount(); i++)
+    configure(server.tree(i));
+  if (!server.open(indexFile, socketPath)) {
+    std::fprintf(stderr,
+                 "Could not open shards %s.N on %s.N as %u shards of [%d, %d]"
+                 " (existing shard files must be reopened with the shard "
+                 "count and key range they were created with)\n",
+                 indexFile.c_str(), socketPath.c_str(), server.shardCount(),
+                 map.lo, map.hi);
+    return 1;
+  }
+  for (uint32_t i = 0; changes && i < server.shardCount(); i++) {
+    if (!enableChanges(server.tree(i))) {
+      std::fprintf(stderr, "Could not enable the change stream of shard %u\n",
+                   i);
+      return 1;
+    }
+  }
+
+  activeSharded = &server;
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::printf("Serving %u shards of [%d, %d] on %s.0 .. %s.%u\n",
+              server.shardCount(), map.lo, map.hi, socketPath.c_str(),
+              socketPath.c_str(), server.shardCount() - 1);
+  std::fflush(stdout);
+
+  server.start();
+  server.wait();
+  activeSharded = nullptr;
+
+  const ShardStats st = server.totals();
+  std::printf("Stopped: %llu connections, %llu requests, %llu forwarded "
+              "messages, %llu items\n",
+              static_cast<unsigned long long>(st.connections),
+              static_cast<unsigned long long>(st.requests),
+              static_cast<unsigned long long>(st.forwarded),
+              static_cast<unsigned long long>(st.items));
+  server.close();
+  return 0;
+}
+
+static void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "Usage: %s <index-file> [options]\n"
+               "  --socket PATH    socket to listen on (default "
+               "/tmp/bptree.sock)\n"
+               "  --tail N         unsorted leaf tail slots (0-16)\n"
+               "  --slotted        slotted-value leaves for new leaves\n"
+               "  --lazy-delete    tombstone deletes\n"
+               "  --changes        publish a change stream for bptree_replica\n"
+               "  --shards N       thread-per-core mode with N key-range "
+               "shards\n"
+               "                   (0 = one per core); files <index-file>.<i>,\n"
+               "                   sockets <socket>.<i>. The files record N and\n"
+               "                   the key range and must be reopened with both\n"
+               "  --key-range L:H  keys split evenly across shards "
+               "(default: all int32)\n",
+               argv0);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::string indexFile = argv[1];
+  std::string socketPath = "/tmp/bptree.sock";
+  uint32_t tailSlots = 0;
+  bool slotted = false, lazyDelete = false, sharded = false, changes = false;
+  ShardMap map;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--socket" && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else if (arg == "--tail" && i + 1 < argc) {
+      tailSlots = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (arg == "--slotted") {
+      slotted = true;
+    } else if (arg == "--lazy-delete") {
+      lazyDelete = true;
+    } else if (arg == "--changes") {
+      changes = true;
+    } else if (arg == "--shards" && i + 1 < argc) {
+      sharded = true;
+      map.shards = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (arg == "--key-range" && i + 1 < argc &&
+               std::sscanf(argv[++i], "%d:%d", &map.lo, &map.hi) == 2 &&
+               map.lo < map.hi) {
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  auto configure = [&](BPlusTree &t) {
+    t.setUnsortedTail(tailSlots);
+    t.setSlottedValues(slotted);
+    t.setLazyDelete(lazyDelete);
+  };
+  if (sharded)
+    return serveSharded(indexFile, socketPath, map, changes, configure);
+
+  BPlusTree tree;
+  configure(tree);
+
+  if (!tree.open(indexFile)) {
+    std::fprintf(stderr, "Could not open %s\n", indexFile.c_str());
+    return 1;
+  }
+  if (changes && !enableChanges(tree)) {
+    std::fprintf(stderr, "Could not enable the change stream of %s\n",
+                 indexFile.c_str());
+    return 1;
+  }
+
+  RpcServer<BPlusTree> server(tree);
+  if (!server.listen(socketPath)) {
+    std::fprintf(stderr, "Could not listen on %s\n", socketPath.c_str());
+    return 1;
+  }
+
+  activeServer = &server;
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::printf("Serving %s (%u records) on %s\n", indexFile.c_str(),
+              tree.getRecordCount(), socketPath.c_str());
+  std::fflush(stdout);
+
+  bool ok = server.run();
+  activeServer = nullptr;
+  server.close();
+
+  const ServerStats &st = server.statistics();
+  std::printf("Stopped: %llu connections, %llu requests, %llu batches "
+              "(%llu keys)\n",
+              static_cast<unsigned long long>(st.connections),
+              static_cast<unsigned long long>(st.requests),
+              static_cast<unsigned long long>(st.batches),
+              static_cast<unsigned long long>(st.batchedKeys));
+  tree.close();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "bptree.hpp"
+#include "protocol.hpp"
+#include <atomic>
+#include <cerrno>
+#include <unordered_map>
+
+#ifndef __linux__
+#error "RpcServer uses epoll and eventfd and needs Linux"
+#endif
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+// Non-blocking listening socket at path, replacing a stale socket file.
+// Returns the fd, or -1.
+inline int listenUnixSocket(const std::string &path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path))
+    return -1;
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    ::unlink(path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Input and output buffers of one non-blocking client socket. Input is
+// parsed in place from inStart; output is sent from outStart.
+struct ConnectionBuffers {
+  static constexpr size_t READ_CHUNK = 64 * 1024;
+
+  std::vector<uint8_t> in;
+  size_t inStart = 0;
+  std::vector<uint8_t> out;
+  size_t outStart = 0;
+  bool eof = false; // Peer shut down its side
+
+  size_t unsent() const { return out.size() - outStart; }
+
+  // Pull what the socket holds, up to about limit bytes buffered.
+  // Level-triggered callers get the rest with the next event. False on a
+  // socket error.
+  bool readFrom(int fd, size_t limit) {
+    if (inStart > 0) {
+      in.erase(in.begin(), in.begin() + inStart);
+      inStart = 0;
+    }
+    while (true) {
+      size_t have = in.size();
+      in.resize(have + READ_CHUNK);
+      ssize_t n = ::recv(fd, in.data() + have, READ_CHUNK, 0);
+      in.resize(have + (n > 0 ? static_cast<size_t>(n) : 0));
+      if (n > 0) {
+        if (in.size() < limit)
+          continue;
+        return true;
+      }
+      if (n == 0) {
+        eof = true;
+        return true;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+  }
+
+  // Send as much as the socket takes. False on a socket error.
+  bool sendTo(int fd) {
+    while (outStart < out.size()) {
+      ssize_t n = ::send(fd, out.data() + outStart, out.size() - outStart,
+                         MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      outStart += static_cast<size_t>(n);
+    }
+    out.clear();
+    outStart = 0;
+    return true;
+  }
+
+  // Next complete frame at inStart, without consuming it
+  ParseResult peek(Frame &f, size_t &size) const {
+    return parseFrame(in.data() + inStart, in.size() - inStart, f, size);
+  }
+};
+
+// Epoll interest for a connection: input while there is room to answer it,
+// output while anything is unsent
+inline uint32_t connectionInterest(const ConnectionBuffers &io,
+                                   size_t highWater) {
+  uint32_t want = 0;
+  if (io.unsent())
+    want |= EPOLLOUT;
+  if (!io.eof && io.unsent() < highWater)
+    want |= EPOLLIN;
+  return want;
+}
+
+struct ServerStats {
+  uint64_t connections = 0; // Accepted so far
+  uint64_t requests = 0;    // Frames answered
+  uint64_t batches = 0;     // readBatch / writeBatch calls made
+  uint64_t batchedKeys = 0; // Keys that went through them
+};
+
+// EPOLL SERVER: one thread, one event loop, one tree (so the tree needs no
+// locking policy). Each connection has an input and an output buffer;
+// every readable event parses all complete frames. Runs of pipelined GET or
+// PUT frames are folded into a single readBatch / writeBatch call, so a
+// client that keeps a deep pipeline gets batched descents without asking
+// for them. Responses are written in request order. Once a connection has
+// OUT_HIGH_WATER bytes unsent, its input is left unparsed (and unread)
+// until the client catches up.
+template <typename Tree = BPlusTree> class RpcServer {
+  struct Connection {
+    ConnectionBuffers io;
+    uint32_t events = 0;  // Current epoll interest
+    bool stalled = false; // Parsing paused on OUT_HIGH_WATER
+  };
+
+  Tree &tree;
+  std::string socketPath;
+  int listenFd = -1;
+  int epollFd = -1;
+  int wakeFd = -1;
+  std::atomic<bool> stopping{false};
+  std::unordered_map<int, Connection> conns;
+  ServerStats stats;
+
+  // Scratch reused across batches
+  std::vector<int32_t> batchKeys;
+  std::vector<uint8_t> batchValues;
+  std::vector<const uint8_t *> batchOut;
+
+public:
+  static constexpr size_t OUT_HIGH_WATER = 4u << 20;
+  static constexpr size_t MAX_RUN = 256; // Frames folded into one batch call
+  static constexpr int MAX_EVENTS = 64;
+
+  explicit RpcServer(Tree &t) : tree(t) {}
+  ~RpcServer() { close(); }
+  RpcServer(const RpcServer &) = delete;
+  RpcServer &operator=(const RpcServer &) = delete;
+
+  // Bind the socket. A stale socket file at the path is replaced.
+  bool listen(const std::string &path) {
+    close();
+    listenFd = listenUnixSocket(path);
+    if (listenFd >= 0)
+      socketPath = path;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listenFd < 0 || epollFd < 0 || wakeFd < 0 ||
+        !watch(listenFd, EPOLLIN) || !watch(wakeFd, EPOLLIN)) {
+      close();
+      return false;
+    }
+    stopping.store(false, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Serve until stop(). Returns false if the event loop failed.
+  bool run() {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping.load(std::memory_order_acquire)) {
+      int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == listenFd)
+          acceptAll();
+        else if (fd == wakeFd)
+          drainWake();
+        else
+          service(fd, events[i].events);
+      }
+    }
+    return true;
+  }
+
+  // Callable from any thread or a signal handler
+  void stop() {
+    stopping.store(true, std::memory_order_release);
+    if (wakeFd >= 0) {
+      uint64_t one = 1;
+      ssize_t r = ::write(wakeFd, &one, sizeof(one));
+      (void)r;
+    }
+  }
+
+  // Only meaningful from the loop thread or after run() returned
+  const ServerStats &statistics() const { return stats; }
+
+  void close() {
+    for (auto &entry : conns)
+      ::close(entry.first);
+    conns.clear();
+    for (int *fd : {&listenFd, &epollFd, &wakeFd}) {
+      if (*fd >= 0)
+        ::close(*fd);
+      *fd = -1;
+    }
+    if (!socketPath.empty())
+      ::unlink(socketPath.c_str());
+    socketPath.clear();
+  }
+
+private:
+  bool watch(int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+  }
+
+  void acceptAll() {
+    while (true) {
+      int fd = ::accept4(listenFd, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        return; // EAGAIN, or a transient error the next event retries
+      if (!watch(fd, EPOLLIN)) {
+        ::close(fd);
+        continue;
+      }
+      conns[fd].events = EPOLLIN;
+      stats.connections++;
+    }
+  }
+
+  void drainWake() {
+    uint64_t v;
+    while (::read(wakeFd, &v, sizeof(v)) > 0) {
+    }
+  }
+
+  void drop(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    conns.erase(fd);
+  }
+
+  void service(int fd, uint32_t events) {
+    auto it = conns.find(fd);
+    if (it == conns.end())
+      return;
+    Connection &c = it->second;
+
+    if ((events & EPOLLERR) ||
+        ((events & EPOLLIN) && !c.io.readFrom(fd, OUT_HIGH_WATER))) {
+      drop(fd);
+      return;
+    }
+
+    // Parse, answer, send; repeat while sending freed room for a stalled
+    // connection to make progress on input it already holds
+    do {
+      if (!process(c) || !c.io.sendTo(fd)) {
+        drop(fd);
+        return;
+      }
+    } while (c.stalled && c.io.unsent() < OUT_HIGH_WATER);
+
+    if (c.io.eof && c.io.unsent() == 0) {
+      drop(fd);
+      return;
+    }
+    uint32_t want = connectionInterest(c.io, OUT_HIGH_WATER);
+    if (want != c.events) {
+      epoll_event ev{};
+      ev.events = want;
+      ev.data.fd = fd;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+      c.events = want;
+    }
+  }
+
+  // Answer every complete frame in c.io.in. False on a malformed frame.
+  bool process(Connection &c) {
+    c.stalled = false;
+    while (true) {
+      if (c.io.unsent() >= OUT_HIGH_WATER) {
+        c.stalled = true;
+        return true;
+      }
+      Frame f;
+      size_t size;
+      ParseResult r = c.io.peek(f, size);
+      if (r == ParseResult::INCOMPLETE)
+        return true;
+      if (r == ParseResult::MALFORMED || !requestWellFormed(f))
+        return false;
+
+      const Op op = static_cast<Op>(f.code);
+      if (op == Op::GET || op == Op::PUT) {
+        c.io.inStart += foldRun(c.io, op);
+      } else {
+        answer(f, c.io.out);
+        c.io.inStart += size;
+      }
+    }
+  }
+
+  // Consecutive GET (or PUT) frames starting at c.inStart go through one
+  // readBatch (writeBatch). Returns the bytes consumed.
+  size_t foldRun(ConnectionBuffers &c, Op op) {
+    batchKeys.clear();
+    batchValues.clear();
+    size_t pos = c.inStart;
+    while (batchKeys.size() < MAX_RUN) {
+      Frame f;
+      size_t size;
+      if (parseFrame(c.in.data() + pos, c.in.size() - pos, f, size) !=
+              ParseResult::COMPLETE ||
+          f.code != static_cast<uint8_t>(op) || !requestWellFormed(f))
+        break;
+      batchKeys.push_back(readI32(f.body));
+      if (op == Op::PUT)
+        batchValues.insert(batchValues.end(), f.body + 4,
+                           f.body + 4 + DATA_SIZE);
+      pos += size;
+    }
+
+    const size_t n = batchKeys.size();
+    if (op == Op::GET) {
+      batchOut.resize(n);
+      tree.readBatch(batchKeys.data(), n, batchOut.data());
+      for (size_t i = 0; i < n; i++) {
+        Status st = batchOut[i] ? Status::OK : Status::NOT_FOUND;
+        size_t at = beginFrame(c.out, static_cast<uint8_t>(st));
+        if (batchOut[i])
+          appendBytes(c.out, batchOut[i], DATA_SIZE);
+        endFrame(c.out, at);
+      }
+    } else {
+      size_t written =
+          tree.writeBatch(batchKeys.data(), batchValues.data(), n);
+      for (size_t i = 0; i < n; i++) {
+        Status st = i < written ? Status::OK : Status::ERROR;
+        endFrame(c.out, beginFrame(c.out, static_cast<uint8_t>(st)));
+      }
+    }
+    stats.requests += n;
+    stats.batches++;
+    stats.batchedKeys += n;
+    return pos - c.inStart;
+  }
+
+  // Every other request, one at a time
+  void answer(const Frame &f, std::vector<uint8_t> &out) {
+    stats.requests++;
+    switch (static_cast<Op>(f.code)) {
+    case Op::DEL: {
+      Status st = tree.isReadOnly()               ? Status::ERROR
+                  : tree.deleteData(readI32(f.body)) ? Status::OK
+                                                     : Status::NOT_FOUND;
+      endFrame(out, beginFrame(out, static_cast<uint8_t>(st)));
+      return;
+    }
+    case Op::RANGE: {
+      uint32_t n = 0;
+      std::vector<uint8_t *> rows =
+          tree.readRangeData(readI32(f.body), readI32(f.body + 4), n);
+      if (n > MAX_RANGE_RESULTS) {
+        endFrame(out, beginFrame(out, static_cast<uint8_t>(Status::ERROR)));
+        return;
+      }
+      size_t at = beginFrame(out, static_cast<uint8_t>(Status::OK));
+      appendU32(out, n);
+      for (uint32_t i = 0; i < n; i++)
+        appendBytes(out, rows[i], DATA_SIZE);
+      endFrame(out, at);
+      return;
+    }
+    case Op::MGET: {
+      const uint32_t n = readU32(f.body);
+      batchKeys.resize(n);
+      std::memcpy(batchKeys.data(), f.body + 4, size_t(n) * 4);
+      batchOut.resize(n);
+      tree.readBatch(batchKeys.data(), n, batchOut.data());
+      stats.batches++;
+      stats.batchedKeys += n;
+
+      size_t at = beginFrame(out, static_cast<uint8_t>(Status::OK));
+      appendU32(out, n);
+      for (uint32_t i = 0; i < n; i++)
+        out.push_back(batchOut[i] != nullptr);
+      for (uint32_t i = 0; i < n; i++) {
+        if (batchOut[i])
+          appendBytes(out, batchOut[i], DATA_SIZE);
+      }
+      endFrame(out, at);
+      return;
+    }
+    case Op::MPUT: {
+      const uint32_t n = readU32(f.body);
+      batchKeys.resize(n);
+      batchValues.resize(size_t(n) * DATA_SIZE);
+      const uint8_t *p = f.body + 4;
+      for (uint32_t i = 0; i < n; i++, p += 4 + DATA_SIZE) {
+        batchKeys[i] = readI32(p);
+        std::memcpy(batchValues.data() + size_t(i) * DATA_SIZE, p + 4,
+                    DATA_SIZE);
+      }
+      size_t written = tree.writeBatch(batchKeys.data(), batchValues.data(), n);
+      stats.batches++;
+      stats.batchedKeys += n;
+
+      Status st = written == n ? Status::OK : Status::ERROR;
+      size_t at = beginFrame(out, static_cast<uint8_t>(st));
+      appendU32(out, static_cast<uint32_t>(written));
+      endFrame(out, at);
+      return;
+    }
+    default: // GET and PUT are folded by process()
+      return;
+    }
+  }
+};
+
+#endif // SERVER_HPP
@@ -0,0 +1,673 @@
+#ifndef SHARDED_SERVER_HPP
+#define SHARDED_SERVER_HPP
+
+#include "server.hpp"
+#include "spsc_queue.hpp"
+#include <deque>
+#include <memory>
+#include <pthread.h>
+#include <thread>
+
+struct ShardStats {
+  uint64_t connections = 0; // Accepted on this shard's socket
+  uint64_t requests = 0;    // Frames answered on this shard's connections
+  uint64_t forwarded = 0;   // Messages sent to other shards
+  uint64_t items = 0;       // Keys and sub-ranges executed on this tree
+
+  void add(const ShardStats &o) {
+    connections += o.connections;
+    requests += o.requests;
+    forwarded += o.forwarded;
+    items += o.items;
+  }
+};
+
+// THREAD-PER-CORE SERVER: every shard is a thread pinned to its own core
+// that owns one key range (ShardMap) with its own tree, page manager, index
+// file, socket and epoll loop. Nothing is shared, so the trees need no
+// locking. A request is split into items by owning shard. Items for other
+// shards travel in one Message per shard and pass, over a lock-free SPSC
+// queue per ordered shard pair, and come back the same way with results.
+// Each connection answers in request order from a queue of pending slots.
+// Queues between any two shards are FIFO, so one connection's operations on
+// a key are applied in the order they were sent.
+template <typename Tree = BPlusTree> class ShardedServer {
+public:
+  static constexpr size_t QUEUE_CAPACITY = 1024;
+  static constexpr size_t OUT_HIGH_WATER = 4u << 20;
+  static constexpr size_t MAX_IN_FLIGHT = 4096; // Pending slots per connection
+  static constexpr int MAX_EVENTS = 64;
+
+private:
+  // One key or sub-range for the shard that owns it
+  struct Item {
+    Op op; // GET, PUT, DEL or RANGE
+    Status status;
+    int32_t key;     // RANGE: low end
+    int32_t hi;      // RANGE: high end
+    uint64_t slot;   // Sequence number of the request on its connection
+    uint32_t index;  // Position in an MGET / MPUT, part of a RANGE
+    uint32_t offset; // PUT: value in values; GET, RANGE: result in reply
+    uint32_t length; // GET, RANGE: result bytes
+  };
+
+  // Items from one connection pass for one shard; travels back with results
+  struct Message {
+    uint32_t origin;
+    uint64_t connId;
+    bool answered = false;
+    std::vector<Item> items;
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> reply;
+  };
+
+  using Queue = SpscQueue<Message *, QUEUE_CAPACITY>;
+
+  // A request waiting for its items
+  struct Slot {
+    Op op;
+    Status status = Status::OK;
+    uint32_t pending = 0; // Items not yet answered
+    uint32_t n = 0;       // Keys (GET, MGET, MPUT)
+    uint32_t count = 0;   // MPUT: records written
+    std::vector<uint8_t> found;
+    std::vector<uint8_t> data;                // n * DATA_SIZE
+    std::vector<std::vector<uint8_t>> parts; // RANGE: rows per shard
+  };
+
+  struct Connection {
+    ConnectionBuffers io;
+    uint64_t id = 0;
+    uint32_t events = 0;
+    bool stalled = false;
+    std::deque<Slot> slots;
+    uint64_t firstSlot = 0; // Sequence number of slots.front()
+  };
+
+  struct Shard {
+    uint32_t index = 0;
+    Tree tree;
+    std::string socketPath;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::unordered_map<int, Connection> conns;
+    std::unordered_map<uint64_t, int> fdOf;
+    uint64_t nextConnId = 1;
+    std::vector<Message *> staged;             // Per target, current pass
+    std::vector<std::deque<Message *>> backlog; // Per target, queue was full
+    std::vector<uint8_t> wake;                  // Per target, needs a wakeup
+    ShardStats stats;
+    std::vector<int32_t> keys; // Scratch
+    std::vector<const uint8_t *> results;
+    std::thread thread;
+  };
+
+  ShardMap map;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<std::unique_ptr<Queue>> queues; // [from * shards + to]
+  std::atomic<bool> stopping{false};
+
+public:
+  // map.shards shards; 0 means one per hardware thread
+  explicit ShardedServer(ShardMap m) : map(m) {
+    if (map.shards == 0)
+      map.shards = std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t n = map.shards;
+    for (uint32_t i = 0; i < n; i++) {
+      shards.emplace_back(new Shard);
+      Shard &sh = *shards.back();
+      sh.index = i;
+      sh.staged.assign(n, nullptr);
+      sh.backlog.resize(n);
+      sh.wake.assign(n, 0);
+    }
+    queues.resize(size_t(n) * n);
+    for (uint32_t from = 0; from < n; from++)
+      for (uint32_t to = 0; to < n; to++)
+        if (from != to)
+          queues[size_t(from) * n + to].reset(new Queue);
+  }
+
+  ~ShardedServer() { close(); }
+  ShardedServer(const ShardedServer &) = delete;
+  ShardedServer &operator=(const ShardedServer &) = delete;
+
+  const ShardMap &shardMap() const { return map; }
+  uint32_t shardCount() const { return map.shards; }
+
+  // Shard i's tree, for configuration before start() or inspection after
+  // wait(). Never touch it while the shard runs.
+  Tree &tree(uint32_t i) { return shards[i]->tree; }
+
+  // Open <indexBase>.<i> and listen on <socketBase>.<i> for every shard.
+  // Each file records its shard index, the shard count and the key range
+  // when first opened here; a later open with a different count or range
+  // fails (a count of 0 resolves to this machine's core count first).
+  bool open(const std::string &indexBase, const std::string &socketBase) {
+    for (auto &p : shards) {
+      Shard &sh = *p;
+      const std::string suffix = "." + std::to_string(sh.index);
+      if (!sh.tree.open(indexBase + suffix) ||
+          !sh.tree.bindShard(sh.index, map.shards, map.lo, map.hi))
+        return false;
+      sh.listenFd = listenUnixSocket(socketBase + suffix);
+      if (sh.listenFd >= 0)
+        sh.socketPath = socketBase + suffix;
+      sh.epollFd = epoll_create1(EPOLL_CLOEXEC);
+      sh.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (sh.listenFd < 0 || sh.epollFd < 0 || sh.wakeFd < 0 ||
+          !watch(sh, sh.listenFd, EPOLLIN) || !watch(sh, sh.wakeFd, EPOLLIN))
+        return false;
+    }
+    return true;
+  }
+
+  // Start one thread per shard, pinned to core (index % cores) if pin
+  void start(bool pin = true) {
+    stopping.store(false, std::memory_order_relaxed);
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (auto &p : shards) {
+      Shard &sh = *p;
+      sh.thread = std::thread([this, &sh] { loop(sh); });
+      if (pin) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(sh.index % cores, &set);
+        pthread_setaffinity_np(sh.thread.native_handle(), sizeof(set), &set);
+      }
+    }
+  }
+
+  // Callable from any thread or a signal handler
+  void stop() {
+    stopping.store(true, std::memory_order_release);
+    for (auto &p : shards) {
+      if (p->wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t r = ::write(p->wakeFd, &one, sizeof(one));
+        (void)r;
+      }
+    }
+  }
+
+  void wait() {
+    for (auto &p : shards) {
+      if (p->thread.joinable())
+        p->thread.join();
+    }
+  }
+
+  // Only meaningful after wait()
+  const ShardStats &shardStats(uint32_t i) const { return shards[i]->stats; }
+
+  ShardStats totals() const {
+    ShardStats t;
+    for (const auto &p : shards)
+      t.add(p->stats);
+    return t;
+  }
+
+  // Stops and joins the shards, then closes sockets and trees
+  void close() {
+    stop();
+    wait();
+    const uint32_t n = map.shards;
+    for (uint32_t i = 0; i < queues.size(); i++) {
+      Message *m;
+      while (queues[i] && queues[i]->tryPop(m))
+        delete m;
+    }
+    for (auto &p : shards) {
+      Shard &sh = *p;
+      for (uint32_t t = 0; t < n; t++) {
+        for (Message *m : sh.backlog[t])
+          delete m;
+        sh.backlog[t].clear();
+        delete sh.staged[t];
+        sh.staged[t] = nullptr;
+      }
+      for (auto &entry : sh.conns)
+        ::close(entry.first);
+      sh.conns.clear();
+      sh.fdOf.clear();
+      for (int *fd : {&sh.listenFd, &sh.epollFd, &sh.wakeFd}) {
+        if (*fd >= 0)
+          ::close(*fd);
+        *fd = -1;
+      }
+      if (!sh.socketPath.empty())
+        ::unlink(sh.socketPath.c_str());
+      sh.socketPath.clear();
+      sh.tree.close();
+    }
+  }
+
+private:
+  Queue &queue(uint32_t from, uint32_t to) {
+    return *queues[size_t(from) * map.shards + to];
+  }
+
+  static bool watch(Shard &sh, int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(sh.epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+  }
+
+  void loop(Shard &sh) {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping.load(std::memory_order_acquire)) {
+      bool backlogged = false;
+      for (const auto &b : sh.backlog)
+        backlogged |= !b.empty();
+      int n = epoll_wait(sh.epollFd, events, MAX_EVENTS, backlogged ? 1 : -1);
+      if (n < 0 && errno != EINTR)
+        return;
+      for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == sh.listenFd) {
+          acceptAll(sh);
+        } else if (fd == sh.wakeFd) {
+          uint64_t v;
+          while (::read(sh.wakeFd, &v, sizeof(v)) > 0) {
+          }
+          pollQueues(sh);
+        } else {
+          service(sh, fd, events[i].events);
+        }
+      }
+      flushBacklog(sh);
+      wakeTargets(sh);
+    }
+  }
+
+  void acceptAll(Shard &sh) {
+    while (true) {
+      int fd = ::accept4(sh.listenFd, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        return;
+      if (!watch(sh, fd, EPOLLIN)) {
+        ::close(fd);
+        continue;
+      }
+      Connection &c = sh.conns[fd];
+      c.id = sh.nextConnId++;
+      c.events = EPOLLIN;
+      sh.fdOf[c.id] = fd;
+      sh.stats.connections++;
+    }
+  }
+
+  void drop(Shard &sh, int fd) {
+    auto it = sh.conns.find(fd);
+    epoll_ctl(sh.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    sh.fdOf.erase(it->second.id); // Late replies for it are discarded
+    sh.conns.erase(it);
+  }
+
+  // Read, parse, answer and send for one connection. events is 0 when
+  // called because replies arrived from other shards.
+  void service(Shard &sh, int fd, uint32_t events) {
+    auto it = sh.conns.find(fd);
+    if (it == sh.conns.end())
+      return;
+    Connection &c = it->second;
+
+    // A hung-up peer can no longer receive the replies still in flight
+    if ((events & (EPOLLERR | EPOLLHUP)) ||
+        ((events & EPOLLIN) && !c.io.readFrom(fd, OUT_HIGH_WATER))) {
+      drop(sh, fd);
+      return;
+    }
+    do {
+      if (!process(sh, c) || !c.io.sendTo(fd)) {
+        drop(sh, fd);
+        return;
+      }
+    } while (c.stalled && c.io.unsent() < OUT_HIGH_WATER &&
+             c.slots.size() < MAX_IN_FLIGHT);
+
+    if (c.io.eof && c.io.unsent() == 0 && c.slots.empty()) {
+      drop(sh, fd);
+      return;
+    }
+    uint32_t want = connectionInterest(c.io, OUT_HIGH_WATER);
+    if (c.slots.size() >= MAX_IN_FLIGHT)
+      want &= ~uint32_t(EPOLLIN);
+    if (want != c.events) {
+      epoll_event ev{};
+      ev.events = want;
+      ev.data.fd = fd;
+      epoll_ctl(sh.epollFd, EPOLL_CTL_MOD, fd, &ev);
+      c.events = want;
+    }
+  }
+
+  // Turn every complete frame into a slot and items, run the local items,
+  // send the rest, then answer the slots that are complete
+  bool process(Shard &sh, Connection &c) {
+    c.stalled = false;
+    bool ok = true;
+    while (true) {
+      if (c.io.unsent() >= OUT_HIGH_WATER || c.slots.size() >= MAX_IN_FLIGHT) {
+        c.stalled = true;
+        break;
+      }
+      Frame f;
+      size_t size;
+      ParseResult r = c.io.peek(f, size);
+      if (r == ParseResult::INCOMPLETE)
+        break;
+      if (r == ParseResult::MALFORMED || !requestWellFormed(f)) {
+        ok = false;
+        break;
+      }
+      dispatch(sh, c, f);
+      c.io.inStart += size;
+    }
+
+    for (uint32_t t = 0; t < map.shards; t++) {
+      Message *m = sh.staged[t];
+      if (!m)
+        continue;
+      sh.staged[t] = nullptr;
+      if (t == sh.index) {
+        execute(sh, *m);
+        applyReply(c, m);
+      } else {
+        send(sh, t, m);
+        sh.stats.forwarded++;
+      }
+    }
+    emitReady(sh, c);
+    return ok;
+  }
+
+  void addItem(Shard &sh, Connection &c, uint32_t target, const Item &item,
+               const uint8_t *value = nullptr) {
+    Message *&m = sh.staged[target];
+    if (!m) {
+      m = new Message;
+      m->origin = sh.index;
+      m->connId = c.id;
+    }
+    m->items.push_back(item);
+    if (value) {
+      m->items.back().offset = static_cast<uint32_t>(m->values.size());
+      m->values.insert(m->values.end(), value, value + DATA_SIZE);
+    }
+  }
+
+  void dispatch(Shard &sh, Connection &c, const Frame &f) {
+    const uint64_t seq = c.firstSlot + c.slots.size();
+    c.slots.emplace_back();
+    Slot &s = c.slots.back();
+    s.op = static_cast<Op>(f.code);
+
+    Item item{};
+    item.slot = seq;
+    switch (s.op) {
+    case Op::GET:
+    case Op::PUT:
+    case Op::DEL:
+      s.n = 1;
+      s.pending = 1;
+      s.found.assign(1, 0);
+      if (s.op == Op::GET)
+        s.data.resize(DATA_SIZE);
+      item.op = s.op;
+      item.key = readI32(f.body);
+      addItem(sh, c, map.shardOf(item.key), item,
+              s.op == Op::PUT ? f.body + 4 : nullptr);
+      return;
+    case Op::MGET:
+    case Op::MPUT: {
+      const bool put = s.op == Op::MPUT;
+      s.n = s.pending = readU32(f.body);
+      s.found.assign(s.n, 0);
+      if (!put)
+        s.data.resize(size_t(s.n) * DATA_SIZE);
+      item.op = put ? Op::PUT : Op::GET;
+      const size_t stride = put ? 4 + DATA_SIZE : 4;
+      const uint8_t *p = f.body + 4;
+      for (uint32_t i = 0; i < s.n; i++, p += stride) {
+        item.key = readI32(p);
+        item.index = i;
+        addItem(sh, c, map.shardOf(item.key), item, put ? p + 4 : nullptr);
+      }
+      return;
+    }
+    case Op::RANGE: {
+      const int32_t lo = readI32(f.body), hi = readI32(f.body + 4);
+      if (lo > hi)
+        return; // Empty result, complete already
+      const uint32_t first = map.shardOf(lo), last = map.shardOf(hi);
+      s.pending = last - first + 1;
+      s.parts.resize(s.pending);
+      item.op = Op::RANGE;
+      for (uint32_t t = first; t <= last; t++) {
+        item.key = std::max(lo, map.firstKey(t));
+        item.hi = std::min(hi, map.lastKey(t));
+        item.index = t - first;
+        addItem(sh, c, t, item);
+      }
+      return;
+    }
+    }
+  }
+
+  // Run a message's items against this shard's tree, in order. Runs of
+  // GETs and PUTs go through readBatch and writeBatch.
+  void execute(Shard &sh, Message &m) {
+    std::vector<Item> &items = m.items;
+    sh.stats.items += items.size();
+    size_t i = 0;
+    while (i < items.size()) {
+      const Op op = items[i].op;
+      size_t j = i + 1;
+      if (op == Op::GET || op == Op::PUT) {
+        while (j < items.size() && items[j].op == op)
+          j++;
+      }
+
+      if (op == Op::GET) {
+        sh.keys.resize(j - i);
+        sh.results.resize(j - i);
+        for (size_t k = i; k < j; k++)
+          sh.keys[k - i] = items[k].key;
+        sh.tree.readBatch(sh.keys.data(), j - i, sh.results.data());
+        for (size_t k = i; k < j; k++) {
+          const uint8_t *v = sh.results[k - i];
+          items[k].status = v ? Status::OK : Status::NOT_FOUND;
+          if (v) {
+            items[k].offset = static_cast<uint32_t>(m.reply.size());
+            items[k].length = DATA_SIZE;
+            m.reply.insert(m.reply.end(), v, v + DATA_SIZE);
+          }
+        }
+      } else if (op == Op::PUT) {
+        // A run's values are contiguous in m.values
+        sh.keys.resize(j - i);
+        for (size_t k = i; k < j; k++)
+          sh.keys[k - i] = items[k].key;
+        size_t written = sh.tree.writeBatch(
+            sh.keys.data(), m.values.data() + items[i].offset, j - i);
+        for (size_t k = i; k < j; k++)
+          items[k].status = k - i < written ? Status::OK : Status::ERROR;
+      } else if (op == Op::DEL) {
+        items[i].status = sh.tree.isReadOnly() ? Status::ERROR
+                          : sh.tree.deleteData(items[i].key)
+                              ? Status::OK
+                              : Status::NOT_FOUND;
+      } else { // RANGE
+        uint32_t n = 0;
+        std::vector<uint8_t *> rows =
+            sh.tree.readRangeData(items[i].key, items[i].hi, n);
+        items[i].status = n > MAX_RANGE_RESULTS ? Status::ERROR : Status::OK;
+        if (items[i].status == Status::OK) {
+          items[i].offset = static_cast<uint32_t>(m.reply.size());
+          items[i].length = n * DATA_SIZE;
+          for (uint32_t r = 0; r < n; r++)
+            m.reply.insert(m.reply.end(), rows[r], rows[r] + DATA_SIZE);
+        }
+      }
+      i = j;
+    }
+    m.answered = true;
+  }
+
+  // Fold a message's results into its connection's slots; frees it
+  void applyReply(Connection &c, Message *m) {
+    for (const Item &item : m->items) {
+      Slot &s = c.slots[item.slot - c.firstSlot];
+      const bool ok = item.status == Status::OK;
+      switch (s.op) {
+      case Op::GET:
+      case Op::MGET:
+        if (ok) {
+          s.found[item.index] = 1;
+          std::memcpy(s.data.data() + size_t(item.index) * DATA_SIZE,
+                      m->reply.data() + item.offset, DATA_SIZE);
+        }
+        break;
+      case Op::PUT:
+      case Op::DEL:
+        s.status = item.status;
+        break;
+      case Op::MPUT:
+        if (ok)
+          s.count++;
+        else
+          s.status = Status::ERROR;
+        break;
+      case Op::RANGE:
+        if (ok)
+          s.parts[item.index].assign(m->reply.data() + item.offset,
+                                     m->reply.data() + item.offset +
+                                         item.length);
+        else
+          s.status = Status::ERROR;
+        break;
+      }
+      s.pending--;
+    }
+    delete m;
+  }
+
+  // Encode the completed slots at the front of the queue
+  void emitReady(Shard &sh, Connection &c) {
+    std::vector<uint8_t> &out = c.io.out;
+    while (!c.slots.empty() && c.slots.front().pending == 0) {
+      Slot &s = c.slots.front();
+      switch (s.op) {
+      case Op::GET: {
+        Status st = s.found[0] ? Status::OK : Status::NOT_FOUND;
+        size_t at = beginFrame(out, static_cast<uint8_t>(st));
+        if (s.found[0])
+          appendBytes(out, s.data.data(), DATA_SIZE);
+        endFrame(out, at);
+        break;
+      }
+      case Op::PUT:
+      case Op::DEL:
+        endFrame(out, beginFrame(out, static_cast<uint8_t>(s.status)));
+        break;
+      case Op::MGET: {
+        size_t at = beginFrame(out, static_cast<uint8_t>(Status::OK));
+        appendU32(out, s.n);
+        appendBytes(out, s.found.data(), s.n);
+        for (uint32_t i = 0; i < s.n; i++) {
+          if (s.found[i])
+            appendBytes(out, s.data.data() + size_t(i) * DATA_SIZE,
+                        DATA_SIZE);
+        }
+        endFrame(out, at);
+        break;
+      }
+      case Op::MPUT: {
+        size_t at = beginFrame(out, static_cast<uint8_t>(s.status));
+        appendU32(out, s.count);
+        endFrame(out, at);
+        break;
+      }
+      case Op::RANGE: {
+        size_t rows = 0;
+        for (const auto &part : s.parts)
+          rows += part.size() / DATA_SIZE;
+        if (s.status != Status::OK || rows > MAX_RANGE_RESULTS) {
+          endFrame(out, beginFrame(out, static_cast<uint8_t>(Status::ERROR)));
+          break;
+        }
+        size_t at = beginFrame(out, static_cast<uint8_t>(Status::OK));
+        appendU32(out, static_cast<uint32_t>(rows));
+        for (const auto &part : s.parts)
+          appendBytes(out, part.data(), part.size());
+        endFrame(out, at);
+        break;
+      }
+      }
+      c.slots.pop_front();
+      c.firstSlot++;
+      sh.stats.requests++;
+    }
+  }
+
+  // Requests from other shards are executed and sent back; replies are
+  // applied to their connection, which may then answer and read more
+  void pollQueues(Shard &sh) {
+    for (uint32_t from = 0; from < map.shards; from++) {
+      if (from == sh.index)
+        continue;
+      Queue &q = queue(from, sh.index);
+      Message *m;
+      while (q.tryPop(m)) {
+        if (!m->answered) {
+          execute(sh, *m);
+          send(sh, m->origin, m);
+          continue;
+        }
+        auto it = sh.fdOf.find(m->connId);
+        if (it == sh.fdOf.end()) {
+          delete m; // Connection went away
+          continue;
+        }
+        applyReply(sh.conns[it->second], m);
+        service(sh, it->second, 0);
+      }
+    }
+  }
+
+  void send(Shard &sh, uint32_t target, Message *m) {
+    std::deque<Message *> &backlog = sh.backlog[target];
+    if (!backlog.empty() || !queue(sh.index, target).tryPush(m))
+      backlog.push_back(m); // Keeps FIFO order behind earlier overflow
+    sh.wake[target] = 1;
+  }
+
+  void flushBacklog(Shard &sh) {
+    for (uint32_t t = 0; t < map.shards; t++) {
+      std::deque<Message *> &backlog = sh.backlog[t];
+      while (!backlog.empty() && queue(sh.index, t).tryPush(backlog.front())) {
+        backlog.pop_front();
+        sh.wake[t] = 1;
+      }
+    }
+  }
+
+  // One eventfd write per target per loop iteration
+  void wakeTargets(Shard &sh) {
+    for (uint32_t t = 0; t < map.shards; t++) {
+      if (!sh.wake[t])
+        continue;
+      sh.wake[t] = 0;
+      uint64_t one = 1;
+      ssize_t r = ::write(shards[t]->wakeFd, &one, sizeof(one));
+      (void)r;
+    }
+  }
+};
+
+#endif // SHARDED_SERVER_HPP
@@ -0,0 +1,254 @@
+#ifndef SHARED_COORD_HPP
+#define SHARED_COORD_HPP
+
+#include "page.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =============================================================================
+// SINGLE-WRITER / MULTI-PROCESS READER COORDINATION
+// =============================================================================
+//
+// A sidecar file (<index>.lock) is mapped MAP_SHARED by the writer and every
+// reader process. It holds:
+//   - a seqlock counter: odd while the writer is modifying pages in place,
+//     bumped to the next even value when the change is complete
+//   - the writer's pid, guarded by an exclusive flock() on the sidecar
+//
+// Readers run a lookup optimistically, copy the result out, and retry if
+// the sequence moved underneath them. The writer never waits for readers
+// and does not know about them: safety comes from the seqlock validation
+// alone, plus descents that bounds-check every page they follow so a torn
+// read fails the validation instead of faulting. Readers open both files
+// read-only and map them PROT_READ; they never write to either. A reader
+// that finds the sequence odd for a while checks that the writer is still
+// alive, and fails the read if it died in the middle of a write.
+
+constexpr uint32_t SHARED_MAGIC = 0x5EC10C4B;
+
+struct alignas(CACHE_LINE_SIZE) SharedRegion {
+  uint32_t magic;
+  std::atomic<uint32_t> writerPid;
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> seq;
+  uint8_t reserved[PAGE_SIZE - 2 * CACHE_LINE_SIZE];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory seqlock needs address-free 64-bit atomics");
+static_assert(sizeof(SharedRegion) % PAGE_SIZE == 0,
+              "SharedRegion should fill whole pages");
+
+class SharedCoordinator {
+public:
+  enum class Role : uint8_t { NONE = 0, WRITER = 1, READER = 2 };
+
+private:
+  SharedRegion *region;
+  Role role;
+#ifndef _WIN32
+  int fd;
+#endif
+
+  // Odd-sequence spins between checks that the writer is still alive
+  static constexpr uint32_t WRITER_CHECK_SPINS = 1024;
+
+public:
+  SharedCoordinator()
+      : region(nullptr), role(Role::NONE)
+#ifndef _WIN32
+        ,
+        fd(-1)
+#endif
+  {
+  }
+
+  ~SharedCoordinator() { close(); }
+
+  SharedCoordinator(const SharedCoordinator &) = delete;
+  SharedCoordinator &operator=(const SharedCoordinator &) = delete;
+
+  FORCE_INLINE bool isActive() const { return region != nullptr; }
+  FORCE_INLINE bool isWriter() const { return role == Role::WRITER; }
+  Role getRole() const { return role; }
+
+  // Become the single writer. Fails if another process holds the role.
+  bool openWriter(const std::string &path) {
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    if (region)
+      return false;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+      return false;
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 ||
+        ftruncate(fd, sizeof(SharedRegion)) != 0 || !mapRegion(true)) {
+      closeFd();
+      return false;
+    }
+
+    if (region->magic != SHARED_MAGIC) {
+      std::memset(static_cast<void *>(region), 0, sizeof(SharedRegion));
+      region->magic = SHARED_MAGIC;
+    }
+
+    // A writer that died mid-update leaves the sequence odd
+    uint64_t s = region->seq.load(std::memory_order_relaxed);
+    if (s & 1)
+      region->seq.store(s + 1, std::memory_order_release);
+
+    region->writerPid.store(static_cast<uint32_t>(getpid()),
+                            std::memory_order_release);
+    role = Role::WRITER;
+    return true;
+#endif
+  }
+
+  // Join as a reader. The writer must have created the sidecar.
+  bool openReader(const std::string &path) {
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    if (region)
+      return false;
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SharedRegion) ||
+        !mapRegion(false) || region->magic != SHARED_MAGIC) {
+      closeFd();
+      return false;
+    }
+    role = Role::READER;
+    return true;
+#endif
+  }
+
+  void close() {
+#ifndef _WIN32
+    if (region && role == Role::WRITER)
+      region->writerPid.store(0, std::memory_order_release);
+    closeFd();
+#endif
+    role = Role::NONE;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Writer side
+  // ---------------------------------------------------------------------------
+
+  FORCE_INLINE void writeBegin() {
+    uint64_t s = region->seq.load(std::memory_order_relaxed);
+    region->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  FORCE_INLINE void writeEnd() {
+    uint64_t s = region->seq.load(std::memory_order_relaxed);
+    region->seq.store(s + 1, std::memory_order_release);
+  }
+
+  // Brackets one logical modification; no-op when sharing is not enabled
+  class WriteScope {
+    SharedCoordinator *coord;
+
+  public:
+    explicit WriteScope(SharedCoordinator &c) : coord(c.isWriter() ? &c : nullptr) {
+      if (coord)
+        coord->writeBegin();
+    }
+    ~WriteScope() {
+      if (coord)
+        coord->writeEnd();
+    }
+    WriteScope(const WriteScope &) = delete;
+    WriteScope &operator=(const WriteScope &) = delete;
+  };
+
+  // ---------------------------------------------------------------------------
+  // Reader side
+  // ---------------------------------------------------------------------------
+
+  // Wait for a stable (even) sequence. False if the writer died in the
+  // middle of a write: the sequence then stays odd until the next writer
+  // opens, and the pages it was changing may be torn for good.
+  FORCE_INLINE bool readBegin(uint64_t &s) {
+    for (uint32_t spins = 1;
+         (s = region->seq.load(std::memory_order_acquire)) & 1; spins++) {
+      if (UNLIKELY(spins % WRITER_CHECK_SPINS == 0) && !writerAlive())
+        return false;
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  // True if no writer committed while we were reading
+  FORCE_INLINE bool readValidate(uint64_t s) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return region->seq.load(std::memory_order_relaxed) == s;
+  }
+
+  uint64_t currentSeq() const {
+    return region ? region->seq.load(std::memory_order_acquire) : 0;
+  }
+
+private:
+  // A writer clears its pid only on a clean close, between writes
+  bool writerAlive() const {
+    const uint32_t pid = region->writerPid.load(std::memory_order_acquire);
+    return pid != 0 && processAlive(pid);
+  }
+
+#ifndef _WIN32
+  bool mapRegion(bool writable) {
+    void *p = mmap(nullptr, sizeof(SharedRegion),
+                   writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                   fd, 0);
+    if (p == MAP_FAILED)
+      return false;
+    region = static_cast<SharedRegion *>(p);
+    return true;
+  }
+
+  void closeFd() {
+    if (region) {
+      munmap(static_cast<void *>(region), sizeof(SharedRegion));
+      region = nullptr;
+    }
+    if (fd >= 0) {
+      ::close(fd); // Also drops the writer's flock
+      fd = -1;
+    }
+  }
+#endif
+
+  static bool processAlive(uint32_t pid) {
+#ifdef _WIN32
+    (void)pid;
+    return true;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+  }
+};
+
+#endif // SHARED_COORD_HPP
@@ -0,0 +1,58 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Capacity must be a power of two. Each side caches the other's
+// index, so the shared cache lines are only read when the ring looks full
+// (producer) or empty (consumer).
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+  static constexpr size_t MASK = Capacity - 1;
+  static constexpr size_t LINE = 64;
+
+  alignas(LINE) std::atomic<size_t> head{0}; // Next slot to read
+  size_t cachedTail = 0;                    // Consumer's view of tail
+  alignas(LINE) std::atomic<size_t> tail{0}; // Next slot to write
+  size_t cachedHead = 0;                    // Producer's view of head
+  alignas(LINE) T slots[Capacity];
+
+public:
+  // Producer side. False if the ring is full.
+  bool tryPush(const T &value) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cachedHead == Capacity) {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (t - cachedHead == Capacity)
+        return false;
+    }
+    slots[t & MASK] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. False if the ring is empty.
+  bool tryPop(T &value) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h == cachedTail) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (h == cachedTail)
+        return false;
+    }
+    value = slots[h & MASK];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate from any thread; exact from the consumer when it is empty
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+};
+
+#endif // SPSC_QUEUE_HPP
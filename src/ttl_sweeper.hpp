@@ -0,0 +1,71 @@
+#ifndef TTL_SWEEPER_HPP
+#define TTL_SWEEPER_HPP
+
+#include "bptree.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Background thread that removes expired records: every `interval` it calls
+// sweepExpired(keysPerTick), so at most that many expiry-index entries are
+// handled (and the write guard held for that long) per tick. A backlog
+// drains over several ticks instead of stalling writers. The tree must use
+// a concurrent locking policy (e.g. SharedMutexLocking).
+template <typename Tree> class TtlSweeper {
+  static_assert(Tree::LockingPolicy::concurrent,
+                "TtlSweeper runs beside other threads; use a locking tree");
+
+  Tree &tree;
+  std::chrono::milliseconds interval;
+  size_t keysPerTick;
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::atomic<uint64_t> removed{0};
+  std::atomic<uint64_t> ticks{0};
+
+public:
+  TtlSweeper(Tree &t, std::chrono::milliseconds every = std::chrono::seconds(1),
+             size_t perTick = 4096)
+      : tree(t), interval(every), keysPerTick(std::max<size_t>(perTick, 1)) {}
+  ~TtlSweeper() { stop(); }
+
+  TtlSweeper(const TtlSweeper &) = delete;
+  TtlSweeper &operator=(const TtlSweeper &) = delete;
+
+  void start() {
+    if (worker.joinable())
+      return;
+    stopping = false;
+    worker = std::thread([this] { run(); });
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+      worker.join();
+  }
+
+  uint64_t removedRecords() const { return removed.load(); }
+  uint64_t sweeps() const { return ticks.load(); }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+      lock.unlock();
+      removed += tree.sweepExpired(keysPerTick);
+      ticks++;
+      lock.lock();
+    }
+  }
+};
+
+#endif // TTL_SWEEPER_HPP